@@ -30,6 +30,7 @@ LOCAL_SRC_FILES := \
 	pan.c \
 	../src/log.c \
 	../src/shared/mgmt.c \
+	../src/shared/trace.c \
 	../src/shared/util.c \
 	../src/sdpd-database.c \
 	../src/sdpd-service.c \
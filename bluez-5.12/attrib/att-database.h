@@ -37,7 +37,13 @@ struct attribute {
 							gpointer user_data);
 	uint8_t (*write_cb)(struct attribute *a, struct btd_device *device,
 							gpointer user_data);
+	/* Writes the value at offset straight into the response buffer and
+	 * returns its length, or a negated ATT error code */
+	ssize_t (*value_cb)(struct attribute *a, struct btd_device *device,
+					uint8_t *buf, size_t len,
+					uint16_t offset, gpointer user_data);
 	gpointer cb_user_data;
 	size_t len;
 	uint8_t *data;
+	gpointer block;		/* Shared allocation, if added as a block */
 };
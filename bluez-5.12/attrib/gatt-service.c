@@ -39,6 +39,9 @@
 #include "gatt-service.h"
 #include "log.h"
 
+/* Largest declaration value: properties, handle and a 128-bit UUID */
+#define DECL_MAX_LEN 19
+
 struct gatt_info {
 	bt_uuid_t uuid;
 	uint8_t props;
@@ -123,26 +126,23 @@ static GSList *parse_opts(gatt_option opt1, va_list args)
 	return l;
 }
 
-static struct attribute *add_service_declaration(struct btd_adapter *adapter,
-				uint16_t handle, uint16_t svc, bt_uuid_t *uuid)
+static gboolean add_service_declaration(struct attribute *a, uint16_t svc,
+							bt_uuid_t *uuid)
 {
-	bt_uuid_t bt_uuid;
-	uint8_t atval[16];
-	int len;
-
 	if (uuid->type == BT_UUID16) {
-		att_put_u16(uuid->value.u16, &atval[0]);
-		len = 2;
+		att_put_u16(uuid->value.u16, a->data);
+		a->len = 2;
 	} else if (uuid->type == BT_UUID128) {
-		att_put_u128(uuid->value.u128, &atval[0]);
-		len = 16;
+		att_put_u128(uuid->value.u128, a->data);
+		a->len = 16;
 	} else
-		return NULL;
+		return FALSE;
 
-	bt_uuid16_create(&bt_uuid, svc);
+	bt_uuid16_create(&a->uuid, svc);
+	a->read_req = ATT_NONE;
+	a->write_req = ATT_NOT_PERMITTED;
 
-	return attrib_db_add(adapter, handle, &bt_uuid, ATT_NONE,
-						ATT_NOT_PERMITTED, atval, len);
+	return TRUE;
 }
 
 static int att_read_req(int authorization, int authentication, uint8_t props)
@@ -182,14 +182,11 @@ static int find_callback(gconstpointer a, gconstpointer b)
 	return cb->event - event;
 }
 
-static gboolean add_characteristic(struct btd_adapter *adapter,
-				uint16_t *handle, struct gatt_info *info)
+static gboolean add_characteristic(struct attribute **attr,
+						struct gatt_info *info)
 {
 	int read_req, write_req;
-	uint16_t h = *handle;
-	struct attribute *a;
-	bt_uuid_t bt_uuid;
-	uint8_t atval[ATT_MAX_VALUE_LEN];
+	struct attribute *a = *attr;
 	GSList *l;
 
 	if ((info->uuid.type != BT_UUID16 && info->uuid.type != BT_UUID128) ||
@@ -207,8 +204,11 @@ static gboolean add_characteristic(struct btd_adapter *adapter,
 	 * callback must be always provided if a read/write property is set */
 	if (read_req != ATT_NOT_PERMITTED) {
 		gpointer reqs = GUINT_TO_POINTER(ATTRIB_READ);
+		gpointer value = GUINT_TO_POINTER(ATTRIB_READ_VALUE);
 
 		if (!g_slist_find_custom(info->callbacks, reqs,
+							find_callback) &&
+				!g_slist_find_custom(info->callbacks, value,
 							find_callback)) {
 			error("Callback for read required");
 			return FALSE;
@@ -226,19 +226,20 @@ static gboolean add_characteristic(struct btd_adapter *adapter,
 	}
 
 	/* characteristic declaration */
-	bt_uuid16_create(&bt_uuid, GATT_CHARAC_UUID);
-	atval[0] = info->props;
-	att_put_u16(h + 1, &atval[1]);
-	att_put_uuid(info->uuid, &atval[3]);
-	if (attrib_db_add(adapter, h++, &bt_uuid, ATT_NONE, ATT_NOT_PERMITTED,
-				atval, 3 + info->uuid.type / 8) == NULL)
-		return FALSE;
+	bt_uuid16_create(&a->uuid, GATT_CHARAC_UUID);
+	a->read_req = ATT_NONE;
+	a->write_req = ATT_NOT_PERMITTED;
+	a->data[0] = info->props;
+	att_put_u16(a->handle + 1, &a->data[1]);
+	att_put_uuid(info->uuid, &a->data[3]);
+	a->len = 3 + info->uuid.type / 8;
+	a++;
 
 	/* characteristic value */
-	a = attrib_db_add(adapter, h++, &info->uuid, read_req, write_req,
-								NULL, 0);
-	if (a == NULL)
-		return FALSE;
+	a->uuid = info->uuid;
+	a->read_req = read_req;
+	a->write_req = write_req;
+	a->len = 0;
 
 	for (l = info->callbacks; l != NULL; l = l->next) {
 		struct attrib_cb *cb = l->data;
@@ -250,6 +251,9 @@ static gboolean add_characteristic(struct btd_adapter *adapter,
 		case ATTRIB_WRITE:
 			a->write_cb = cb->fn;
 			break;
+		case ATTRIB_READ_VALUE:
+			a->value_cb = cb->fn;
+			break;
 		}
 
 		a->cb_user_data = cb->user_data;
@@ -258,23 +262,24 @@ static gboolean add_characteristic(struct btd_adapter *adapter,
 	if (info->value_handle != NULL)
 		*info->value_handle = a->handle;
 
+	a++;
+
 	/* client characteristic configuration descriptor */
 	if (info->props & (ATT_CHAR_PROPER_NOTIFY | ATT_CHAR_PROPER_INDICATE)) {
-		uint8_t cfg_val[2];
-
-		bt_uuid16_create(&bt_uuid, GATT_CLIENT_CHARAC_CFG_UUID);
-		cfg_val[0] = 0x00;
-		cfg_val[1] = 0x00;
-		a = attrib_db_add(adapter, h++, &bt_uuid, ATT_NONE,
-				ATT_AUTHENTICATION, cfg_val, sizeof(cfg_val));
-		if (a == NULL)
-			return FALSE;
+		bt_uuid16_create(&a->uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+		a->read_req = ATT_NONE;
+		a->write_req = ATT_AUTHENTICATION;
+		a->data[0] = 0x00;
+		a->data[1] = 0x00;
+		a->len = 2;
 
 		if (info->ccc_handle != NULL)
 			*info->ccc_handle = a->handle;
+
+		a++;
 	}
 
-	*handle = h;
+	*attr = a;
 
 	return TRUE;
 }
@@ -287,22 +292,14 @@ static void free_gatt_info(void *data)
 	g_free(info);
 }
 
-static void service_attr_del(struct btd_adapter *adapter, uint16_t start_handle,
-							uint16_t end_handle)
-{
-	uint16_t handle;
-
-	for (handle = start_handle; handle <= end_handle; handle++)
-		if (attrib_db_del(adapter, handle) < 0)
-			error("Can't delete handle 0x%04x", handle);
-}
-
 gboolean gatt_service_add(struct btd_adapter *adapter, uint16_t uuid,
 				bt_uuid_t *svc_uuid, gatt_option opt1, ...)
 {
 	char uuidstr[MAX_LEN_UUID_STR];
-	uint16_t start_handle, h;
-	unsigned int size;
+	struct attribute *attrs = NULL, *a;
+	uint8_t *values = NULL;
+	uint16_t start_handle;
+	unsigned int size, i;
 	va_list args;
 	GSList *chrs, *l;
 
@@ -332,28 +329,45 @@ gboolean gatt_service_add(struct btd_adapter *adapter, uint16_t uuid,
 	DBG("New service: handle 0x%04x, UUID %s, %d attributes",
 						start_handle, uuidstr, size);
 
+	g_assert(size < USHRT_MAX);
+
+	/* The whole service is built here and handed to the attribute
+	 * server in one go, which copies it into a single block. */
+	attrs = g_new0(struct attribute, size);
+	values = g_malloc(size * DECL_MAX_LEN);
+
+	for (i = 0; i < size; i++) {
+		attrs[i].handle = start_handle + i;
+		attrs[i].data = values + i * DECL_MAX_LEN;
+	}
+
 	/* service declaration */
-	h = start_handle;
-	if (add_service_declaration(adapter, h++, uuid, svc_uuid) == NULL)
+	a = attrs;
+	if (!add_service_declaration(a++, uuid, svc_uuid))
 		goto fail;
 
 	for (l = chrs; l != NULL; l = l->next) {
 		struct gatt_info *info = l->data;
 
-		DBG("New characteristic: handle 0x%04x", h);
-		if (!add_characteristic(adapter, &h, info)) {
-			service_attr_del(adapter, start_handle, h - 1);
+		DBG("New characteristic: handle 0x%04x", a->handle);
+		if (!add_characteristic(&a, info))
 			goto fail;
-		}
 	}
 
-	g_assert(size < USHRT_MAX);
-	g_assert(h == 0 || (h - start_handle == (uint16_t) size));
+	g_assert(a - attrs == (int) size);
+
+	if (attrib_db_add_block(adapter, attrs, size, NULL, NULL) == NULL)
+		goto fail;
+
+	g_free(values);
+	g_free(attrs);
 	g_slist_free_full(chrs, free_gatt_info);
 
 	return TRUE;
 
 fail:
+	g_free(values);
+	g_free(attrs);
 	g_slist_free_full(chrs, free_gatt_info);
 	return FALSE;
 }
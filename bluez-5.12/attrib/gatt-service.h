@@ -51,6 +51,8 @@ typedef enum {
 typedef enum {
 	ATTRIB_READ,
 	ATTRIB_WRITE,
+	/* value provider, see value_cb in struct attribute */
+	ATTRIB_READ_VALUE,
 } attrib_event_t;
 
 gboolean gatt_service_add(struct btd_adapter *adapter, uint16_t uuid,
@@ -38,6 +38,7 @@
 
 #include "lib/uuid.h"
 #include "log.h"
+#include "src/shared/trace.h"
 #include "att.h"
 #include "gattrib.h"
 
@@ -58,6 +59,7 @@ struct _GAttrib {
 	GDestroyNotify destroy;
 	gpointer destroy_user_data;
 	bool stale;
+	bool ind_pending;
 };
 
 struct command {
@@ -330,6 +332,9 @@ static gboolean can_write_data(GIOChannel *io, GIOCondition cond,
 		return FALSE;
 	}
 
+	trace_event(TRACE_ATT_SEND, g_io_channel_unix_get_fd(io), cmd->pdu[0],
+									len);
+
 	if (cmd->expected == 0) {
 		g_queue_pop_head(queue);
 		command_destroy(cmd);
@@ -415,6 +420,11 @@ static gboolean received_data(GIOChannel *io, GIOCondition cond, gpointer data)
 		goto done;
 	}
 
+	trace_event(TRACE_ATT_RECV, g_io_channel_unix_get_fd(io), buf[0], len);
+
+	if (buf[0] == ATT_OP_HANDLE_IND)
+		attrib->ind_pending = true;
+
 	for (l = attrib->events; l; l = l->next) {
 		struct event *evt = l->data;
 
@@ -513,12 +523,20 @@ guint g_attrib_send(GAttrib *attrib, guint id, const guint8 *pdu, guint16 len,
 	if (attrib->stale)
 		return 0;
 
+	opcode = pdu[0];
+
+	/* Several users may see the same indication, confirm it only once */
+	if (opcode == ATT_OP_HANDLE_CNF) {
+		if (!attrib->ind_pending)
+			return 0;
+
+		attrib->ind_pending = false;
+	}
+
 	c = g_try_new0(struct command, 1);
 	if (c == NULL)
 		return 0;
 
-	opcode = pdu[0];
-
 	c->opcode = opcode;
 	c->expected = opcode2expected(opcode);
 	c->pdu = g_malloc(len);
@@ -302,6 +302,11 @@ void g_dbus_emit_property_changed(DBusConnection *connection,
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 				const char *interface, DBusMessageIter *iter);
 
+void g_dbus_set_property_changed_interval(unsigned int msec);
+gboolean g_dbus_set_object_property_changed_interval(
+					DBusConnection *connection,
+					const char *path, unsigned int msec);
+
 gboolean g_dbus_attach_object_manager(DBusConnection *connection);
 gboolean g_dbus_detach_object_manager(DBusConnection *connection);
 
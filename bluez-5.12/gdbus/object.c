@@ -57,6 +57,9 @@ struct generic_data {
 	GSList *removed;
 	guint process_id;
 	gboolean pending_prop;
+	guint prop_interval;		/* msec, 0 means use the default */
+	guint prop_timeout_id;
+	gint64 prop_emitted;		/* last PropertiesChanged, usec */
 	char *introspect;
 	struct generic_data *parent;
 };
@@ -87,6 +90,7 @@ struct property_data {
 static int global_flags = 0;
 static struct generic_data *root;
 static GSList *pending = NULL;
+static guint default_prop_interval = 0;
 
 static gboolean process_changes(gpointer user_data);
 static void process_properties_from_interface(struct generic_data *data,
@@ -637,7 +641,56 @@ static void add_pending(struct generic_data *data)
 	if (data->process_id > 0)
 		return;
 
+	/* A delayed property flush means data is already pending */
+	if (data->prop_timeout_id > 0) {
+		g_source_remove(data->prop_timeout_id);
+		data->prop_timeout_id = 0;
+	} else
+		pending = g_slist_append(pending, data);
+
 	data->process_id = g_idle_add(process_changes, data);
+}
+
+static gboolean process_properties_timeout(gpointer user_data)
+{
+	struct generic_data *data = user_data;
+
+	data->prop_timeout_id = 0;
+
+	return process_changes(data);
+}
+
+static void add_pending_properties(struct generic_data *data)
+{
+	guint interval;
+	gint64 elapsed;
+
+	if (data->prop_interval > 0)
+		interval = data->prop_interval;
+	else
+		interval = default_prop_interval;
+
+	if (interval == 0 || data->process_id > 0) {
+		add_pending(data);
+		return;
+	}
+
+	if (data->prop_timeout_id > 0)
+		return;
+
+	elapsed = (g_get_monotonic_time() - data->prop_emitted) / 1000;
+	if (elapsed >= interval) {
+		add_pending(data);
+		return;
+	}
+
+	/*
+	 * Changes within the interval are collapsed: the property list
+	 * only holds each property once and values are read when the
+	 * signal is finally built.
+	 */
+	data->prop_timeout_id = g_timeout_add(interval - elapsed,
+					process_properties_timeout, data);
 
 	pending = g_slist_append(pending, data);
 }
@@ -987,6 +1040,11 @@ static void remove_pending(struct generic_data *data)
 		data->process_id = 0;
 	}
 
+	if (data->prop_timeout_id > 0) {
+		g_source_remove(data->prop_timeout_id);
+		data->prop_timeout_id = 0;
+	}
+
 	pending = g_slist_remove(pending, data);
 }
 
@@ -1000,8 +1058,10 @@ static gboolean process_changes(gpointer user_data)
 		emit_interfaces_added(data);
 
 	/* Flush pending properties */
-	if (data->pending_prop == TRUE)
+	if (data->pending_prop == TRUE) {
 		process_property_changes(data);
+		data->prop_emitted = g_get_monotonic_time();
+	}
 
 	if (data->removed != NULL)
 		emit_interfaces_removed(data);
@@ -1019,11 +1079,8 @@ static void generic_unregister(DBusConnection *connection, void *user_data)
 	if (parent != NULL)
 		parent->objects = g_slist_remove(parent->objects, data);
 
-	if (data->process_id > 0) {
-		g_source_remove(data->process_id);
-		data->process_id = 0;
+	if (data->process_id > 0 || data->prop_timeout_id > 0)
 		process_changes(data);
-	}
 
 	g_slist_foreach(data->objects, reset_parent, data->parent);
 	g_slist_free(data->objects);
@@ -1467,8 +1524,9 @@ DBusMessage *g_dbus_create_reply(DBusMessage *message, int type, ...)
 	return reply;
 }
 
-static void g_dbus_flush(DBusConnection *connection)
+static void g_dbus_flush(DBusConnection *connection, DBusMessage *message)
 {
+	const char *path = dbus_message_get_path(message);
 	GSList *l;
 
 	for (l = pending; l;) {
@@ -1478,6 +1536,15 @@ static void g_dbus_flush(DBusConnection *connection)
 		if (data->conn != connection)
 			continue;
 
+		/*
+		 * Delayed property changes only have to go out ahead of
+		 * messages from their own object, flushing them for any
+		 * other message would defeat the interval.
+		 */
+		if (data->process_id == 0 && data->prop_timeout_id > 0 &&
+					g_strcmp0(path, data->path) != 0)
+			continue;
+
 		process_changes(data);
 	}
 }
@@ -1499,7 +1566,7 @@ gboolean g_dbus_send_message(DBusConnection *connection, DBusMessage *message)
 	}
 
 	/* Flush pending signal to guarantee message order */
-	g_dbus_flush(connection);
+	g_dbus_flush(connection, message);
 
 	result = dbus_connection_send(connection, message, NULL);
 
@@ -1516,7 +1583,7 @@ gboolean g_dbus_send_message_with_reply(DBusConnection *connection,
 	dbus_bool_t ret;
 
 	/* Flush pending signal to guarantee message order */
-	g_dbus_flush(connection);
+	g_dbus_flush(connection, message);
 
 	ret = dbus_connection_send_with_reply(connection, message, call,
 								timeout);
@@ -1764,7 +1831,30 @@ void g_dbus_emit_property_changed(DBusConnection *connection,
 	iface->pending_prop = g_slist_prepend(iface->pending_prop,
 						(void *) property);
 
-	add_pending(data);
+	add_pending_properties(data);
+}
+
+void g_dbus_set_property_changed_interval(unsigned int msec)
+{
+	default_prop_interval = msec;
+}
+
+gboolean g_dbus_set_object_property_changed_interval(
+					DBusConnection *connection,
+					const char *path, unsigned int msec)
+{
+	struct generic_data *data;
+
+	if (path == NULL)
+		return FALSE;
+
+	if (!dbus_connection_get_object_path_data(connection, path,
+					(void **) &data) || data == NULL)
+		return FALSE;
+
+	data->prop_interval = msec;
+
+	return TRUE;
 }
 
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
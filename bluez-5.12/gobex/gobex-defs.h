@@ -44,6 +44,8 @@ typedef enum {
 } GObexError;
 
 typedef gssize (*GObexDataProducer) (void *buf, gsize len, gpointer user_data);
+typedef gssize (*GObexDataReference) (const void **buf, gsize len,
+							gpointer user_data);
 typedef gboolean (*GObexDataConsumer) (const void *buf, gsize len,
 							gpointer user_data);
 
@@ -37,9 +37,13 @@
 
 #define G_OBEX_HDR_ENC(id)	((id) & 0xc0)
 
+/* Enough for the headers of any ordinary packet */
+#define HEADER_ARENA_SIZE	16
+
 struct _GObexHeader {
 	guint8 id;
 	gboolean extdata;
+	gboolean arena;			/* Storage owned by an arena */
 	gsize vlen;			/* Length of value */
 	gsize hlen;			/* Length of full encoded header */
 	union {
@@ -51,6 +55,11 @@ struct _GObexHeader {
 	} v;
 };
 
+struct _GObexHeaderArena {
+	GObexHeader headers[HEADER_ARENA_SIZE];
+	guint used;
+};
+
 static glong utf8_to_utf16(gunichar2 **utf16, const char *utf8) {
 	glong utf16_len;
 	int i;
@@ -135,11 +144,10 @@ gssize g_obex_header_encode(GObexHeader *header, void *buf, gsize buf_len)
 	return header->hlen;
 }
 
-GObexHeader *g_obex_header_decode(const void *data, gsize len,
-				GObexDataPolicy data_policy, gsize *parsed,
-				GError **err)
+static gboolean decode_header(GObexHeader *header, const void *data,
+				gsize len, GObexDataPolicy data_policy,
+				gsize *parsed, GError **err)
 {
-	GObexHeader *header;
 	const guint8 *ptr = data;
 	guint16 hdr_len;
 	gsize str_len;
@@ -149,11 +157,9 @@ GObexHeader *g_obex_header_decode(const void *data, gsize len,
 		g_set_error(err, G_OBEX_ERROR, G_OBEX_ERROR_PARSE_ERROR,
 						"Too short header in packet");
 		g_obex_debug(G_OBEX_DEBUG_ERROR, "%s", (*err)->message);
-		return NULL;
+		return FALSE;
 	}
 
-	header = g_new0(GObexHeader, 1);
-
 	ptr = get_bytes(&header->id, ptr, sizeof(header->id));
 
 	g_obex_debug(G_OBEX_DEBUG_HEADER, "header 0x%02x",
@@ -272,13 +278,70 @@ GObexHeader *g_obex_header_decode(const void *data, gsize len,
 		g_assert_not_reached();
 	}
 
-	return header;
+	return TRUE;
 
 failed:
 	if (*err)
 		g_obex_debug(G_OBEX_DEBUG_ERROR, "%s", (*err)->message);
-	g_obex_header_free(header);
-	return NULL;
+	return FALSE;
+}
+
+GObexHeader *g_obex_header_decode(const void *data, gsize len,
+				GObexDataPolicy data_policy, gsize *parsed,
+				GError **err)
+{
+	GObexHeader *header;
+
+	header = g_new0(GObexHeader, 1);
+
+	if (!decode_header(header, data, len, data_policy, parsed, err)) {
+		g_free(header);
+		return NULL;
+	}
+
+	return header;
+}
+
+GObexHeaderArena *g_obex_header_arena_new(void)
+{
+	return g_new0(GObexHeaderArena, 1);
+}
+
+void g_obex_header_arena_reset(GObexHeaderArena *arena)
+{
+	arena->used = 0;
+}
+
+void g_obex_header_arena_free(GObexHeaderArena *arena)
+{
+	g_free(arena);
+}
+
+/*
+ * Decodes a header into arena storage, byte array values referencing
+ * data. The header is only valid until the arena is reset and it must
+ * still be released with g_obex_header_free().
+ */
+GObexHeader *g_obex_header_decode_arena(GObexHeaderArena *arena,
+						const void *data, gsize len,
+						gsize *parsed, GError **err)
+{
+	GObexHeader *header;
+
+	if (arena->used == HEADER_ARENA_SIZE)
+		return g_obex_header_decode(data, len, G_OBEX_DATA_REF,
+								parsed, err);
+
+	header = &arena->headers[arena->used];
+	memset(header, 0, sizeof(*header));
+	header->arena = TRUE;
+
+	if (!decode_header(header, data, len, G_OBEX_DATA_REF, parsed, err))
+		return NULL;
+
+	arena->used++;
+
+	return header;
 }
 
 void g_obex_header_free(GObexHeader *header)
@@ -301,7 +364,8 @@ void g_obex_header_free(GObexHeader *header)
 		g_assert_not_reached();
 	}
 
-	g_free(header);
+	if (!header->arena)
+		g_free(header);
 }
 
 gboolean g_obex_header_get_unicode(GObexHeader *header, const char **str)
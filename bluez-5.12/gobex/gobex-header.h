@@ -73,6 +73,7 @@
 #define G_OBEX_SRMP_NEXT_WAIT		0x02
 
 typedef struct _GObexHeader GObexHeader;
+typedef struct _GObexHeaderArena GObexHeaderArena;
 
 gboolean g_obex_header_get_unicode(GObexHeader *header, const char **str);
 gboolean g_obex_header_get_bytes(GObexHeader *header, const guint8 **val,
@@ -99,4 +100,11 @@ GObexHeader *g_obex_header_decode(const void *data, gsize len,
 				GError **err);
 void g_obex_header_free(GObexHeader *header);
 
+GObexHeaderArena *g_obex_header_arena_new(void);
+void g_obex_header_arena_reset(GObexHeaderArena *arena);
+void g_obex_header_arena_free(GObexHeaderArena *arena);
+GObexHeader *g_obex_header_decode_arena(GObexHeaderArena *arena,
+						const void *data, gsize len,
+						gsize *parsed, GError **err);
+
 #endif /* __GOBEX_HEADER_H */
@@ -33,10 +33,14 @@
 
 #define FINAL_BIT 0x80
 
+#define PACKET_ARENA_LINKS 16
+
 struct _GObexPacket {
 	guint8 opcode;
 	gboolean final;
 
+	GObexPacketArena *arena;	/* Storage owner, NULL if allocated */
+
 	GObexDataPolicy data_policy;
 
 	union {
@@ -50,6 +54,23 @@ struct _GObexPacket {
 
 	GObexDataProducer get_body;
 	gpointer get_body_data;
+
+	GObexDataReference get_body_ref;
+	gpointer get_body_ref_data;
+	const void *body_ref;	/* Body referenced by the last encode */
+	gsize body_ref_len;
+};
+
+/*
+ * Storage for one received packet at a time: the packet, its header
+ * list and the headers themselves are reused instead of allocated.
+ */
+struct _GObexPacketArena {
+	GObexPacket pkt;
+	GSList links[PACKET_ARENA_LINKS];
+	GObexHeaderArena *headers;
+	gboolean in_use;
+	gboolean freed;
 };
 
 GObexHeader *g_obex_packet_get_header(GObexPacket *pkt, guint8 id)
@@ -116,7 +137,7 @@ gboolean g_obex_packet_add_body(GObexPacket *pkt, GObexDataProducer func,
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	if (pkt->get_body != NULL)
+	if (pkt->get_body != NULL || pkt->get_body_ref != NULL)
 		return FALSE;
 
 	pkt->get_body = func;
@@ -125,6 +146,27 @@ gboolean g_obex_packet_add_body(GObexPacket *pkt, GObexDataProducer func,
 	return TRUE;
 }
 
+gboolean g_obex_packet_add_body_ref(GObexPacket *pkt, GObexDataReference func,
+							gpointer user_data)
+{
+	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
+
+	if (pkt->get_body != NULL || pkt->get_body_ref != NULL)
+		return FALSE;
+
+	pkt->get_body_ref = func;
+	pkt->get_body_ref_data = user_data;
+
+	return TRUE;
+}
+
+const void *g_obex_packet_get_body_ref(GObexPacket *pkt, gsize *len)
+{
+	*len = pkt->body_ref_len;
+
+	return pkt->body_ref;
+}
+
 gboolean g_obex_packet_add_unicode(GObexPacket *pkt, guint8 id,
 							const char *str)
 {
@@ -260,10 +302,44 @@ GObexPacket *g_obex_packet_new(guint8 opcode, gboolean final,
 	return pkt;
 }
 
+static gboolean is_arena_link(GObexPacketArena *arena, GSList *l)
+{
+	return l >= arena->links && l < arena->links + PACKET_ARENA_LINKS;
+}
+
+static void arena_release(GObexPacketArena *arena)
+{
+	GObexPacket *pkt = &arena->pkt;
+	GSList *l, *next;
+
+	for (l = pkt->headers; l; l = next) {
+		next = l->next;
+
+		g_obex_header_free(l->data);
+
+		if (!is_arena_link(arena, l))
+			g_slist_free_1(l);
+	}
+
+	g_obex_header_arena_reset(arena->headers);
+	arena->in_use = FALSE;
+
+	if (arena->freed)
+		g_obex_packet_arena_free(arena);
+}
+
 void g_obex_packet_free(GObexPacket *pkt)
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
+	if (pkt->arena != NULL) {
+		if (pkt->data_policy != G_OBEX_DATA_REF)
+			g_free(pkt->data.buf);
+
+		arena_release(pkt->arena);
+		return;
+	}
+
 	switch (pkt->data_policy) {
 	case G_OBEX_DATA_INHERIT:
 	case G_OBEX_DATA_COPY:
@@ -278,24 +354,55 @@ void g_obex_packet_free(GObexPacket *pkt)
 	g_free(pkt);
 }
 
+static GObexHeader *decode_header(GObexPacket *pkt, const guint8 *buf,
+					gsize len, GObexDataPolicy data_policy,
+					gsize *parsed, GError **err)
+{
+	if (pkt->arena != NULL)
+		return g_obex_header_decode_arena(pkt->arena->headers, buf,
+							len, parsed, err);
+
+	return g_obex_header_decode(buf, len, data_policy, parsed, err);
+}
+
+static GSList *header_link(GObexPacket *pkt, guint index)
+{
+	if (pkt->arena != NULL && index < PACKET_ARENA_LINKS)
+		return &pkt->arena->links[index];
+
+	return g_slist_alloc();
+}
+
 static gboolean parse_headers(GObexPacket *pkt, const void *data, gsize len,
 						GObexDataPolicy data_policy,
 						GError **err)
 {
 	const guint8 *buf = data;
+	GSList *tail = NULL;
+	guint count = 0;
 
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
 	while (len > 0) {
 		GObexHeader *header;
+		GSList *link;
 		gsize parsed;
 
-		header = g_obex_header_decode(buf, len, data_policy, &parsed,
+		header = decode_header(pkt, buf, len, data_policy, &parsed,
 									err);
 		if (header == NULL)
 			return FALSE;
 
-		pkt->headers = g_slist_append(pkt->headers, header);
+		link = header_link(pkt, count++);
+		link->data = header;
+		link->next = NULL;
+
+		if (tail != NULL)
+			tail->next = link;
+		else
+			pkt->headers = link;
+
+		tail = link;
 		pkt->hlen += parsed;
 
 		len -= parsed;
@@ -311,10 +418,10 @@ static const guint8 *get_bytes(void *to, const guint8 *from, gsize count)
 	return (from + count);
 }
 
-GObexPacket *g_obex_packet_decode(const void *data, gsize len,
-						gsize header_offset,
-						GObexDataPolicy data_policy,
-						GError **err)
+static GObexPacket *packet_decode(GObexPacketArena *arena, const void *data,
+					gsize len, gsize header_offset,
+					GObexDataPolicy data_policy,
+					GError **err)
 {
 	const guint8 *buf = data;
 	guint16 packet_len;
@@ -353,7 +460,16 @@ GObexPacket *g_obex_packet_decode(const void *data, gsize len,
 	final = (opcode & FINAL_BIT) ? TRUE : FALSE;
 	opcode &= ~FINAL_BIT;
 
-	pkt = g_obex_packet_new(opcode, final, G_OBEX_HDR_INVALID);
+	if (arena != NULL) {
+		pkt = &arena->pkt;
+		memset(pkt, 0, sizeof(*pkt));
+		pkt->opcode = opcode;
+		pkt->final = final;
+		pkt->data_policy = G_OBEX_DATA_COPY;
+		pkt->arena = arena;
+		arena->in_use = TRUE;
+	} else
+		pkt = g_obex_packet_new(opcode, final, G_OBEX_HDR_INVALID);
 
 	if (header_offset == 0)
 		goto headers;
@@ -373,6 +489,53 @@ failed:
 	return NULL;
 }
 
+GObexPacket *g_obex_packet_decode(const void *data, gsize len,
+						gsize header_offset,
+						GObexDataPolicy data_policy,
+						GError **err)
+{
+	return packet_decode(NULL, data, len, header_offset, data_policy, err);
+}
+
+GObexPacketArena *g_obex_packet_arena_new(void)
+{
+	GObexPacketArena *arena;
+
+	arena = g_new0(GObexPacketArena, 1);
+	arena->headers = g_obex_header_arena_new();
+
+	return arena;
+}
+
+void g_obex_packet_arena_free(GObexPacketArena *arena)
+{
+	/* Released together with the packet still using it */
+	if (arena->in_use) {
+		arena->freed = TRUE;
+		return;
+	}
+
+	g_obex_header_arena_free(arena->headers);
+	g_free(arena);
+}
+
+/*
+ * Decodes a packet into arena storage with byte array headers, Body
+ * included, referencing data. The packet is valid as long as data is;
+ * if the arena is still busy a regular packet is allocated.
+ */
+GObexPacket *g_obex_packet_decode_arena(GObexPacketArena *arena,
+						const void *data, gsize len,
+						gsize header_offset,
+						GError **err)
+{
+	if (arena->in_use)
+		arena = NULL;
+
+	return packet_decode(arena, data, len, header_offset,
+						G_OBEX_DATA_REF, err);
+}
+
 static gssize get_body(GObexPacket *pkt, guint8 *buf, gsize len)
 {
 	guint16 u16;
@@ -398,10 +561,48 @@ static gssize get_body(GObexPacket *pkt, guint8 *buf, gsize len)
 	return ret;
 }
 
+/*
+ * Only the Body header itself goes into buf, the caller is expected to
+ * send the referenced data right after the encoded packet.
+ */
+static gssize get_body_ref(GObexPacket *pkt, guint8 *buf, gsize len)
+{
+	guint16 u16;
+	gssize ret;
+
+	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
+
+	pkt->body_ref = NULL;
+	pkt->body_ref_len = 0;
+
+	if (len < 3)
+		return -ENOBUFS;
+
+	ret = pkt->get_body_ref(&pkt->body_ref, len - 3,
+						pkt->get_body_ref_data);
+	if (ret < 0)
+		return ret;
+
+	if ((gsize) ret > len - 3)
+		return -ENOBUFS;
+
+	pkt->body_ref_len = ret;
+
+	if (ret > 0)
+		buf[0] = G_OBEX_HDR_BODY;
+	else
+		buf[0] = G_OBEX_HDR_BODY_END;
+
+	u16 = g_htons(ret + 3);
+	memcpy(&buf[1], &u16, sizeof(u16));
+
+	return ret;
+}
+
 gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len)
 {
 	gssize ret;
-	gsize count;
+	gsize count, ref_len = 0;
 	guint16 u16;
 	GSList *l;
 
@@ -447,9 +648,21 @@ gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len)
 		}
 
 		count += ret + 3;
+	} else if (pkt->get_body_ref) {
+		ret = get_body_ref(pkt, buf + count, len - count);
+		if (ret < 0)
+			return ret;
+		if (ret == 0) {
+			if (pkt->opcode == G_OBEX_RSP_CONTINUE)
+				buf[0] = G_OBEX_RSP_SUCCESS;
+			buf[0] |= FINAL_BIT;
+		}
+
+		count += 3;
+		ref_len = ret;
 	}
 
-	u16 = g_htons(count);
+	u16 = g_htons(count + ref_len);
 	memcpy(&buf[1], &u16, sizeof(u16));
 
 	return count;
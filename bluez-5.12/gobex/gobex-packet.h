@@ -80,6 +80,7 @@
 #define G_OBEX_RSP_DATABASE_LOCKED		0x61
 
 typedef struct _GObexPacket GObexPacket;
+typedef struct _GObexPacketArena GObexPacketArena;
 
 GObexHeader *g_obex_packet_get_header(GObexPacket *pkt, guint8 id);
 GObexHeader *g_obex_packet_get_body(GObexPacket *pkt);
@@ -88,6 +89,9 @@ gboolean g_obex_packet_prepend_header(GObexPacket *pkt, GObexHeader *header);
 gboolean g_obex_packet_add_header(GObexPacket *pkt, GObexHeader *header);
 gboolean g_obex_packet_add_body(GObexPacket *pkt, GObexDataProducer func,
 							gpointer user_data);
+gboolean g_obex_packet_add_body_ref(GObexPacket *pkt, GObexDataReference func,
+							gpointer user_data);
+const void *g_obex_packet_get_body_ref(GObexPacket *pkt, gsize *len);
 gboolean g_obex_packet_add_unicode(GObexPacket *pkt, guint8 id,
 							const char *str);
 gboolean g_obex_packet_add_bytes(GObexPacket *pkt, guint8 id,
@@ -107,6 +111,12 @@ GObexPacket *g_obex_packet_decode(const void *data, gsize len,
 						gsize header_offset,
 						GObexDataPolicy data_policy,
 						GError **err);
+GObexPacketArena *g_obex_packet_arena_new(void);
+void g_obex_packet_arena_free(GObexPacketArena *arena);
+GObexPacket *g_obex_packet_decode_arena(GObexPacketArena *arena,
+						const void *data, gsize len,
+						gsize header_offset,
+						GError **err);
 gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len);
 
 #endif /* __GOBEX_PACKET_H */
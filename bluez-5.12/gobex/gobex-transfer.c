@@ -50,6 +50,7 @@ struct transfer {
 	guint abort_id;
 
 	GObexDataProducer data_producer;
+	GObexDataReference data_reference;
 	GObexDataConsumer data_consumer;
 	GObexFunc complete_func;
 
@@ -496,17 +497,24 @@ guint g_obex_get_req(GObex *obex, GObexDataConsumer data_func,
 	return transfer->id;
 }
 
-static gssize get_get_data(void *buf, gsize len, gpointer user_data)
+static gssize get_get_data(void *buf, gsize len, gpointer user_data);
+static gssize get_get_data_ref(const void **buf, gsize len,
+							gpointer user_data);
+
+static void add_get_body(struct transfer *transfer, GObexPacket *rsp)
+{
+	if (transfer->data_reference)
+		g_obex_packet_add_body_ref(rsp, get_get_data_ref, transfer);
+	else
+		g_obex_packet_add_body(rsp, get_get_data, transfer);
+}
+
+static gssize get_get_result(struct transfer *transfer, gssize ret)
 {
-	struct transfer *transfer = user_data;
 	GObexPacket *req, *rsp;
 	GError *err = NULL;
-	gssize ret;
 	guint8 op;
 
-	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
-
-	ret = transfer->data_producer(buf, len, transfer->user_data);
 	if (ret > 0) {
 		if (!g_obex_srm_active(transfer->obex))
 			return ret;
@@ -514,7 +522,7 @@ static gssize get_get_data(void *buf, gsize len, gpointer user_data)
 		/* Generate next response */
 		rsp = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE,
 							G_OBEX_HDR_INVALID);
-		g_obex_packet_add_body(rsp, get_get_data, transfer);
+		add_get_body(transfer, rsp);
 
 		if (!g_obex_send(transfer->obex, rsp, &err)) {
 			transfer_complete(transfer, err);
@@ -546,13 +554,38 @@ static gssize get_get_data(void *buf, gsize len, gpointer user_data)
 	return ret;
 }
 
+static gssize get_get_data(void *buf, gsize len, gpointer user_data)
+{
+	struct transfer *transfer = user_data;
+	gssize ret;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
+
+	ret = transfer->data_producer(buf, len, transfer->user_data);
+
+	return get_get_result(transfer, ret);
+}
+
+static gssize get_get_data_ref(const void **buf, gsize len,
+							gpointer user_data)
+{
+	struct transfer *transfer = user_data;
+	gssize ret;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
+
+	ret = transfer->data_reference(buf, len, transfer->user_data);
+
+	return get_get_result(transfer, ret);
+}
+
 static void transfer_get_req_first(struct transfer *transfer, GObexPacket *rsp)
 {
 	GError *err = NULL;
 
 	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
 
-	g_obex_packet_add_body(rsp, get_get_data, transfer);
+	add_get_body(transfer, rsp);
 
 	if (!g_obex_send(transfer->obex, rsp, &err)) {
 		transfer_complete(transfer, err);
@@ -569,7 +602,7 @@ static void transfer_get_req(GObex *obex, GObexPacket *req, gpointer user_data)
 	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
 
 	rsp = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE, G_OBEX_HDR_INVALID);
-	g_obex_packet_add_body(rsp, get_get_data, transfer);
+	add_get_body(transfer, rsp);
 
 	if (!g_obex_send(obex, rsp, &err)) {
 		transfer_complete(transfer, err);
@@ -577,18 +610,11 @@ static void transfer_get_req(GObex *obex, GObexPacket *req, gpointer user_data)
 	}
 }
 
-guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
-			GObexDataProducer data_func, GObexFunc complete_func,
-			gpointer user_data, GError **err)
+static guint get_rsp_start(struct transfer *transfer, GObexPacket *rsp)
 {
-	struct transfer *transfer;
+	GObex *obex = transfer->obex;
 	guint id;
 
-	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p", obex);
-
-	transfer = transfer_new(obex, G_OBEX_OP_GET, complete_func, user_data);
-	transfer->data_producer = data_func;
-
 	transfer_get_req_first(transfer, rsp);
 
 	if (!g_slist_find(transfers, transfer))
@@ -607,6 +633,34 @@ guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
 	return transfer->id;
 }
 
+guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
+			GObexDataProducer data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err)
+{
+	struct transfer *transfer;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p", obex);
+
+	transfer = transfer_new(obex, G_OBEX_OP_GET, complete_func, user_data);
+	transfer->data_producer = data_func;
+
+	return get_rsp_start(transfer, rsp);
+}
+
+guint g_obex_get_rsp_pkt_ref(GObex *obex, GObexPacket *rsp,
+			GObexDataReference data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err)
+{
+	struct transfer *transfer;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p", obex);
+
+	transfer = transfer_new(obex, G_OBEX_OP_GET, complete_func, user_data);
+	transfer->data_reference = data_func;
+
+	return get_rsp_start(transfer, rsp);
+}
+
 guint g_obex_get_rsp(GObex *obex, GObexDataProducer data_func,
 			GObexFunc complete_func, gpointer user_data,
 			GError **err, guint8 first_hdr_id, ...)
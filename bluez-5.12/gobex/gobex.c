@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include "gobex.h"
 #include "gobex-debug.h"
@@ -63,6 +64,7 @@ struct _GObex {
 	gboolean (*write) (GObex *obex, GError **err);
 
 	guint8 *rx_buf;
+	GObexPacketArena *rx_arena;
 	size_t rx_data;
 	guint16 rx_pkt_len;
 	guint8 rx_last_op;
@@ -70,11 +72,18 @@ struct _GObex {
 	guint8 *tx_buf;
 	size_t tx_data;
 	size_t tx_sent;
+	const guint8 *tx_body;	/* Body referenced by the packet in tx_buf */
+	size_t tx_body_len;
 
 	gboolean suspended;
 	gboolean use_srm;
+	gboolean srm_supported;
+	GObexSrmPolicy srm_policy;
 
 	struct srm_config *srm;
+	gint64 srm_stall_start;
+
+	GObexStats stats;
 
 	guint write_source;
 
@@ -256,12 +265,82 @@ static gboolean req_timeout(gpointer user_data)
 	return FALSE;
 }
 
+/* Moves the unsent part of a referenced body into tx_buf */
+static void copy_body_ref(GObex *obex, gsize body_sent)
+{
+	memmove(obex->tx_buf, &obex->tx_buf[obex->tx_sent], obex->tx_data);
+	memcpy(&obex->tx_buf[obex->tx_data], obex->tx_body + body_sent,
+					obex->tx_body_len - body_sent);
+	obex->tx_sent = 0;
+	obex->tx_data += obex->tx_body_len - body_sent;
+
+	obex->tx_body = NULL;
+	obex->tx_body_len = 0;
+}
+
+/*
+ * Sends the encoded packet and the body it references with a single
+ * writev(). Whatever isn't sent is copied into tx_buf, so the reference
+ * is never kept past this call.
+ */
+static gssize write_body_ref(GObex *obex, GError **err)
+{
+	struct iovec iov[2];
+	gsize body_sent;
+	gssize ret;
+	int fd;
+
+	fd = g_io_channel_unix_get_fd(obex->io);
+
+	iov[0].iov_base = &obex->tx_buf[obex->tx_sent];
+	iov[0].iov_len = obex->tx_data;
+	iov[1].iov_base = (void *) obex->tx_body;
+	iov[1].iov_len = obex->tx_body_len;
+
+	ret = writev(fd, iov, 2);
+	if (ret < 0) {
+		if (errno != EAGAIN && errno != EINTR) {
+			g_set_error(err, G_IO_CHANNEL_ERROR,
+					g_io_channel_error_from_errno(errno),
+					"%s", strerror(errno));
+			obex->tx_body = NULL;
+			obex->tx_body_len = 0;
+			return -1;
+		}
+
+		ret = 0;
+	}
+
+	if ((gsize) ret < obex->tx_data) {
+		g_obex_dump(G_OBEX_DEBUG_DATA, "<", iov[0].iov_base, ret);
+
+		obex->tx_sent += ret;
+		obex->tx_data -= ret;
+		body_sent = 0;
+	} else {
+		g_obex_dump(G_OBEX_DEBUG_DATA, "<", iov[0].iov_base,
+								obex->tx_data);
+		body_sent = ret - obex->tx_data;
+		g_obex_dump(G_OBEX_DEBUG_DATA, "<", obex->tx_body, body_sent);
+
+		obex->tx_sent = 0;
+		obex->tx_data = 0;
+	}
+
+	copy_body_ref(obex, body_sent);
+
+	return ret;
+}
+
 static gboolean write_stream(GObex *obex, GError **err)
 {
 	GIOStatus status;
 	gsize bytes_written;
 	char *buf;
 
+	if (obex->tx_body_len > 0)
+		return write_body_ref(obex, err) >= 0;
+
 	buf = (char *) &obex->tx_buf[obex->tx_sent];
 	status = g_io_channel_write_chars(obex->io, buf, obex->tx_data,
 							&bytes_written, err);
@@ -282,6 +361,10 @@ static gboolean write_packet(GObex *obex, GError **err)
 	gsize bytes_written;
 	char *buf;
 
+	/* Packets can't be sent partially */
+	if (obex->tx_body_len > 0)
+		return write_body_ref(obex, err) > 0 && obex->tx_data == 0;
+
 	buf = (char *) &obex->tx_buf[obex->tx_sent];
 	status = g_io_channel_write_chars(obex->io, buf, obex->tx_data,
 							&bytes_written, err);
@@ -299,6 +382,16 @@ static gboolean write_packet(GObex *obex, GError **err)
 	return TRUE;
 }
 
+/* Policy changes only take effect between SRM operations */
+static void update_srm_policy(GObex *obex)
+{
+	if (obex->srm != NULL)
+		return;
+
+	obex->use_srm = obex->srm_supported &&
+			obex->srm_policy != G_OBEX_SRM_POLICY_DISABLED;
+}
+
 static void set_srmp(GObex *obex, guint8 srmp, gboolean outgoing)
 {
 	struct srm_config *config = obex->srm;
@@ -377,6 +470,8 @@ static void setup_srm(GObex *obex, GObexPacket *pkt, gboolean outgoing)
 	guint8 op;
 	gboolean final;
 
+	update_srm_policy(obex);
+
 	if (!obex->use_srm)
 		return;
 
@@ -428,6 +523,13 @@ static gboolean write_data(GIOChannel *io, GIOCondition cond,
 
 		/* Can't send a request while there's a pending one */
 		if (obex->pending_req && p->id > 0) {
+			/* SRM is on but the peer asked to wait */
+			if (obex->srm != NULL && obex->srm->enabled &&
+						obex->srm_stall_start == 0) {
+				obex->stats.srm_stalls++;
+				obex->srm_stall_start = g_get_monotonic_time();
+			}
+
 			g_queue_push_head(obex->tx_queue, p);
 			goto stop_tx;
 		}
@@ -445,6 +547,18 @@ encode:
 			goto done;
 		}
 
+		obex->tx_body = g_obex_packet_get_body_ref(p->pkt,
+							&obex->tx_body_len);
+
+		if (obex->srm_stall_start > 0) {
+			obex->stats.srm_stall_time += g_get_monotonic_time() -
+							obex->srm_stall_start;
+			obex->srm_stall_start = 0;
+		}
+
+		obex->stats.tx_packets++;
+		obex->stats.tx_bytes += len + obex->tx_body_len;
+
 		if (p->id > 0) {
 			if (obex->pending_req != NULL)
 				pending_pkt_free(obex->pending_req);
@@ -464,6 +578,8 @@ encode:
 	}
 
 	if (obex->suspended) {
+		if (obex->tx_body_len > 0)
+			copy_body_ref(obex, 0);
 		obex->write_source = 0;
 		return FALSE;
 	}
@@ -478,6 +594,8 @@ done:
 stop_tx:
 	obex->rx_last_op = G_OBEX_OP_NONE;
 	obex->tx_data = 0;
+	obex->tx_body = NULL;
+	obex->tx_body_len = 0;
 	obex->write_source = 0;
 	return FALSE;
 }
@@ -557,6 +675,8 @@ static void prepare_srm_rsp(GObex *obex, GObexPacket *pkt)
 {
 	GObexHeader *hdr;
 
+	update_srm_policy(obex);
+
 	if (!obex->use_srm || obex->srm == NULL)
 		return;
 
@@ -609,6 +729,8 @@ static void prepare_srm_req(GObex *obex, GObexPacket *pkt)
 {
 	GObexHeader *hdr;
 
+	update_srm_policy(obex);
+
 	if (!obex->use_srm)
 		return;
 
@@ -875,6 +997,20 @@ done:
 	return ret;
 }
 
+void g_obex_set_srm_policy(GObex *obex, GObexSrmPolicy policy)
+{
+	g_obex_debug(G_OBEX_DEBUG_COMMAND, "policy %u", policy);
+
+	obex->srm_policy = policy;
+
+	update_srm_policy(obex);
+}
+
+void g_obex_get_stats(GObex *obex, GObexStats *stats)
+{
+	*stats = obex->stats;
+}
+
 static void parse_connect_data(GObex *obex, GObexPacket *pkt)
 {
 	const struct connect_data *data;
@@ -893,6 +1029,8 @@ static void parse_connect_data(GObex *obex, GObexPacket *pkt)
 		obex->tx_mtu = obex->io_tx_mtu;
 	obex->tx_buf = g_realloc(obex->tx_buf, obex->tx_mtu);
 
+	g_obex_debug(G_OBEX_DEBUG_COMMAND, "tx_mtu %u", obex->tx_mtu);
+
 	connid = g_obex_packet_get_header(pkt, G_OBEX_HDR_CONNECTION);
 	if (connid != NULL)
 		g_obex_header_get_uint32(connid, &obex->conn_id);
@@ -1157,6 +1295,9 @@ static gboolean incoming_data(GIOChannel *io, GIOCondition cond,
 	if (obex->rx_data < 3 || obex->rx_data < obex->rx_pkt_len)
 		return TRUE;
 
+	obex->stats.rx_packets++;
+	obex->stats.rx_bytes += obex->rx_data;
+
 	obex->rx_last_op = obex->rx_buf[0] & ~FINAL_BIT;
 
 	if (obex->pending_req) {
@@ -1180,8 +1321,9 @@ static gboolean incoming_data(GIOChannel *io, GIOCondition cond,
 		goto failed;
 	}
 
-	pkt = g_obex_packet_decode(obex->rx_buf, obex->rx_data, header_offset,
-							G_OBEX_DATA_REF, &err);
+	/* Headers, Body included, are views into rx_buf */
+	pkt = g_obex_packet_decode_arena(obex->rx_arena, obex->rx_buf,
+					obex->rx_data, header_offset, &err);
 	if (pkt == NULL)
 		goto failed;
 
@@ -1288,6 +1430,7 @@ GObex *g_obex_new(GIOChannel *io, GObexTransportType transport_type,
 
 	obex->tx_queue = g_queue_new();
 	obex->rx_buf = g_malloc(obex->rx_mtu);
+	obex->rx_arena = g_obex_packet_arena_new();
 	obex->tx_buf = g_malloc(obex->tx_mtu);
 
 	switch (transport_type) {
@@ -1296,6 +1439,8 @@ GObex *g_obex_new(GIOChannel *io, GObexTransportType transport_type,
 		obex->write = write_stream;
 		break;
 	case G_OBEX_TRANSPORT_PACKET:
+		obex->srm_supported = TRUE;
+		obex->srm_policy = G_OBEX_SRM_POLICY_ENABLED;
 		obex->use_srm = TRUE;
 		obex->read = read_packet;
 		obex->write = write_packet;
@@ -1353,6 +1498,7 @@ void g_obex_unref(GObex *obex)
 		g_source_remove(obex->write_source);
 
 	g_free(obex->rx_buf);
+	g_obex_packet_arena_free(obex->rx_arena);
 	g_free(obex->tx_buf);
 	g_free(obex->srm);
 
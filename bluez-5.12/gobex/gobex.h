@@ -34,8 +34,22 @@ typedef enum {
 	G_OBEX_TRANSPORT_PACKET,
 } GObexTransportType;
 
+typedef enum {
+	G_OBEX_SRM_POLICY_DISABLED,
+	G_OBEX_SRM_POLICY_ENABLED,
+} GObexSrmPolicy;
+
 typedef struct _GObex GObex;
 
+typedef struct {
+	guint64 tx_packets;
+	guint64 tx_bytes;
+	guint64 rx_packets;
+	guint64 rx_bytes;
+	guint64 srm_stalls;	/* Requests held back by SRMP wait */
+	guint64 srm_stall_time;	/* Microseconds spent in those stalls */
+} GObexStats;
+
 typedef void (*GObexFunc) (GObex *obex, GError *err, gpointer user_data);
 typedef void (*GObexRequestFunc) (GObex *obex, GObexPacket *req,
 							gpointer user_data);
@@ -63,6 +77,8 @@ gboolean g_obex_remove_request_function(GObex *obex, guint id);
 void g_obex_suspend(GObex *obex);
 void g_obex_resume(GObex *obex);
 gboolean g_obex_srm_active(GObex *obex);
+void g_obex_set_srm_policy(GObex *obex, GObexSrmPolicy policy);
+void g_obex_get_stats(GObex *obex, GObexStats *stats);
 
 GObex *g_obex_new(GIOChannel *io, GObexTransportType transport_type,
 						gssize rx_mtu, gssize tx_mtu);
@@ -123,6 +139,10 @@ guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
 			GObexDataProducer data_func, GObexFunc complete_func,
 			gpointer user_data, GError **err);
 
+guint g_obex_get_rsp_pkt_ref(GObex *obex, GObexPacket *rsp,
+			GObexDataReference data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err);
+
 gboolean g_obex_cancel_transfer(guint id, GObexFunc complete_func,
 							gpointer user_data);
 
@@ -38,6 +38,7 @@
 #include <gdbus/gdbus.h>
 #include <gobex/gobex.h>
 
+#include "obexd.h"
 #include "dbus.h"
 #include "log.h"
 #include "transfer.h"
@@ -49,6 +50,8 @@
 #define ERROR_INTERFACE "org.bluez.obex.Error"
 #define SESSION_BASEPATH "/org/bluez/obex/client"
 
+#define BATCH_INTERVAL 1
+
 #define OBEX_IO_ERROR obex_io_error_quark()
 #define OBEX_IO_ERROR_FIRST (0xff + 1)
 
@@ -94,6 +97,16 @@ struct file_data {
 	void *user_data;
 };
 
+struct session_link {
+	struct obc_session *session;
+	guint id;
+	GObex *obex;
+	guint req_id;
+	gboolean ready;
+	guint retire_id;
+	struct pending_request *p;
+};
+
 struct obc_session {
 	guint id;
 	int refcount;
@@ -111,6 +124,13 @@ struct obc_session {
 	GQueue *queue;
 	guint process_id;
 	char *folder;
+	GSList *links;		/* Extra connections for transfers */
+	uint8_t max_links;
+	gboolean pool_failed;
+	guint batch_id;		/* Batch progress timer */
+	guint64 batch_size;	/* Totals of finished transfers */
+	guint64 batch_transferred;
+	guint64 batch_last;
 };
 
 static GSList *sessions = NULL;
@@ -209,6 +229,30 @@ static void file_data_free(void *process_data)
 	g_free(data);
 }
 
+static void link_free(struct session_link *link)
+{
+	DBG("%p", link);
+
+	if (link->retire_id > 0)
+		g_source_remove(link->retire_id);
+
+	if (link->p)
+		pending_request_free(link->p);
+
+	if (link->obex != NULL) {
+		if (link->req_id > 0)
+			g_obex_cancel_req(link->obex, link->req_id, TRUE);
+
+		g_obex_set_disconnect_function(link->obex, NULL, NULL);
+		g_obex_unref(link->obex);
+	}
+
+	if (link->id > 0)
+		link->session->transport->disconnect(link->id);
+
+	g_free(link);
+}
+
 static void session_free(struct obc_session *session)
 {
 	DBG("%p", session);
@@ -216,6 +260,11 @@ static void session_free(struct obc_session *session)
 	if (session->process_id != 0)
 		g_source_remove(session->process_id);
 
+	if (session->batch_id != 0)
+		g_source_remove(session->batch_id);
+
+	g_slist_free_full(session->links, (GDestroyNotify) link_free);
+
 	if (session->queue) {
 		g_queue_foreach(session->queue, (GFunc) pending_request_free,
 									NULL);
@@ -225,8 +274,18 @@ static void session_free(struct obc_session *session)
 	if (session->watch)
 		g_dbus_remove_watch(session->conn, session->watch);
 
-	if (session->obex != NULL)
+	if (session->obex != NULL) {
+		GObexStats stats;
+
+		g_obex_get_stats(session->obex, &stats);
+		DBG("tx %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT
+			" rx %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT
+			" srm stalls %" G_GUINT64_FORMAT " (%" G_GUINT64_FORMAT
+			" us)", stats.tx_packets, stats.tx_bytes,
+			stats.rx_packets, stats.rx_bytes, stats.srm_stalls,
+			stats.srm_stall_time);
 		g_obex_unref(session->obex);
+	}
 
 	if (session->id > 0 && session->transport != NULL)
 		session->transport->disconnect(session->id);
@@ -306,24 +365,14 @@ static void session_disconnected(GObex *obex, GError *err, gpointer user_data)
 	obc_session_shutdown(session);
 }
 
-static void transport_func(GIOChannel *io, GError *err, gpointer user_data)
+static GObex *session_obex_new(struct obc_session *session, GIOChannel *io)
 {
-	struct callback_data *callback = user_data;
-	struct obc_session *session = callback->session;
-	struct obc_driver *driver = session->driver;
 	struct obc_transport *transport = session->transport;
 	GObex *obex;
 	GObexTransportType type;
 	int tx_mtu = -1;
 	int rx_mtu = -1;
 
-	DBG("");
-
-	if (err != NULL) {
-		error("%s", err->message);
-		goto done;
-	}
-
 	g_io_channel_set_close_on_unref(io, FALSE);
 
 	if (transport->getpacketopt &&
@@ -332,20 +381,50 @@ static void transport_func(GIOChannel *io, GError *err, gpointer user_data)
 	else
 		type = G_OBEX_TRANSPORT_STREAM;
 
-	obex = g_obex_new(io, type, tx_mtu, rx_mtu);
+	obex = g_obex_new(io, type, rx_mtu, tx_mtu);
 	if (obex == NULL)
-		goto done;
+		return NULL;
+
+	if (!obex_option_srm())
+		g_obex_set_srm_policy(obex, G_OBEX_SRM_POLICY_DISABLED);
 
 	g_io_channel_set_close_on_unref(io, TRUE);
 
+	return obex;
+}
+
+static guint session_obex_connect(struct obc_session *session, GObex *obex,
+						GObexResponseFunc func,
+						gpointer user_data, GError **err)
+{
+	struct obc_driver *driver = session->driver;
+
 	if (driver->target != NULL)
-		g_obex_connect(obex, connect_cb, callback, &err,
+		return g_obex_connect(obex, func, user_data, err,
 			G_OBEX_HDR_TARGET, driver->target, driver->target_len,
 			G_OBEX_HDR_INVALID);
-	else
-		g_obex_connect(obex, connect_cb, callback, &err,
-							G_OBEX_HDR_INVALID);
 
+	return g_obex_connect(obex, func, user_data, err, G_OBEX_HDR_INVALID);
+}
+
+static void transport_func(GIOChannel *io, GError *err, gpointer user_data)
+{
+	struct callback_data *callback = user_data;
+	struct obc_session *session = callback->session;
+	GObex *obex;
+
+	DBG("");
+
+	if (err != NULL) {
+		error("%s", err->message);
+		goto done;
+	}
+
+	obex = session_obex_new(session, io);
+	if (obex == NULL)
+		goto done;
+
+	session_obex_connect(session, obex, connect_cb, callback, &err);
 	if (err != NULL) {
 		error("%s", err->message);
 		g_obex_unref(obex);
@@ -364,6 +443,125 @@ done:
 	g_free(callback);
 }
 
+static void link_remove(struct session_link *link)
+{
+	struct obc_session *session = link->session;
+
+	session->links = g_slist_remove(session->links, link);
+	link_free(link);
+}
+
+static gboolean link_retire(gpointer user_data)
+{
+	struct session_link *link = user_data;
+
+	link->retire_id = 0;
+	link_remove(link);
+
+	return FALSE;
+}
+
+static void link_retire_later(struct session_link *link)
+{
+	link->ready = FALSE;
+
+	if (link->retire_id == 0)
+		link->retire_id = g_idle_add(link_retire, link);
+}
+
+static void link_disconnected(GObex *obex, GError *err, gpointer user_data)
+{
+	struct session_link *link = user_data;
+	struct obc_session *session = link->session;
+	GError *gerr;
+
+	if (err)
+		error("%s", err->message);
+
+	obc_session_ref(session);
+
+	link->ready = FALSE;
+
+	if (link->p != NULL) {
+		gerr = g_error_new(OBEX_IO_ERROR, OBEX_IO_DISCONNECTED,
+						"Connection closed");
+		session_terminate_transfer(session, link->p->transfer, gerr);
+		g_error_free(gerr);
+	}
+
+	link_remove(link);
+
+	obc_session_unref(session);
+}
+
+static void link_connect_cb(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct session_link *link = user_data;
+	struct obc_session *session = link->session;
+	uint8_t rsp_code;
+
+	link->req_id = 0;
+
+	if (err != NULL) {
+		error("link_connect_cb: %s", err->message);
+		goto failed;
+	}
+
+	rsp_code = g_obex_packet_get_operation(rsp, NULL);
+	if (rsp_code != G_OBEX_RSP_SUCCESS) {
+		error("OBEX Connect failed with 0x%02x", rsp_code);
+		goto failed;
+	}
+
+	DBG("Link(%p) connected", link);
+
+	link->ready = TRUE;
+	session_process_queue(session);
+
+	return;
+
+failed:
+	session->pool_failed = TRUE;
+	link_retire_later(link);
+}
+
+static void link_transport_func(GIOChannel *io, GError *err,
+							gpointer user_data)
+{
+	struct session_link *link = user_data;
+	struct obc_session *session = link->session;
+	GError *gerr = NULL;
+
+	DBG("");
+
+	if (err != NULL) {
+		error("%s", err->message);
+		goto failed;
+	}
+
+	link->obex = session_obex_new(session, io);
+	if (link->obex == NULL)
+		goto failed;
+
+	g_obex_set_disconnect_function(link->obex, link_disconnected, link);
+
+	link->req_id = session_obex_connect(session, link->obex,
+						link_connect_cb, link, &gerr);
+	if (gerr != NULL) {
+		error("%s", gerr->message);
+		g_error_free(gerr);
+		goto failed;
+	}
+
+	return;
+
+failed:
+	/* Peers without room for another connection keep a single one */
+	session->pool_failed = TRUE;
+	link_retire_later(link);
+}
+
 static void owner_disconnected(DBusConnection *connection, void *user_data)
 {
 	struct obc_session *session = user_data;
@@ -563,6 +761,24 @@ void obc_session_shutdown(struct obc_session *session)
 		pending_request_free(p);
 	}
 
+	while (session->links != NULL) {
+		struct session_link *link = session->links->data;
+
+		session->links = g_slist_remove(session->links, link);
+
+		p = link->p;
+		link->p = NULL;
+
+		if (p != NULL) {
+			if (p->func)
+				p->func(session, p->transfer, err, p->data);
+
+			pending_request_free(p);
+		}
+
+		link_free(link);
+	}
+
 	while ((p = g_queue_pop_head(session->queue))) {
 		if (p->func)
 			p->func(session, p->transfer, err, p->data);
@@ -686,6 +902,166 @@ static gboolean get_channel(const GDBusPropertyTable *property,
 	return TRUE;
 }
 
+static void batch_add(struct obc_transfer *transfer, guint64 *size,
+							guint64 *transferred)
+{
+	*size += obc_transfer_get_size(transfer);
+	*transferred += obc_transfer_get_transferred(transfer);
+}
+
+/* Totals over the transfers queued since the session was last idle */
+static gboolean session_batch_get(struct obc_session *session,
+					guint64 *size, guint64 *transferred)
+{
+	gboolean active = FALSE;
+	GSList *l;
+	GList *q;
+
+	*size = session->batch_size;
+	*transferred = session->batch_transferred;
+
+	if (session->p != NULL && session->p->transfer != NULL) {
+		batch_add(session->p->transfer, size, transferred);
+		active = TRUE;
+	}
+
+	for (l = session->links; l; l = l->next) {
+		struct session_link *link = l->data;
+
+		if (link->p == NULL)
+			continue;
+
+		batch_add(link->p->transfer, size, transferred);
+		active = TRUE;
+	}
+
+	for (q = session->queue->head; q; q = q->next) {
+		struct pending_request *p = q->data;
+
+		if (p->transfer == NULL)
+			continue;
+
+		batch_add(p->transfer, size, transferred);
+		active = TRUE;
+	}
+
+	return active;
+}
+
+static gboolean batch_exists(const GDBusPropertyTable *property, void *data)
+{
+	struct obc_session *session = data;
+
+	return session->batch_id != 0;
+}
+
+static gboolean get_size(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct obc_session *session = data;
+	guint64 size, transferred;
+
+	session_batch_get(session, &size, &transferred);
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &size);
+
+	return TRUE;
+}
+
+static gboolean get_transferred(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct obc_session *session = data;
+	guint64 size, transferred;
+
+	session_batch_get(session, &size, &transferred);
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &transferred);
+
+	return TRUE;
+}
+
+static void append_stat(DBusMessageIter *dict, const char *key,
+								guint64 val)
+{
+	DBusMessageIter entry;
+
+	dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL,
+								&entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_close_container(dict, &entry);
+}
+
+static gboolean statistics_exists(const GDBusPropertyTable *property,
+								void *data)
+{
+	struct obc_session *session = data;
+
+	return session->obex != NULL;
+}
+
+static gboolean get_statistics(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct obc_session *session = data;
+	DBusMessageIter dict;
+	GObexStats stats;
+
+	g_obex_get_stats(session->obex, &stats);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_UINT64_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	append_stat(&dict, "TxPackets", stats.tx_packets);
+	append_stat(&dict, "TxBytes", stats.tx_bytes);
+	append_stat(&dict, "RxPackets", stats.rx_packets);
+	append_stat(&dict, "RxBytes", stats.rx_bytes);
+	append_stat(&dict, "SrmStalls", stats.srm_stalls);
+	append_stat(&dict, "SrmStallTime", stats.srm_stall_time);
+
+	dbus_message_iter_close_container(iter, &dict);
+
+	return TRUE;
+}
+
+static void batch_emit(struct obc_session *session)
+{
+	if (session->path == NULL)
+		return;
+
+	g_dbus_emit_property_changed(session->conn, session->path,
+						SESSION_INTERFACE, "Size");
+	g_dbus_emit_property_changed(session->conn, session->path,
+					SESSION_INTERFACE, "Transferred");
+}
+
+static gboolean batch_progress(gpointer user_data)
+{
+	struct obc_session *session = user_data;
+	guint64 size, transferred;
+
+	if (!session_batch_get(session, &size, &transferred)) {
+		session->batch_id = 0;
+		session->batch_size = 0;
+		session->batch_transferred = 0;
+		session->batch_last = 0;
+		batch_emit(session);
+		return FALSE;
+	}
+
+	if (transferred != session->batch_last) {
+		session->batch_last = transferred;
+		batch_emit(session);
+	}
+
+	return TRUE;
+}
+
 static const GDBusMethodTable session_methods[] = {
 	{ GDBUS_ASYNC_METHOD("GetCapabilities",
 				NULL, GDBUS_ARGS({ "capabilities", "s" }),
@@ -719,6 +1095,9 @@ static const GDBusPropertyTable session_properties[] = {
 	{ "Destination", "s", get_destination },
 	{ "Channel", "y", get_channel },
 	{ "Target", "s", get_target, NULL, target_exists },
+	{ "Size", "t", get_size, NULL, batch_exists },
+	{ "Transferred", "t", get_transferred, NULL, batch_exists },
+	{ "Statistics", "a{st}", get_statistics, NULL, statistics_exists },
 	{ }
 };
 
@@ -777,22 +1156,118 @@ guint obc_session_queue(struct obc_session *session,
 	p = pending_request_new(session, session_process_transfer, transfer,
 							func, user_data, NULL);
 	session_queue(p);
+
+	if (session->batch_id == 0)
+		session->batch_id = g_timeout_add_seconds(BATCH_INTERVAL,
+							batch_progress, session);
+
 	return p->id;
 }
 
-static void session_process_queue(struct obc_session *session)
+static gboolean link_can_process(struct obc_session *session,
+						struct pending_request *p)
 {
-	struct pending_request *p;
+	if (p == NULL || p->transfer == NULL)
+		return FALSE;
 
-	if (session->p != NULL)
+	/* Extra connections always stay in the root folder */
+	if (g_strcmp0(session->folder, "/") != 0)
+		return FALSE;
+
+	/* Let folder changes on the main connection settle first */
+	if (session->p != NULL && session->p->transfer == NULL)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void session_add_link(struct obc_session *session)
+{
+	struct obc_transport *transport = session->transport;
+	struct session_link *link;
+	GSList *l;
+
+	if (session->pool_failed || session->obex == NULL)
+		return;
+
+	if (g_slist_length(session->links) + 1 >= session->max_links)
+		return;
+
+	/* Open one connection at a time */
+	for (l = session->links; l; l = l->next) {
+		link = l->data;
+
+		if (!link->ready && link->retire_id == 0)
+			return;
+	}
+
+	link = g_new0(struct session_link, 1);
+	link->session = session;
+	link->id = transport->connect(session->source, session->destination,
+					session->driver->uuid, session->channel,
+					link_transport_func, link);
+	if (link->id == 0) {
+		session->pool_failed = TRUE;
+		g_free(link);
 		return;
+	}
+
+	DBG("Link(%p) connecting", link);
+
+	session->links = g_slist_append(session->links, link);
+}
+
+static void session_process_links(struct obc_session *session)
+{
+	struct pending_request *p;
+	GSList *l;
+
+again:
+	for (l = session->links; l; l = l->next) {
+		struct session_link *link = l->data;
+		GError *gerr = NULL;
+
+		if (!link->ready || link->p != NULL)
+			continue;
+
+		p = g_queue_peek_head(session->queue);
+		if (!link_can_process(session, p))
+			return;
+
+		g_queue_pop_head(session->queue);
+
+		if (obc_transfer_start(p->transfer, link->obex, &gerr)) {
+			DBG("Transfer(%p) started on link %p", p->transfer,
+									link);
+			link->p = p;
+			continue;
+		}
+
+		if (p->func)
+			p->func(session, p->transfer, gerr, p->data);
+
+		g_clear_error(&gerr);
+
+		pending_request_free(p);
+
+		/* The callback may have changed the links */
+		goto again;
+	}
+
+	if (link_can_process(session, g_queue_peek_head(session->queue)))
+		session_add_link(session);
+}
+
+static void session_process_queue(struct obc_session *session)
+{
+	struct pending_request *p;
 
 	if (session->queue == NULL || g_queue_is_empty(session->queue))
 		return;
 
 	obc_session_ref(session);
 
-	while ((p = g_queue_pop_head(session->queue))) {
+	while (session->p == NULL && (p = g_queue_pop_head(session->queue))) {
 		GError *gerr = NULL;
 
 		if (p->process(p, &gerr) == 0)
@@ -806,6 +1281,8 @@ static void session_process_queue(struct obc_session *session)
 		pending_request_free(p);
 	}
 
+	session_process_links(session);
+
 	obc_session_unref(session);
 }
 
@@ -820,15 +1297,43 @@ static int pending_transfer_cmptransfer(gconstpointer a, gconstpointer b)
 	return -1;
 }
 
+static struct session_link *find_link(struct obc_session *session,
+					struct obc_transfer *transfer)
+{
+	GSList *l;
+
+	for (l = session->links; l; l = l->next) {
+		struct session_link *link = l->data;
+
+		if (link->p != NULL && link->p->transfer == transfer)
+			return link;
+	}
+
+	return NULL;
+}
+
 static void session_terminate_transfer(struct obc_session *session,
 					struct obc_transfer *transfer,
 					GError *gerr)
 {
 	struct pending_request *p = session->p;
+	struct session_link *link;
 
 	if (p == NULL || p->transfer != transfer) {
 		GList *match;
 
+		link = find_link(session, transfer);
+		if (link != NULL) {
+			p = link->p;
+			link->p = NULL;
+
+			/* Don't reuse a connection in an unknown state */
+			if (gerr != NULL)
+				link_retire_later(link);
+
+			goto done;
+		}
+
 		match = g_list_find_custom(session->queue->head, transfer,
 						pending_transfer_cmptransfer);
 		if (match == NULL)
@@ -839,15 +1344,18 @@ static void session_terminate_transfer(struct obc_session *session,
 	} else
 		session->p = NULL;
 
+done:
 	obc_session_ref(session);
 
+	session->batch_size += obc_transfer_get_size(transfer);
+	session->batch_transferred += obc_transfer_get_transferred(transfer);
+
 	if (p->func)
 		p->func(session, p->transfer, gerr, p->data);
 
 	pending_request_free(p);
 
-	if (session->p == NULL)
-		session_process_queue(session);
+	session_process_queue(session);
 
 	obc_session_unref(session);
 }
@@ -953,6 +1461,11 @@ const char *obc_session_get_folder(struct obc_session *session)
 	return session->folder;
 }
 
+void obc_session_set_connections(struct obc_session *session, uint8_t max)
+{
+	session->max_links = max;
+}
+
 static void setpath_complete(struct obc_session *session,
 						struct obc_transfer *transfer,
 						GError *err, void *user_data)
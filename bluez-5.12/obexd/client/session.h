@@ -59,6 +59,7 @@ const void *obc_session_get_attribute(struct obc_session *session,
 							int attribute_id);
 
 const char *obc_session_get_folder(struct obc_session *session);
+void obc_session_set_connections(struct obc_session *session, uint8_t max);
 
 guint obc_session_queue(struct obc_session *session,
 				struct obc_transfer *transfer,
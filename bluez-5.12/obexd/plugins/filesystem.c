@@ -36,6 +36,7 @@
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/sendfile.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <wait.h>
 #include <inttypes.h>
@@ -74,6 +75,16 @@
 			" modified=\"%s\" mem-type=\"DEV\"" \
 			" created=\"%s\"/>" EOL_CHARS
 
+/* Completed listings are kept while the directory mtime is unchanged */
+#define LISTING_CACHE_ENTRIES	4
+#define LISTING_CACHE_MAX_SIZE	(4 * 1024 * 1024)
+#define LISTING_CACHE_MAX_AGE	30	/* seconds */
+
+/* Sequential reads of plain files are served in read-ahead windows */
+#define READ_AHEAD_SIZE		(64 * 1024)
+#define MMAP_MIN_SIZE		(1024 * 1024)
+#define MMAP_WINDOW_SIZE	(1024 * 1024)
+
 #define FTP_TARGET_SIZE 16
 
 static const uint8_t FTP_TARGET[FTP_TARGET_SIZE] = {
@@ -119,12 +130,29 @@ int verify_path(const char *path)
 	return ret;
 }
 
-static char *file_stat_line(char *filename, struct stat *fstat,
-					struct stat *dstat, gboolean root,
-					gboolean pcsuite)
+static gboolean needs_escape(const char *text)
+{
+	const char *p;
+
+	for (p = text; *p != '\0'; p++) {
+		if ((unsigned char) *p < 0x20 || strchr("&<>'\"", *p))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void append_stat_line(GString *object, const char *filename,
+					struct stat *fstat, struct stat *dstat,
+					gboolean root, gboolean pcsuite)
 {
 	char perm[51], atime[18], ctime[18], mtime[18];
-	char *escaped, *ret = NULL;
+	char *escaped = NULL;
+	const char *name = filename;
+	struct tm tm;
+
+	if (!S_ISDIR(fstat->st_mode) && !S_ISREG(fstat->st_mode))
+		return;
 
 	snprintf(perm, 50, "user-perm=\"%s%s%s\" group-perm=\"%s%s%s\" "
 			"other-perm=\"%s%s%s\"",
@@ -138,33 +166,195 @@ static char *file_stat_line(char *filename, struct stat *fstat,
 			(fstat->st_mode & S_IWOTH ? "W" : ""),
 			(dstat->st_mode & S_IWOTH ? "D" : ""));
 
-	strftime(atime, 17, "%Y%m%dT%H%M%SZ", gmtime(&fstat->st_atime));
-	strftime(ctime, 17, "%Y%m%dT%H%M%SZ", gmtime(&fstat->st_ctime));
-	strftime(mtime, 17, "%Y%m%dT%H%M%SZ", gmtime(&fstat->st_mtime));
+	strftime(atime, 17, "%Y%m%dT%H%M%SZ", gmtime_r(&fstat->st_atime, &tm));
+	strftime(ctime, 17, "%Y%m%dT%H%M%SZ", gmtime_r(&fstat->st_ctime, &tm));
+	strftime(mtime, 17, "%Y%m%dT%H%M%SZ", gmtime_r(&fstat->st_mtime, &tm));
 
-	escaped = g_markup_escape_text(filename, -1);
+	/* Most names need no escaping, avoid a copy for them */
+	if (needs_escape(filename))
+		name = escaped = g_markup_escape_text(filename, -1);
 
 	if (S_ISDIR(fstat->st_mode)) {
 		if (pcsuite && root && g_str_equal(filename, "Data"))
-			ret = g_strdup_printf(FL_FOLDER_ELEMENT_PCSUITE,
-						escaped, perm, atime,
+			g_string_append_printf(object,
+						FL_FOLDER_ELEMENT_PCSUITE,
+						name, perm, atime,
 						mtime, ctime);
 		else
-			ret = g_strdup_printf(FL_FOLDER_ELEMENT, escaped, perm,
-							atime, mtime, ctime);
-	} else if (S_ISREG(fstat->st_mode))
-		ret = g_strdup_printf(FL_FILE_ELEMENT, escaped,
+			g_string_append_printf(object, FL_FOLDER_ELEMENT,
+						name, perm, atime, mtime,
+						ctime);
+	} else
+		g_string_append_printf(object, FL_FILE_ELEMENT, name,
 					(uint64_t) fstat->st_size,
 					perm, atime, mtime, ctime);
 
 	g_free(escaped);
+}
 
-	return ret;
+struct listing_cache {
+	char *key;
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+	gint64 created;
+	GString *data;
+	int refs;
+};
+
+struct folder_listing {
+	DIR *dp;
+	struct stat dstat;
+	gboolean root;
+	gboolean utf8;
+	char *key;
+	GString *buffer;
+	size_t pos;
+	gboolean caching;
+	struct listing_cache *cache;
+};
+
+static GList *listing_cache = NULL;
+
+static struct listing_cache *listing_cache_ref(struct listing_cache *entry)
+{
+	entry->refs++;
+
+	return entry;
+}
+
+static void listing_cache_unref(struct listing_cache *entry)
+{
+	if (--entry->refs > 0)
+		return;
+
+	g_string_free(entry->data, TRUE);
+	g_free(entry->key);
+	g_free(entry);
+}
+
+static void listing_cache_remove(GList *l)
+{
+	listing_cache_unref(l->data);
+	listing_cache = g_list_delete_link(listing_cache, l);
+}
+
+static gboolean listing_cache_valid(struct listing_cache *entry,
+							struct stat *dstat)
+{
+	gint64 age = g_get_monotonic_time() - entry->created;
+
+	if (age > LISTING_CACHE_MAX_AGE * G_USEC_PER_SEC)
+		return FALSE;
+
+	if (entry->dev != dstat->st_dev || entry->ino != dstat->st_ino)
+		return FALSE;
+
+	return entry->mtime.tv_sec == dstat->st_mtim.tv_sec &&
+			entry->mtime.tv_nsec == dstat->st_mtim.tv_nsec;
+}
+
+static struct listing_cache *listing_cache_lookup(const char *key,
+							struct stat *dstat)
+{
+	GList *l;
+
+	for (l = listing_cache; l; l = l->next) {
+		struct listing_cache *entry = l->data;
+
+		if (!g_str_equal(entry->key, key))
+			continue;
+
+		if (!listing_cache_valid(entry, dstat)) {
+			listing_cache_remove(l);
+			return NULL;
+		}
+
+		/* Keep most recently used entries first */
+		listing_cache = g_list_remove_link(listing_cache, l);
+		listing_cache = g_list_concat(l, listing_cache);
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+static struct listing_cache *listing_cache_add(struct folder_listing *listing)
+{
+	struct listing_cache *entry;
+	GList *l;
+
+	l = g_list_nth(listing_cache, LISTING_CACHE_ENTRIES - 1);
+	while (l) {
+		GList *next = l->next;
+
+		listing_cache_remove(l);
+		l = next;
+	}
+
+	entry = g_new0(struct listing_cache, 1);
+	entry->key = listing->key;
+	entry->dev = listing->dstat.st_dev;
+	entry->ino = listing->dstat.st_ino;
+	entry->mtime = listing->dstat.st_mtim;
+	entry->created = g_get_monotonic_time();
+	entry->data = listing->buffer;
+	entry->refs = 1;
+
+	listing->key = NULL;
+	listing->buffer = NULL;
+
+	listing_cache = g_list_prepend(listing_cache, entry);
+
+	return listing_cache_ref(entry);
+}
+
+/*
+ * Writes within a directory don't always update its mtime, e.g. a PUT
+ * overwriting an existing file, so drop any listing of it explicitly
+ * when the file is opened for writing and again once it is closed.
+ */
+static void listing_cache_invalidate(const char *name)
+{
+	char *dir;
+	GList *l;
+
+	if (listing_cache == NULL)
+		return;
+
+	dir = g_path_get_dirname(name);
+
+	for (l = listing_cache; l;) {
+		struct listing_cache *entry = l->data;
+		GList *next = l->next;
+
+		if (g_str_equal(entry->key + 1, dir))
+			listing_cache_remove(l);
+
+		l = next;
+	}
+
+	g_free(dir);
 }
 
+struct file_object {
+	int fd;
+	off_t size;
+	off_t offset;
+	void *map;
+	size_t map_len;
+	uint8_t *buf;
+	size_t buf_len;
+	size_t buf_pos;
+	gboolean written;
+	char *name;
+};
+
 static void *filesystem_open(const char *name, int oflag, mode_t mode,
 					void *context, size_t *size, int *err)
 {
+	struct file_object *obj;
 	struct stat stats;
 	struct statvfs buf;
 	int fd, ret;
@@ -196,6 +386,8 @@ static void *filesystem_open(const char *name, int oflag, mode_t mode,
 		goto done;
 	}
 
+	listing_cache_invalidate(name);
+
 	if (fstatvfs(fd, &buf) < 0) {
 		if (err)
 			*err = -errno;
@@ -212,11 +404,22 @@ static void *filesystem_open(const char *name, int oflag, mode_t mode,
 		goto failed;
 	}
 
+	/* Reserve the blocks up front so the object is not fragmented */
+	if (*size > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, *size) < 0)
+		DBG("fallocate(): %s (%d)", strerror(errno), errno);
+
 done:
 	if (err)
 		*err = 0;
 
-	return GINT_TO_POINTER(fd);
+	obj = g_new0(struct file_object, 1);
+	obj->fd = fd;
+	obj->size = stats.st_size;
+
+	if (oflag != O_RDONLY)
+		obj->name = g_strdup(name);
+
+	return obj;
 
 failed:
 	close(fd);
@@ -225,31 +428,152 @@ failed:
 
 static int filesystem_close(void *object)
 {
-	if (close(GPOINTER_TO_INT(object)) < 0)
-		return -errno;
+	struct file_object *obj = object;
+	int err = 0;
 
-	return 0;
+	if (obj->map != NULL)
+		munmap(obj->map, obj->map_len);
+
+	if (obj->written && obex_option_fsync() != OBEX_FSYNC_NEVER &&
+							fsync(obj->fd) < 0)
+		err = -errno;
+
+	if (close(obj->fd) < 0)
+		err = -errno;
+
+	if (obj->name != NULL)
+		listing_cache_invalidate(obj->name);
+
+	g_free(obj->name);
+	g_free(obj->buf);
+	g_free(obj);
+
+	return err;
 }
 
 static ssize_t filesystem_read(void *object, void *buf, size_t count)
 {
+	struct file_object *obj = object;
 	ssize_t ret;
 
-	ret = read(GPOINTER_TO_INT(object), buf, count);
+	ret = read(obj->fd, buf, count);
 	if (ret < 0)
 		return -errno;
 
 	return ret;
 }
 
+static void file_object_setup(struct file_object *obj)
+{
+	void *map;
+
+	posix_fadvise(obj->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (!obex_option_mmap() || obj->size < MMAP_MIN_SIZE ||
+				(uint64_t) obj->size > SIZE_MAX)
+		goto fallback;
+
+	map = mmap(NULL, obj->size, PROT_READ, MAP_SHARED, obj->fd, 0);
+	if (map == MAP_FAILED) {
+		DBG("mmap(): %s (%d)", strerror(errno), errno);
+		goto fallback;
+	}
+
+	madvise(map, obj->size, MADV_SEQUENTIAL);
+	madvise(map, MIN(obj->size, 2 * MMAP_WINDOW_SIZE), MADV_WILLNEED);
+
+	obj->map = map;
+	obj->map_len = obj->size;
+
+	return;
+
+fallback:
+	obj->buf = g_malloc(READ_AHEAD_SIZE);
+}
+
+static ssize_t map_read_ref(struct file_object *obj, const void **buf,
+								size_t count)
+{
+	size_t left, next;
+
+	if ((size_t) obj->offset >= obj->map_len)
+		return 0;
+
+	left = obj->map_len - obj->offset;
+	count = MIN(count, left);
+
+	/* Entering a new window, fault in the one after it */
+	if (obj->offset / MMAP_WINDOW_SIZE !=
+				(obj->offset + count) / MMAP_WINDOW_SIZE) {
+		next = ((obj->offset + count) / MMAP_WINDOW_SIZE + 1) *
+							MMAP_WINDOW_SIZE;
+		if (next < obj->map_len)
+			madvise((uint8_t *) obj->map + next,
+				MIN(MMAP_WINDOW_SIZE, obj->map_len - next),
+				MADV_WILLNEED);
+	}
+
+	*buf = (uint8_t *) obj->map + obj->offset;
+	obj->offset += count;
+
+	return count;
+}
+
+/*
+ * Hands out a pointer into the mapping or the read-ahead buffer, which
+ * stays valid until the next call. The transport copies anything it
+ * could not send right away, so no data is kept across calls.
+ */
+static ssize_t filesystem_read_ref(void *object, const void **buf,
+								size_t count)
+{
+	struct file_object *obj = object;
+	ssize_t ret;
+
+	if (obj->map == NULL && obj->buf == NULL)
+		file_object_setup(obj);
+
+	if (obj->map != NULL)
+		return map_read_ref(obj, buf, count);
+
+	if (obj->buf_pos == obj->buf_len) {
+		ret = read(obj->fd, obj->buf, READ_AHEAD_SIZE);
+		if (ret < 0)
+			return -errno;
+
+		if (ret == 0)
+			return 0;
+
+		obj->buf_len = ret;
+		obj->buf_pos = 0;
+
+		posix_fadvise(obj->fd, obj->offset + ret, READ_AHEAD_SIZE,
+							POSIX_FADV_WILLNEED);
+	}
+
+	count = MIN(count, obj->buf_len - obj->buf_pos);
+
+	*buf = obj->buf + obj->buf_pos;
+	obj->buf_pos += count;
+	obj->offset += count;
+
+	return count;
+}
+
 static ssize_t filesystem_write(void *object, const void *buf, size_t count)
 {
+	struct file_object *obj = object;
 	ssize_t ret;
 
-	ret = write(GPOINTER_TO_INT(object), buf, count);
+	ret = write(obj->fd, buf, count);
 	if (ret < 0)
 		return -errno;
 
+	obj->written = TRUE;
+
+	if (obex_option_fsync() == OBEX_FSYNC_WRITE && fdatasync(obj->fd) < 0)
+		return -errno;
+
 	return ret;
 }
 
@@ -308,7 +632,7 @@ static int filesystem_copy(const char *name, const char *destname)
 		return -err;
 	}
 
-	in_fd = GPOINTER_TO_INT(in);
+	in_fd = ((struct file_object *) in)->fd;
 	ret = fstat(in_fd, &st);
 	if (ret < 0) {
 		error("stat(%s): %s (%d)", name, strerror(errno), errno);
@@ -323,7 +647,7 @@ static int filesystem_copy(const char *name, const char *destname)
 		return -errno;
 	}
 
-	out_fd = GPOINTER_TO_INT(out);
+	out_fd = ((struct file_object *) out)->fd;
 
 	/* Check if sendfile is supported */
 	ret = sendfile(out_fd, in_fd, NULL, 0);
@@ -459,136 +783,171 @@ fail:
 	return NULL;
 }
 
-static GString *append_pcsuite_preamble(GString *object)
+static void append_entry(struct folder_listing *listing, struct dirent *ep)
 {
-	return g_string_append(object, FL_TYPE_PCSUITE);
+	struct stat fstat;
+	char *filename = NULL;
+	const char *name = ep->d_name;
+
+	if (!listing->utf8 || !g_utf8_validate(name, -1, NULL)) {
+		filename = g_filename_to_utf8(name, -1, NULL, NULL, NULL);
+		if (filename == NULL) {
+			error("g_filename_to_utf8: invalid filename");
+			return;
+		}
+
+		name = filename;
+	}
+
+	if (fstatat(dirfd(listing->dp), ep->d_name, &fstat, 0) < 0) {
+		DBG("stat: %s(%d)", strerror(errno), errno);
+		g_free(filename);
+		return;
+	}
+
+	append_stat_line(listing->buffer, name, &fstat, &listing->dstat,
+							listing->root, FALSE);
+
+	g_free(filename);
 }
 
-static GString *append_folder_preamble(GString *object)
+static void finish_listing(struct folder_listing *listing)
 {
-	return g_string_append(object, FL_TYPE);
+	g_string_append(listing->buffer, FL_BODY_END);
+
+	closedir(listing->dp);
+	listing->dp = NULL;
+
+	if (listing->caching)
+		listing->cache = listing_cache_add(listing);
 }
 
-static GString *append_listing(GString *object, const char *name,
-				gboolean pcsuite, size_t *size, int *err)
+/* Generates entries until at least count bytes are ready to be sent */
+static void fill_listing(struct folder_listing *listing, size_t count)
 {
-	struct stat fstat, dstat;
 	struct dirent *ep;
-	DIR *dp;
-	gboolean root;
-	int ret;
 
-	root = g_str_equal(name, obex_option_root_folder());
+	while (listing->dp && listing->buffer->len - listing->pos < count) {
+		ep = readdir(listing->dp);
+		if (ep == NULL) {
+			finish_listing(listing);
+			return;
+		}
 
-	dp = opendir(name);
-	if (dp == NULL) {
-		if (err)
-			*err = -ENOENT;
-		goto failed;
+		if (ep->d_name[0] == '.')
+			continue;
+
+		append_entry(listing, ep);
 	}
 
-	if (!root)
-		object = g_string_append(object, FL_PARENT_FOLDER_ELEMENT);
+	if (!listing->caching || listing->buffer->len <= LISTING_CACHE_MAX_SIZE)
+		return;
 
-	ret = verify_path(name);
-	if (ret < 0) {
-		*err = ret;
-		goto failed;
-	}
+	/* Too big to be cached, only keep what hasn't been sent yet */
+	listing->caching = FALSE;
+	g_string_erase(listing->buffer, 0, listing->pos);
+	listing->pos = 0;
+}
 
-	ret = stat(name, &dstat);
-	if (ret < 0) {
-		if (err)
-			*err = -errno;
-		goto failed;
-	}
+static void folder_listing_free(struct folder_listing *listing)
+{
+	if (listing->dp)
+		closedir(listing->dp);
 
-	while ((ep = readdir(dp))) {
-		char *filename;
-		char *fullname;
-		char *line;
+	if (listing->cache)
+		listing_cache_unref(listing->cache);
 
-		if (ep->d_name[0] == '.')
-			continue;
+	if (listing->buffer)
+		g_string_free(listing->buffer, TRUE);
 
-		filename = g_filename_to_utf8(ep->d_name, -1, NULL, NULL, NULL);
-		if (filename == NULL) {
-			error("g_filename_to_utf8: invalid filename");
-			continue;
-		}
+	g_free(listing->key);
+	g_free(listing);
+}
 
-		fullname = g_build_filename(name, ep->d_name, NULL);
+static void *listing_open(const char *name, gboolean pcsuite, size_t *size,
+								int *err)
+{
+	struct folder_listing *listing;
+	struct listing_cache *entry;
+	int dfd, ret;
 
-		ret = stat(fullname, &fstat);
-		if (ret < 0) {
-			DBG("stat: %s(%d)", strerror(errno), errno);
-			g_free(filename);
-			g_free(fullname);
-			continue;
-		}
+	dfd = open(name, O_RDONLY | O_DIRECTORY);
+	if (dfd < 0) {
+		if (err)
+			*err = -ENOENT;
+		return NULL;
+	}
 
-		g_free(fullname);
+	ret = verify_path(name);
+	if (ret < 0) {
+		if (err)
+			*err = ret;
+		close(dfd);
+		return NULL;
+	}
 
-		line = file_stat_line(filename, &fstat, &dstat, root, FALSE);
-		if (line == NULL) {
-			g_free(filename);
-			continue;
-		}
+	listing = g_new0(struct folder_listing, 1);
+	listing->root = g_str_equal(name, obex_option_root_folder());
+	listing->utf8 = g_get_filename_charsets(NULL);
+	listing->key = g_strconcat(pcsuite ? "P" : "F", name, NULL);
 
-		g_free(filename);
+	if (fstat(dfd, &listing->dstat) < 0) {
+		if (err)
+			*err = -errno;
+		close(dfd);
+		folder_listing_free(listing);
+		return NULL;
+	}
 
-		object = g_string_append(object, line);
-		g_free(line);
+	entry = listing_cache_lookup(listing->key, &listing->dstat);
+	if (entry) {
+		DBG("%s: %zu bytes cached", name, entry->data->len);
+		close(dfd);
+		listing->cache = listing_cache_ref(entry);
+		if (size)
+			*size = entry->data->len;
+		goto done;
+	}
+
+	listing->dp = fdopendir(dfd);
+	if (listing->dp == NULL) {
+		if (err)
+			*err = -errno;
+		close(dfd);
+		folder_listing_free(listing);
+		return NULL;
 	}
 
-	closedir(dp);
+	listing->caching = TRUE;
+	listing->buffer = g_string_new(FL_VERSION);
+	g_string_append(listing->buffer, pcsuite ? FL_TYPE_PCSUITE : FL_TYPE);
+	g_string_append(listing->buffer, FL_BODY_BEGIN);
 
-	object = g_string_append(object, FL_BODY_END);
-	if (size)
-		*size = object->len;
+	if (!listing->root)
+		g_string_append(listing->buffer, FL_PARENT_FOLDER_ELEMENT);
 
+done:
 	if (err)
 		*err = 0;
 
-	return object;
-
-failed:
-	if (dp)
-		closedir(dp);
-
-	g_string_free(object, TRUE);
-	return NULL;
+	return listing;
 }
 
 static void *folder_open(const char *name, int oflag, mode_t mode,
 					void *context, size_t *size, int *err)
 {
-	GString *object;
-
-	object = g_string_new(FL_VERSION);
-	object = append_folder_preamble(object);
-	object = g_string_append(object, FL_BODY_BEGIN);
-
-	return append_listing(object, name, FALSE, size, err);
+	return listing_open(name, FALSE, size, err);
 }
 
 static void *pcsuite_open(const char *name, int oflag, mode_t mode,
 					void *context, size_t *size, int *err)
 {
-	GString *object;
-
-	object = g_string_new(FL_VERSION);
-	object = append_pcsuite_preamble(object);
-	object = g_string_append(object, FL_BODY_BEGIN);
-
-	return append_listing(object, name, TRUE, size, err);
+	return listing_open(name, TRUE, size, err);
 }
 
-static int string_free(void *object)
+static int folder_close(void *object)
 {
-	GString *string = object;
-
-	g_string_free(string, TRUE);
+	folder_listing_free(object);
 
 	return 0;
 }
@@ -610,7 +969,29 @@ ssize_t string_read(void *object, void *buf, size_t count)
 
 static ssize_t folder_read(void *object, void *buf, size_t count)
 {
-	return string_read(object, buf, count);
+	struct folder_listing *listing = object;
+	GString *data;
+	size_t len;
+
+	if (listing->cache)
+		data = listing->cache->data;
+	else {
+		fill_listing(listing, count);
+		data = listing->cache ? listing->cache->data : listing->buffer;
+	}
+
+	len = MIN(data->len - listing->pos, count);
+	memcpy(buf, data->str + listing->pos, len);
+	listing->pos += len;
+
+	/* Data no longer needed unless it is going to be cached */
+	if (data == listing->buffer && !listing->caching &&
+					listing->pos == data->len) {
+		g_string_truncate(data, 0);
+		listing->pos = 0;
+	}
+
+	return len;
 }
 
 static ssize_t capability_read(void *object, void *buf, size_t count)
@@ -658,6 +1039,7 @@ static struct obex_mime_type_driver file = {
 	.open = filesystem_open,
 	.close = filesystem_close,
 	.read = filesystem_read,
+	.read_ref = filesystem_read_ref,
 	.write = filesystem_write,
 	.remove = remove,
 	.move = filesystem_rename,
@@ -678,7 +1060,7 @@ static struct obex_mime_type_driver folder = {
 	.target_size = FTP_TARGET_SIZE,
 	.mimetype = "x-obex/folder-listing",
 	.open = folder_open,
-	.close = string_free,
+	.close = folder_close,
 	.read = folder_read,
 };
 
@@ -689,7 +1071,7 @@ static struct obex_mime_type_driver pcsuite = {
 	.who_size = PCSUITE_WHO_SIZE,
 	.mimetype = "x-obex/folder-listing",
 	.open = pcsuite_open,
-	.close = string_free,
+	.close = folder_close,
 	.read = folder_read,
 };
 
@@ -714,6 +1096,9 @@ static int filesystem_init(void)
 
 static void filesystem_exit(void)
 {
+	while (listing_cache)
+		listing_cache_remove(listing_cache);
+
 	obex_mime_type_driver_unregister(&folder);
 	obex_mime_type_driver_unregister(&capability);
 	obex_mime_type_driver_unregister(&file);
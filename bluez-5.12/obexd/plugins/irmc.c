@@ -109,7 +109,8 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 
 	DBG("bufsize %zu vcards %d missed %d", bufsize, vcards, missed);
 
-	if (irmc->request) {
+	/* Further parts are requested by irmc_read */
+	if (irmc->request && lastpart) {
 		phonebook_req_finalize(irmc->request);
 		irmc->request = NULL;
 	}
@@ -117,8 +118,6 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 	/* first add a 'owner' vcard */
 	if (!irmc->buffer)
 		irmc->buffer = g_string_new(owner_vcard);
-	else
-		irmc->buffer = g_string_append(irmc->buffer, owner_vcard);
 
 	if (buffer == NULL)
 		goto done;
@@ -427,6 +426,14 @@ static ssize_t irmc_read(void *object, void *buf, size_t count)
                 return -EAGAIN;
 
 	len = string_read(irmc->buffer, buf, count);
+	if (len == 0 && irmc->request) {
+		/* More contacts left in the backend */
+		if (phonebook_pull_read(irmc->request) < 0)
+			return -EPERM;
+
+		return -EAGAIN;
+	}
+
 	DBG("returning %d bytes", len);
 	return len;
 }
@@ -62,11 +62,22 @@
 #define ML_BODY_BEGIN "<MAP-msg-listing version=\"1.0\">"
 #define ML_BODY_END "</MAP-msg-listing>"
 
+/* Attributes a msg element carries whatever the ParameterMask says */
+#define ML_REQUIRED_MASK (PMASK_SUBJECT | PMASK_DATETIME | \
+				PMASK_RECIPIENT_ADDRESSING | PMASK_TYPE | \
+				PMASK_SIZE | PMASK_RECEPTION_STATUS | \
+				PMASK_ATTACHMENT_SIZE)
+
+#define ML_CHUNK_SIZE 4096
+
 struct mas_session {
 	struct mas_request *request;
 	void *backend_data;
 	gboolean finished;
 	gboolean nth_call;
+	uint16_t max;
+	uint16_t count;
+	uint32_t mask;
 	GString *buffer;
 	GObexApparam *inparams;
 	GObexApparam *outparams;
@@ -113,6 +124,7 @@ static void reset_request(struct mas_session *mas)
 	}
 
 	mas->nth_call = FALSE;
+	mas->count = 0;
 	mas->finished = FALSE;
 	mas->ap_sent = FALSE;
 }
@@ -236,22 +248,143 @@ static const char *yesorno(gboolean a)
 	return "no";
 }
 
+/* Escapes straight into the listing instead of allocating per attribute */
+static void append_escaped(GString *str, const char *text)
+{
+	static const char special[] = "<>&\"'\x01\x02\x03\x04\x05\x06\x07"
+				"\x08\x0b\x0c\x0e\x0f\x10\x11\x12\x13\x14"
+				"\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e"
+				"\x1f\x7f";
+
+	while (*text) {
+		size_t len = strcspn(text, special);
+
+		g_string_append_len(str, text, len);
+		text += len;
+
+		switch (*text) {
+		case '\0':
+			return;
+		case '<':
+			g_string_append(str, "&lt;");
+			break;
+		case '>':
+			g_string_append(str, "&gt;");
+			break;
+		case '&':
+			g_string_append(str, "&amp;");
+			break;
+		case '"':
+			g_string_append(str, "&quot;");
+			break;
+		case '\'':
+			g_string_append(str, "&apos;");
+			break;
+		default:
+			g_string_append_printf(str, "&#x%x;", *text);
+			break;
+		}
+
+		text++;
+	}
+}
+
+static void append_attr(GString *str, const char *name, const char *value)
+{
+	g_string_append_c(str, ' ');
+	g_string_append(str, name);
+	g_string_append(str, "=\"");
+	append_escaped(str, value ? value : "");
+	g_string_append_c(str, '"');
+}
+
+static void append_msg(GString *str, const struct messages_message *entry,
+								uint32_t mask)
+{
+	g_string_append(str, "<msg");
+
+	append_attr(str, "handle", entry->handle);
+
+	if (mask & PMASK_SUBJECT)
+		append_attr(str, "subject", entry->subject);
+
+	if (mask & PMASK_DATETIME)
+		append_attr(str, "datetime", entry->datetime);
+
+	if (mask & PMASK_SENDER_NAME)
+		append_attr(str, "sender_name", entry->sender_name);
+
+	if (mask & PMASK_SENDER_ADDRESSING)
+		append_attr(str, "sender_addressing",
+						entry->sender_addressing);
+
+	if (mask & PMASK_REPLYTO_ADDRESSING)
+		append_attr(str, "replyto_addressing",
+						entry->replyto_addressing);
+
+	if (mask & PMASK_RECIPIENT_NAME)
+		append_attr(str, "recipient_name", entry->recipient_name);
+
+	if (mask & PMASK_RECIPIENT_ADDRESSING)
+		append_attr(str, "recipient_addressing",
+						entry->recipient_addressing);
+
+	if (mask & PMASK_TYPE)
+		append_attr(str, "type", entry->type);
+
+	if (mask & PMASK_RECEPTION_STATUS)
+		append_attr(str, "reception_status", entry->reception_status);
+
+	if (mask & PMASK_SIZE)
+		append_attr(str, "size", entry->size);
+
+	if (mask & PMASK_ATTACHMENT_SIZE)
+		append_attr(str, "attachment_size", entry->attachment_size);
+
+	if (mask & PMASK_TEXT)
+		append_attr(str, "text", yesorno(entry->text));
+
+	if (mask & PMASK_READ)
+		append_attr(str, "read", yesorno(entry->read));
+
+	if (mask & PMASK_SENT)
+		append_attr(str, "sent", yesorno(entry->sent));
+
+	if (mask & PMASK_PROTECTED)
+		append_attr(str, "protected", yesorno(entry->protect));
+
+	if (mask & PMASK_PRIORITY)
+		append_attr(str, "priority", yesorno(entry->priority));
+
+	g_string_append(str, "/>\n");
+}
+
+static void set_listing_params(struct mas_session *mas, uint16_t size,
+							gboolean newmsg)
+{
+	if (size > 0 || mas->finished)
+		mas->outparams = g_obex_apparam_set_uint16(mas->outparams,
+						MAP_AP_MESSAGESLISTINGSIZE,
+						size);
+
+	mas->outparams = g_obex_apparam_set_uint8(mas->outparams,
+						MAP_AP_NEWMESSAGE,
+						newmsg ? 1 : 0);
+}
+
 static void get_messages_listing_cb(void *session, int err, uint16_t size,
 					gboolean newmsg,
 					const struct messages_message *entry,
 					void *user_data)
 {
 	struct mas_session *mas = user_data;
-	uint16_t max = 1024;
 
 	if (err < 0 && err != -EAGAIN) {
 		obex_object_set_io_flags(mas, G_IO_ERR, err);
 		return;
 	}
 
-	g_obex_apparam_get_uint16(mas->inparams, MAP_AP_MAXLISTCOUNT, &max);
-
-	if (max == 0) {
+	if (mas->max == 0) {
 		if (!entry)
 			mas->finished = TRUE;
 
@@ -270,93 +403,31 @@ static void get_messages_listing_cb(void *session, int err, uint16_t size,
 		goto proceed;
 	}
 
-	g_string_append(mas->buffer, "<msg");
-
-	g_string_append_escaped_printf(mas->buffer, " handle=\"%s\"",
-								entry->handle);
-
-	if (entry->mask & PMASK_SUBJECT)
-		g_string_append_escaped_printf(mas->buffer, " subject=\"%s\"",
-				entry->subject);
-
-	if (entry->mask & PMASK_DATETIME)
-		g_string_append_escaped_printf(mas->buffer, " datetime=\"%s\"",
-				entry->datetime);
-
-	if (entry->mask & PMASK_SENDER_NAME)
-		g_string_append_escaped_printf(mas->buffer,
-						" sender_name=\"%s\"",
-						entry->sender_name);
-
-	if (entry->mask & PMASK_SENDER_ADDRESSING)
-		g_string_append_escaped_printf(mas->buffer,
-						" sender_addressing=\"%s\"",
-						entry->sender_addressing);
-
-	if (entry->mask & PMASK_REPLYTO_ADDRESSING)
-		g_string_append_escaped_printf(mas->buffer,
-						" replyto_addressing=\"%s\"",
-						entry->replyto_addressing);
-
-	if (entry->mask & PMASK_RECIPIENT_NAME)
-		g_string_append_escaped_printf(mas->buffer,
-						" recipient_name=\"%s\"",
-						entry->recipient_name);
-
-	if (entry->mask & PMASK_RECIPIENT_ADDRESSING)
-		g_string_append_escaped_printf(mas->buffer,
-						" recipient_addressing=\"%s\"",
-						entry->recipient_addressing);
-
-	if (entry->mask & PMASK_TYPE)
-		g_string_append_escaped_printf(mas->buffer, " type=\"%s\"",
-				entry->type);
-
-	if (entry->mask & PMASK_RECEPTION_STATUS)
-		g_string_append_escaped_printf(mas->buffer,
-						" reception_status=\"%s\"",
-						entry->reception_status);
-
-	if (entry->mask & PMASK_SIZE)
-		g_string_append_escaped_printf(mas->buffer, " size=\"%s\"",
-				entry->size);
-
-	if (entry->mask & PMASK_ATTACHMENT_SIZE)
-		g_string_append_escaped_printf(mas->buffer,
-						" attachment_size=\"%s\"",
-						entry->attachment_size);
-
-	if (entry->mask & PMASK_TEXT)
-		g_string_append_escaped_printf(mas->buffer, " text=\"%s\"",
-				yesorno(entry->text));
-
-	if (entry->mask & PMASK_READ)
-		g_string_append_escaped_printf(mas->buffer, " read=\"%s\"",
-				yesorno(entry->read));
+	/* Page and mask before spending time on formatting */
+	if (mas->count >= mas->max)
+		goto proceed;
 
-	if (entry->mask & PMASK_SENT)
-		g_string_append_escaped_printf(mas->buffer, " sent=\"%s\"",
-				yesorno(entry->sent));
+	mas->count++;
 
-	if (entry->mask & PMASK_PROTECTED)
-		g_string_append_escaped_printf(mas->buffer, " protected=\"%s\"",
-				yesorno(entry->protect));
+	append_msg(mas->buffer, entry, entry->mask & mas->mask);
 
-	if (entry->mask & PMASK_PRIORITY)
-		g_string_append_escaped_printf(mas->buffer, " priority=\"%s\"",
-				yesorno(entry->priority));
+	/*
+	 * Hand big listings to the transport as they grow rather than
+	 * once the backend is done. Application parameters go out with
+	 * the first body chunk, so hold it back until the backend has
+	 * reported the MessagesListingSize.
+	 */
+	if (mas->buffer->len >= ML_CHUNK_SIZE && (mas->ap_sent || size > 0)) {
+		if (!mas->ap_sent)
+			set_listing_params(mas, size, newmsg);
 
-	g_string_append(mas->buffer, "/>\n");
+		obex_object_set_io_flags(mas, G_IO_IN, 0);
+		return;
+	}
 
 proceed:
-	if (!entry) {
-		mas->outparams = g_obex_apparam_set_uint16(mas->outparams,
-						MAP_AP_MESSAGESLISTINGSIZE,
-						size);
-		mas->outparams = g_obex_apparam_set_uint8(mas->outparams,
-						MAP_AP_NEWMESSAGE,
-						newmsg ? 1 : 0);
-	}
+	if (!entry && !mas->ap_sent)
+		set_listing_params(mas, size, newmsg);
 
 	if (err != -EAGAIN)
 		obex_object_set_io_flags(mas, G_IO_IN, 0);
@@ -548,12 +619,20 @@ static void *msg_listing_open(const char *name, int oflag, mode_t mode,
 	g_obex_apparam_get_uint8(mas->inparams, MAP_AP_FILTERPRIORITY,
 						&filter.priority);
 
+	mas->max = max;
+	mas->count = 0;
+
+	if (filter.parameter_mask == 0)
+		mas->mask = G_MAXUINT32;
+	else
+		mas->mask = filter.parameter_mask | ML_REQUIRED_MASK;
+
+	mas->buffer = g_string_sized_new(max > 0 ? ML_CHUNK_SIZE : 0);
+
 	*err = messages_get_messages_listing(mas->backend_data, name, max,
 			offset, subject_len, &filter,
 			get_messages_listing_cb, mas);
 
-	mas->buffer = g_string_new("");
-
 	if (*err < 0)
 		return NULL;
 	else
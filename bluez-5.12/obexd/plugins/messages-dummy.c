@@ -26,6 +26,7 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -37,10 +38,19 @@
 
 static char *root_folder = NULL;
 
+/* Sorted subfolders of the last listed folder, reused while paging */
+struct folder_cache {
+	char *path;
+	struct timespec mtime;
+	GSList *names;
+	size_t count;
+};
+
 struct session {
 	char *cwd;
 	char *cwd_absolute;
 	void *request;
+	struct folder_cache cache;
 };
 
 struct folder_listing_data {
@@ -114,13 +124,41 @@ static char *get_next_subdir(DIR *dp, char *path)
 	return name;
 }
 
-static ssize_t get_subdirs(struct folder_listing_data *fld, GSList **list)
+static void folder_cache_clear(struct folder_cache *cache)
+{
+	g_free(cache->path);
+	g_slist_free_full(cache->names, g_free);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static ssize_t get_subdirs(struct folder_listing_data *fld)
 {
+	struct folder_cache *cache = &fld->session->cache;
+	struct stat st;
 	DIR *dp;
 	char *path, *name;
+	GSList *list = NULL;
 	size_t n;
 
 	path = g_build_filename(fld->session->cwd_absolute, fld->name, NULL);
+
+	if (stat(path, &st) < 0) {
+		int err = -errno;
+
+		DBG("stat(): %d, %s", -err, strerror(-err));
+		g_free(path);
+
+		return err;
+	}
+
+	/* Folders only change when entries are added or removed */
+	if (g_strcmp0(cache->path, path) == 0 &&
+			cache->mtime.tv_sec == st.st_mtim.tv_sec &&
+			cache->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+		g_free(path);
+		return cache->count;
+	}
+
 	dp = opendir(path);
 
 	if (dp == NULL) {
@@ -136,19 +174,22 @@ static ssize_t get_subdirs(struct folder_listing_data *fld, GSList **list)
 
 	while ((name = get_next_subdir(dp, path)) != NULL) {
 		n++;
-		if (fld->max > 0)
-			*list = g_slist_prepend(*list, name);
+		list = g_slist_prepend(list, name);
 	}
 
 	closedir(dp);
-	g_free(path);
 
-	*list = g_slist_sort_with_data(*list, folder_names_cmp, fld->session);
+	folder_cache_clear(cache);
+	cache->path = path;
+	cache->mtime = st.st_mtim;
+	cache->names = g_slist_sort_with_data(list, folder_names_cmp,
+								fld->session);
+	cache->count = n;
 
 	return n;
 }
 
-static void return_folder_listing(struct folder_listing_data *fld, GSList *list)
+static void return_folder_listing(struct folder_listing_data *fld)
 {
 	struct session *session = fld->session;
 	GSList *cur;
@@ -165,11 +206,12 @@ static void return_folder_listing(struct folder_listing_data *fld, GSList *list)
 		offs++;
 	}
 
-	for (cur = list; offs < fld->offset; offs++) {
-		cur = cur->next;
-		if (cur == NULL)
-			break;
-	}
+	if (fld->offset > offs)
+		offs = fld->offset - offs;
+	else
+		offs = 0;
+
+	cur = g_slist_nth(session->cache.names, offs);
 
 	for (; cur != NULL && num < fld->max; cur = cur->next, num++)
 		fld->callback(session, -EAGAIN, 0, cur->data, fld->user_data);
@@ -181,9 +223,8 @@ static gboolean get_folder_listing(void *d)
 {
 	struct folder_listing_data *fld = d;
 	ssize_t n;
-	GSList *list = NULL;
 
-	n = get_subdirs(fld, &list);
+	n = get_subdirs(fld);
 
 	if (n < 0) {
 		fld->callback(fld->session, n, 0, NULL, fld->user_data);
@@ -195,8 +236,7 @@ static gboolean get_folder_listing(void *d)
 		return FALSE;
 	}
 
-	return_folder_listing(fld, list);
-	g_slist_free_full(list, g_free);
+	return_folder_listing(fld);
 
 	return FALSE;
 }
@@ -246,6 +286,7 @@ void messages_disconnect(void *s)
 {
 	struct session *session = s;
 
+	folder_cache_clear(&session->cache);
 	g_free(session->cwd);
 	g_free(session->cwd_absolute);
 	g_free(session);
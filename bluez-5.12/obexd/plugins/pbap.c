@@ -65,10 +65,16 @@
 #define PHONEBOOKSIZE_TAG	0X08
 #define NEWMISSEDCALLS_TAG	0X09
 
+#define ORDER_INDEXED		0x00
+#define ORDER_ALPHANUMERIC	0x01
+#define ORDER_PHONETIC		0x02
+
 struct cache {
 	gboolean valid;
 	uint32_t index;
-	GSList *entries;
+	GPtrArray *entries;
+	GHashTable *handles;		/* handle -> entry */
+	GPtrArray *sorted[3];		/* entries per sort order */
 };
 
 struct cache_entry {
@@ -153,22 +159,49 @@ static gboolean entry_tel_find(const struct cache_entry *entry,
 
 static const char *cache_find(struct cache *cache, uint32_t handle)
 {
-	GSList *l;
+	struct cache_entry *entry;
 
-	for (l = cache->entries; l; l = l->next) {
-		struct cache_entry *entry = l->data;
+	if (cache->handles == NULL)
+		return NULL;
 
-		if (entry->handle == handle)
-			return entry->id;
-	}
+	entry = g_hash_table_lookup(cache->handles, GUINT_TO_POINTER(handle));
+	if (entry == NULL)
+		return NULL;
 
-	return NULL;
+	return entry->id;
+}
+
+static guint cache_size(struct cache *cache)
+{
+	return cache->entries ? cache->entries->len : 0;
+}
+
+static void cache_sorted_clear(struct cache *cache)
+{
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(cache->sorted); i++) {
+		if (cache->sorted[i] == NULL)
+			continue;
+
+		g_ptr_array_free(cache->sorted[i], TRUE);
+		cache->sorted[i] = NULL;
+	}
 }
 
 static void cache_clear(struct cache *cache)
 {
-	g_slist_free_full(cache->entries, cache_entry_free);
-	cache->entries = NULL;
+	cache_sorted_clear(cache);
+
+	if (cache->handles != NULL) {
+		g_hash_table_destroy(cache->handles);
+		cache->handles = NULL;
+	}
+
+	if (cache->entries != NULL) {
+		g_ptr_array_free(cache->entries, TRUE);
+		cache->entries = NULL;
+	}
 }
 
 static void phonebook_size_result(const char *buffer, size_t bufsize,
@@ -262,64 +295,107 @@ static void cache_entry_notify(const char *id, uint32_t handle,
 	entry->sound = g_strdup(sound);
 	entry->tel = g_strdup(tel);
 
-	cache->entries = g_slist_append(cache->entries, entry);
+	if (cache->entries == NULL) {
+		cache->entries = g_ptr_array_new_with_free_func(
+							cache_entry_free);
+		cache->handles = g_hash_table_new(g_direct_hash,
+							g_direct_equal);
+	}
+
+	g_ptr_array_add(cache->entries, entry);
+
+	/* Keep the first entry for duplicated handles */
+	if (g_hash_table_lookup(cache->handles,
+					GUINT_TO_POINTER(entry->handle)) == NULL)
+		g_hash_table_insert(cache->handles,
+					GUINT_TO_POINTER(entry->handle), entry);
+
+	cache_sorted_clear(cache);
 }
 
-static int alpha_sort(gconstpointer a, gconstpointer b)
+/* Sort functions get pointers to the array elements */
+static int indexed_sort(gconstpointer a, gconstpointer b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
+
+	if (e1->handle == e2->handle)
+		return 0;
 
-	return g_strcmp0(e1->name, e2->name);
+	return e1->handle < e2->handle ? -1 : 1;
 }
 
-static int indexed_sort(gconstpointer a, gconstpointer b)
+static int alpha_sort(gconstpointer a, gconstpointer b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
+	int ret;
+
+	ret = g_strcmp0(e1->name, e2->name);
+	if (ret != 0)
+		return ret;
 
-	return (e1->handle - e2->handle);
+	return indexed_sort(a, b);
 }
 
 static int phonetical_sort(gconstpointer a, gconstpointer b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
+	int ret;
 
 	/* SOUND attribute is optional. Use Indexed sort if not present. */
 	if (!e1->sound || !e2->sound)
 		return indexed_sort(a, b);
 
-	return g_strcmp0(e1->sound, e2->sound);
+	ret = g_strcmp0(e1->sound, e2->sound);
+	if (ret != 0)
+		return ret;
+
+	return indexed_sort(a, b);
 }
 
-static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
-							const char *value)
+/*
+ * Default sorter is "Indexed". Some backends doesn't inform the index,
+ * for this case a sequential internal index is assigned. Each order is
+ * sorted once per cache fill and reused by later listing requests.
+ */
+static GPtrArray *cache_sorted(struct cache *cache, uint8_t order)
 {
-	GSList *sorted = NULL;
-	cache_entry_find_f find;
+	GPtrArray *sorted;
 	GCompareFunc sort;
-	char *searchval;
+	guint i;
 
-	/*
-	 * Default sorter is "Indexed". Some backends doesn't inform the index,
-	 * for this case a sequential internal index is assigned.
-	 * 0x00 = indexed
-	 * 0x01 = alphanumeric
-	 * 0x02 = phonetic
-	 */
 	switch (order) {
-	case 0x01:
+	case ORDER_ALPHANUMERIC:
 		sort = alpha_sort;
 		break;
-	case 0x02:
+	case ORDER_PHONETIC:
 		sort = phonetical_sort;
 		break;
 	default:
+		order = ORDER_INDEXED;
 		sort = indexed_sort;
 		break;
 	}
 
+	if (cache->sorted[order] != NULL)
+		return cache->sorted[order];
+
+	sorted = g_ptr_array_sized_new(cache_size(cache));
+
+	for (i = 0; i < cache_size(cache); i++)
+		g_ptr_array_add(sorted, g_ptr_array_index(cache->entries, i));
+
+	g_ptr_array_sort(sorted, sort);
+
+	cache->sorted[order] = sorted;
+
+	return sorted;
+}
+
+static cache_entry_find_f search_func(uint8_t search_attrib)
+{
 	/*
 	 * This implementation checks if the given field CONTAINS the
 	 * search value(case insensitive). Name is the default field
@@ -328,44 +404,40 @@ static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
 	switch (search_attrib) {
 		/* Number */
 		case 1:
-			find = entry_tel_find;
-			break;
+			return entry_tel_find;
 		/* Sound */
 		case 2:
-			find = entry_sound_find;
-			break;
+			return entry_sound_find;
 		default:
-			find = entry_name_find;
-			break;
+			return entry_name_find;
 	}
+}
 
-	searchval = value ? g_utf8_strdown(value, -1) : NULL;
-	for (; l; l = l->next) {
-		struct cache_entry *entry = l->data;
-
-		if (searchval && !find(entry, (const char *) searchval))
-			continue;
-
-		sorted = g_slist_insert_sorted(sorted, entry, sort);
-	}
+static void append_entry(GString *buffer, const struct cache_entry *entry)
+{
+	char *escaped_name = g_markup_escape_text(entry->name, -1);
 
-	g_free(searchval);
+	g_string_append_printf(buffer, VCARD_LISTING_ELEMENT, entry->handle,
+								escaped_name);
 
-	return sorted;
+	g_free(escaped_name);
 }
 
 static int generate_response(void *user_data)
 {
 	struct pbap_session *pbap = user_data;
-	GSList *sorted;
-	GSList *l;
+	GPtrArray *sorted;
+	cache_entry_find_f find;
+	char *searchval;
 	uint16_t max = pbap->params->maxlistcount;
+	uint16_t offset = pbap->params->liststartoffset;
+	guint i;
 
 	DBG("");
 
 	if (max == 0) {
 		/* Ignore all other parameter and return PhoneBookSize */
-		uint16_t size = htons(g_slist_length(pbap->cache.entries));
+		uint16_t size = htons(cache_size(&pbap->cache));
 
 		pbap->obj->apparam = g_obex_apparam_set_uint16(
 							pbap->obj->apparam,
@@ -375,31 +447,44 @@ static int generate_response(void *user_data)
 		return 0;
 	}
 
-	/*
-	 * Don't free the sorted list content: this list contains
-	 * only the reference for the "real" cache entry.
-	 */
-	sorted = sort_entries(pbap->cache.entries, pbap->params->order,
-				pbap->params->searchattrib,
-				(const char *) pbap->params->searchval);
-
-	/* Computing offset considering first entry of the phonebook */
-	l = g_slist_nth(sorted, pbap->params->liststartoffset);
+	sorted = cache_sorted(&pbap->cache, pbap->params->order);
 
 	pbap->obj->buffer = g_string_new(VCARD_LISTING_BEGIN);
-	for (; l && max; l = l->next, max--) {
-		const struct cache_entry *entry = l->data;
-		char *escaped_name = g_markup_escape_text(entry->name, -1);
 
-		g_string_append_printf(pbap->obj->buffer,
-			VCARD_LISTING_ELEMENT, entry->handle, escaped_name);
+	if (pbap->params->searchval == NULL) {
+		/* Computing offset considering first entry of the phonebook */
+		for (i = offset; i < sorted->len && max; i++, max--)
+			append_entry(pbap->obj->buffer,
+					g_ptr_array_index(sorted, i));
+
+		goto done;
+	}
+
+	find = search_func(pbap->params->searchattrib);
+	searchval = g_utf8_strdown((const char *) pbap->params->searchval,
+									-1);
+
+	/* Offset counts matching entries only */
+	for (i = 0; i < sorted->len && max; i++) {
+		const struct cache_entry *entry = g_ptr_array_index(sorted, i);
 
-		g_free(escaped_name);
+		if (!find(entry, searchval))
+			continue;
+
+		if (offset > 0) {
+			offset--;
+			continue;
+		}
+
+		append_entry(pbap->obj->buffer, entry);
+		max--;
 	}
 
+	g_free(searchval);
+
+done:
 	pbap->obj->buffer = g_string_append(pbap->obj->buffer,
 							VCARD_LISTING_END);
-	g_slist_free(sorted);
 
 	return 0;
 }
@@ -44,47 +44,41 @@
 #include "log.h"
 #include "phonebook.h"
 
+/* Phonebook pulls are returned in parts of about this size */
+#define VCARDS_PART_SIZE	(32 * 1024)
+
 typedef void (*vcard_func_t) (const char *file, VObject *vo, void *user_data);
 
+/* All requests are freed by phonebook_req_finalize */
 struct dummy_data {
 	phonebook_cb cb;
+	phonebook_entry_cb entry_cb;
+	phonebook_cache_ready_cb ready_cb;
 	void *user_data;
 	const struct apparam_field *apparams;
 	char *folder;
 	int fd;
 	guint id;
-};
-
-struct cache_query {
-	phonebook_entry_cb entry_cb;
-	phonebook_cache_ready_cb ready_cb;
-	void *user_data;
 	DIR *dp;
+	GSList *files;		/* vCard files left to be pulled */
+	uint16_t left;		/* vCards left to be pulled */
 };
 
 static char *root_folder = NULL;
 
-static void dummy_free(void *user_data)
+static void dummy_free(struct dummy_data *dummy)
 {
-	struct dummy_data *dummy = user_data;
-
 	if (dummy->fd >= 0)
 		close(dummy->fd);
 
+	if (dummy->dp)
+		closedir(dummy->dp);
+
+	g_slist_free_full(dummy->files, g_free);
 	g_free(dummy->folder);
 	g_free(dummy);
 }
 
-static void query_free(void *user_data)
-{
-	struct cache_query *query = user_data;
-
-	if (query->dp)
-		closedir(query->dp);
-
-	g_free(query);
-}
-
 int phonebook_init(void)
 {
 	if (root_folder)
@@ -117,22 +111,10 @@ static int handle_cmp(gconstpointer a, gconstpointer b)
 	return (i1 - i2);
 }
 
-static int foreach_vcard(DIR *dp, vcard_func_t func, uint16_t offset,
-			uint16_t maxlistcount, void *user_data, uint16_t *count)
+static GSList *sorted_vcards(DIR *dp)
 {
 	struct dirent *ep;
-	GSList *sorted = NULL, *l;
-	VObject *v;
-	FILE *fp;
-	int err, fd, folderfd;
-	uint16_t n = 0;
-
-	folderfd = dirfd(dp);
-	if (folderfd < 0) {
-		err = errno;
-		error("dirfd(): %s(%d)", strerror(err), err);
-		return -err;
-	}
+	GSList *sorted = NULL;
 
 	/*
 	 * Sorting vcards by file name. versionsort is a GNU extension.
@@ -160,30 +142,65 @@ static int foreach_vcard(DIR *dp, vcard_func_t func, uint16_t offset,
 		sorted = g_slist_insert_sorted(sorted, filename, handle_cmp);
 	}
 
+	return sorted;
+}
+
+static gboolean load_vcard(int folderfd, const char *filename,
+					vcard_func_t func, void *user_data)
+{
+	VObject *v;
+	FILE *fp;
+	int err, fd;
+
+	fd = openat(folderfd, filename, O_RDONLY);
+	if (fd < 0) {
+		err = errno;
+		error("openat(%s): %s(%d)", filename, strerror(err), err);
+		return FALSE;
+	}
+
+	fp = fdopen(fd, "r");
+	if (fp == NULL) {
+		close(fd);
+		return FALSE;
+	}
+
+	v = Parse_MIME_FromFile(fp);
+	fclose(fp);
+
+	if (v == NULL)
+		return FALSE;
+
+	func(filename, v, user_data);
+	deleteVObject(v);
+
+	return TRUE;
+}
+
+static int foreach_vcard(DIR *dp, vcard_func_t func, uint16_t offset,
+			uint16_t maxlistcount, void *user_data, uint16_t *count)
+{
+	GSList *sorted, *l;
+	int err, folderfd;
+	uint16_t n = 0;
+
+	folderfd = dirfd(dp);
+	if (folderfd < 0) {
+		err = errno;
+		error("dirfd(): %s(%d)", strerror(err), err);
+		return -err;
+	}
+
+	sorted = sorted_vcards(dp);
+
 	/*
 	 * Filtering only the requested vCards attributes. Offset
 	 * shall be based on the first entry of the phonebook.
 	 */
 	for (l = g_slist_nth(sorted, offset);
 			l && n < maxlistcount; l = l->next) {
-		const char *filename = l->data;
-
-		fd = openat(folderfd, filename, O_RDONLY);
-		if (fd < 0) {
-			err = errno;
-			error("openat(%s): %s(%d)", filename, strerror(err), err);
-			continue;
-		}
-
-		fp = fdopen(fd, "r");
-		v = Parse_MIME_FromFile(fp);
-		if (v != NULL) {
-			func(filename, v, user_data);
-			deleteVObject(v);
+		if (load_vcard(folderfd, l->data, func, user_data))
 			n++;
-		}
-
-		close(fd);
 	}
 
 	g_slist_free_full(sorted, g_free);
@@ -200,6 +217,10 @@ static void entry_concat(const char *filename, VObject *v, void *user_data)
 	char tmp[1024];
 	int len;
 
+	/* Only counting vCards */
+	if (buffer == NULL)
+		return;
+
 	/*
 	 * VObject API uses len for IN and OUT
 	 * Written bytes is also returned in the len variable
@@ -213,22 +234,26 @@ static void entry_concat(const char *filename, VObject *v, void *user_data)
 	g_string_append_len(buffer, tmp, len);
 }
 
-static gboolean read_dir(void *user_data)
+static int open_dir(struct dummy_data *dummy)
 {
-	struct dummy_data *dummy = user_data;
-	GString *buffer;
-	DIR *dp;
-	uint16_t count = 0, max, offset;
-
-	buffer = g_string_new("");
+	uint16_t offset;
+	GSList *l;
 
-	dp = opendir(dummy->folder);
-	if (dp == NULL) {
+	dummy->dp = opendir(dummy->folder);
+	if (dummy->dp == NULL) {
 		int err = errno;
 		DBG("opendir(): %s(%d)", strerror(err), err);
-		goto done;
+		return -err;
 	}
 
+	if (dirfd(dummy->dp) < 0) {
+		int err = errno;
+		error("dirfd(): %s(%d)", strerror(err), err);
+		return -err;
+	}
+
+	dummy->files = sorted_vcards(dummy->dp);
+
 	/*
 	 * For PullPhoneBook function, the decision of returning the size
 	 * or contacts is made in the PBAP core. When MaxListCount is ZERO,
@@ -236,20 +261,71 @@ static gboolean read_dir(void *user_data)
 	 * other applicattion parameters that may be present in the request.
 	 */
 	if (dummy->apparams->maxlistcount == 0) {
-		max = 0xffff;
+		dummy->left = 0xffff;
 		offset = 0;
 	} else {
-		max = dummy->apparams->maxlistcount;
+		dummy->left = dummy->apparams->maxlistcount;
 		offset = dummy->apparams->liststartoffset;
 	}
 
-	foreach_vcard(dp, entry_concat, offset, max, buffer, &count);
+	/* Offset shall be based on the first entry of the phonebook */
+	for (; offset > 0 && dummy->files; offset--) {
+		l = dummy->files;
+		dummy->files = g_slist_remove_link(dummy->files, l);
+		g_slist_free_full(l, g_free);
+	}
+
+	return 0;
+}
+
+static gboolean read_dir(void *user_data)
+{
+	struct dummy_data *dummy = user_data;
+	GString *buffer;
+	gboolean size_only, lastpart;
+	uint16_t count = 0;
+	int folderfd;
+
+	dummy->id = 0;
+
+	buffer = g_string_new("");
+
+	if (dummy->dp == NULL && open_dir(dummy) < 0)
+		goto done;
+
+	size_only = (dummy->apparams->maxlistcount == 0);
+	folderfd = dirfd(dummy->dp);
+
+	/*
+	 * Contacts are sent in bounded parts: the next one is read when
+	 * the PBAP core calls phonebook_pull_read again.
+	 */
+	while (dummy->files && dummy->left > 0) {
+		char *filename = dummy->files->data;
+
+		dummy->files = g_slist_delete_link(dummy->files,
+							dummy->files);
+
+		if (load_vcard(folderfd, filename, entry_concat,
+						size_only ? NULL : buffer)) {
+			count++;
+			dummy->left--;
+		}
+
+		g_free(filename);
+
+		if (buffer->len >= VCARDS_PART_SIZE)
+			break;
+	}
 
-	closedir(dp);
 done:
+	lastpart = (dummy->files == NULL || dummy->left == 0);
+
 	/* FIXME: Missing vCards fields filtering */
-	dummy->cb(buffer->str, buffer->len, count, 0, TRUE, dummy->user_data);
+	dummy->cb(buffer->str, buffer->len, count, 0, lastpart,
+							dummy->user_data);
 
+	/* The request may be finalized by the callback */
 	g_string_free(buffer, TRUE);
 
 	return FALSE;
@@ -257,7 +333,7 @@ done:
 
 static void entry_notify(const char *filename, VObject *v, void *user_data)
 {
-	struct cache_query *query = user_data;
+	struct dummy_data *query = user_data;
 	VObject *property, *subproperty;
 	GString *name;
 	const char *tel;
@@ -314,7 +390,9 @@ static void entry_notify(const char *filename, VObject *v, void *user_data)
 
 static gboolean create_cache(void *user_data)
 {
-	struct cache_query *query = user_data;
+	struct dummy_data *query = user_data;
+
+	query->id = 0;
 
 	/*
 	 * MaxListCount and ListStartOffset shall not be used
@@ -335,6 +413,8 @@ static gboolean read_entry(void *user_data)
 	char buffer[1024];
 	ssize_t count;
 
+	dummy->id = 0;
+
 	memset(buffer, 0, sizeof(buffer));
 	count = read(dummy->fd, buffer, sizeof(buffer));
 
@@ -451,10 +531,13 @@ void phonebook_req_finalize(void *request)
 {
 	struct dummy_data *dummy = request;
 
-	/* dummy_data will be cleaned when request will be finished via
-	 * g_source_remove */
-	if (dummy && dummy->id)
+	if (dummy == NULL)
+		return;
+
+	if (dummy->id)
 		g_source_remove(dummy->id);
+
+	dummy_free(dummy);
 }
 
 void *phonebook_pull(const char *name, const struct apparam_field *params,
@@ -507,8 +590,8 @@ int phonebook_pull_read(void *request)
 	if (!dummy)
 		return -ENOENT;
 
-	dummy->id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, read_dir, dummy,
-								dummy_free);
+	if (dummy->id == 0)
+		dummy->id = g_idle_add(read_dir, dummy);
 
 	return 0;
 }
@@ -520,7 +603,6 @@ void *phonebook_get_entry(const char *folder, const char *id,
 	struct dummy_data *dummy;
 	char *filename;
 	int fd;
-	guint ret;
 
 	filename = g_build_filename(root_folder, folder, id, NULL);
 
@@ -538,22 +620,20 @@ void *phonebook_get_entry(const char *folder, const char *id,
 	dummy->apparams = params;
 	dummy->fd = fd;
 
-	ret = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, read_entry, dummy,
-								dummy_free);
+	dummy->id = g_idle_add(read_entry, dummy);
 
 	if (err)
 		*err = 0;
 
-	return GINT_TO_POINTER(ret);
+	return dummy;
 }
 
 void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 		phonebook_cache_ready_cb ready_cb, void *user_data, int *err)
 {
-	struct cache_query *query;
+	struct dummy_data *query;
 	char *foldername;
 	DIR *dp;
-	guint ret;
 
 	foldername = g_build_filename(root_folder, name, NULL);
 	dp = opendir(foldername);
@@ -566,17 +646,17 @@ void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 		return NULL;
 	}
 
-	query = g_new0(struct cache_query, 1);
+	query = g_new0(struct dummy_data, 1);
 	query->entry_cb = entry_cb;
 	query->ready_cb = ready_cb;
 	query->user_data = user_data;
+	query->fd = -1;
 	query->dp = dp;
 
-	ret = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, create_cache, query,
-								query_free);
+	query->id = g_idle_add(create_cache, query);
 
 	if (err)
 		*err = 0;
 
-	return GINT_TO_POINTER(ret);
+	return query;
 }
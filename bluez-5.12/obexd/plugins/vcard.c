@@ -83,125 +83,124 @@
 #define QP_SELECT "\n!\"#$=@[\\]^`{|}~"
 #define ASCII_LIMIT 0x7F
 
+#define LINE_DELIMIT 75
+#define LINE_FOLD "\r\n "
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
 /* according to RFC 2425, the output string may need folding */
-static void vcard_printf(GString *str, const char *fmt, ...)
+static void vcard_fold(GString *str, gsize start)
 {
-	char buf[1024];
-	va_list ap;
-	int len_temp, line_number, i;
-	unsigned int line_delimit = 75;
+	gsize len = str->len - start;
+	gsize breaks, src, dst, seg;
 
-	va_start(ap, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, ap);
-	va_end(ap);
+	if (len <= LINE_DELIMIT)
+		return;
 
-	line_number = strlen(buf) / line_delimit + 1;
+	breaks = (len - 1) / LINE_DELIMIT;
+	src = str->len;
+	g_string_set_size(str, str->len + breaks * (sizeof(LINE_FOLD) - 1));
+	dst = str->len;
 
-	for (i = 0; i < line_number; i++) {
-		len_temp = MIN(line_delimit, strlen(buf) - line_delimit * i);
-		g_string_append_len(str,  buf + line_delimit * i, len_temp);
-		if (i != line_number - 1)
-			g_string_append(str, "\r\n ");
+	/* Move the line segments into place from the end, in one pass */
+	seg = len - breaks * LINE_DELIMIT;
+	for (; breaks > 0; breaks--, seg = LINE_DELIMIT) {
+		src -= seg;
+		dst -= seg;
+		memmove(str->str + dst, str->str + src, seg);
+
+		dst -= sizeof(LINE_FOLD) - 1;
+		memcpy(str->str + dst, LINE_FOLD, sizeof(LINE_FOLD) - 1);
 	}
+}
 
+static void vcard_line_end(GString *str, gsize start)
+{
+	vcard_fold(str, start);
 	g_string_append(str, "\r\n");
 }
 
+static void vcard_printf(GString *str, const char *fmt, ...)
+{
+	gsize start = str->len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	g_string_append_vprintf(str, fmt, ap);
+	va_end(ap);
+
+	vcard_line_end(str, start);
+}
+
 /* According to RFC 2426, we need escape following characters:
  *  '\n', '\r', ';', ',', '\'.
+ * vCard 2.1 only needs ';' to be escaped.
  */
-static void add_slash(char *dest, const char *src, int len_max, int len)
+static void vcard_append_escaped(GString *str, uint8_t format,
+							const char *field)
 {
-	int i, j;
+	const char *special;
+	size_t len;
 
-	for (i = 0, j = 0; i < len && j + 1 < len_max; i++, j++) {
-		/* filling dest buffer - last field need to be reserved
-		 * for '\0'*/
-		switch (src[i]) {
+	if (format == FORMAT_VCARD30)
+		special = "\n\r\\;,";
+	else if (format == FORMAT_VCARD21)
+		special = ";";
+	else
+		special = "";
+
+	while (*field != '\0') {
+		len = strcspn(field, special);
+		g_string_append_len(str, field, len);
+		field += len;
+
+		switch (*field) {
+		case '\0':
+			return;
 		case '\n':
-			if (j + 2 >= len_max)
-				/* not enough space in the buffer to put char
-				 * preceded with escaping sequence (and '\0' in
-				 * the end) */
-				goto done;
-
-			dest[j++] = '\\';
-			dest[j] = 'n';
+			g_string_append(str, "\\n");
 			break;
 		case '\r':
-			if (j + 2 >= len_max)
-				goto done;
-
-			dest[j++] = '\\';
-			dest[j] = 'r';
+			g_string_append(str, "\\r");
 			break;
-		case '\\':
-		case ';':
-		case ',':
-			if (j + 2 >= len_max)
-				goto done;
-
-			dest[j++] = '\\';
 		default:
-			dest[j] = src[i];
+			g_string_append_c(str, '\\');
+			g_string_append_c(str, *field);
 			break;
 		}
-	}
-
-done:
-	dest[j] = 0;
-}
-
-static void escape_semicolon(char *dest, const char *src, int len_max, int len)
-{
-	int i, j;
-
-	for (i = 0, j = 0; i < len && j + 1 < len_max; i++, j++) {
-		if (src[i] == ';') {
-			if (j + 2 >= len_max)
-				break;
-
-			dest[j++] = '\\';
-		}
 
-		dest[j] = src[i];
+		field++;
 	}
-
-	dest[j] = 0;
 }
 
-static void set_escape(uint8_t format, char *dest, const char *src,
-							int len_max, int len)
-{
-	if (format == FORMAT_VCARD30)
-		add_slash(dest, src, len_max, len);
-	else if (format == FORMAT_VCARD21)
-		escape_semicolon(dest, src, len_max, len);
-}
-
-static void get_escaped_fields(uint8_t format, char **fields, ...)
+static void vcard_append_fields(GString *str, uint8_t format,
+						const char *field, ...)
 {
 	va_list ap;
-	GString *line;
-	char *field;
-	char escaped[LEN_MAX];
 
-	va_start(ap, fields);
-	line = g_string_new("");
+	va_start(ap, field);
 
-	for (field = va_arg(ap, char *); field; ) {
-		set_escape(format, escaped, field, LEN_MAX, strlen(field));
-		g_string_append(line, escaped);
+	while (field) {
+		vcard_append_escaped(str, format, field);
 
-		field = va_arg(ap, char *);
+		field = va_arg(ap, const char *);
 
 		if (field)
-			g_string_append(line, ";");
+			g_string_append_c(str, ';');
 	}
 
 	va_end(ap);
+}
 
-	*fields = g_string_free(line, FALSE);
+static void vcard_print_field(GString *vcards, uint8_t format,
+					const char *desc, const char *field)
+{
+	gsize start = vcards->len;
+
+	g_string_append(vcards, desc);
+	g_string_append_c(vcards, ':');
+	vcard_append_escaped(vcards, format, field);
+	vcard_line_end(vcards, start);
 }
 
 static gboolean set_qp_encoding(char c)
@@ -227,21 +226,35 @@ static void append_qp_break_line(GString *vcards, size_t *limit)
 	*limit = QP_LINE_LEN - 1;
 }
 
-static void append_qp_ascii(GString *vcards, size_t *limit, char c)
+static void append_qp_ascii(GString *vcards, size_t *limit,
+						const char *text, size_t len)
 {
-	if (*limit == 0)
-		append_qp_break_line(vcards, limit);
+	while (len > 0) {
+		size_t chunk;
 
-	g_string_append_c(vcards, c);
-	--*limit;
+		if (*limit == 0)
+			append_qp_break_line(vcards, limit);
+
+		chunk = MIN(len, *limit);
+		g_string_append_len(vcards, text, chunk);
+		*limit -= chunk;
+		text += chunk;
+		len -= chunk;
+	}
 }
 
 static void append_qp_hex(GString *vcards, size_t *limit, char c)
 {
+	char hex[QP_CHAR_LEN];
+
 	if (*limit < QP_CHAR_LEN)
 		append_qp_break_line(vcards, limit);
 
-	g_string_append_printf(vcards, "=%2.2X", (unsigned char) c);
+	hex[0] = '=';
+	hex[1] = hex_digits[(unsigned char) c >> 4];
+	hex[2] = hex_digits[(unsigned char) c & 0x0f];
+
+	g_string_append_len(vcards, hex, QP_CHAR_LEN);
 	*limit -= QP_CHAR_LEN;
 }
 
@@ -278,6 +291,7 @@ static void vcard_qp_print_encoded(GString *vcards, const char *desc, ...)
 	const char *field, *charset = "";
 	const char *encoding = ";ENCODING=QUOTED-PRINTABLE";
 	size_t limit, param_len;
+	gsize start;
 	va_list ap;
 
 	va_start(ap, desc);
@@ -291,8 +305,9 @@ static void vcard_qp_print_encoded(GString *vcards, const char *desc, ...)
 
 	va_end(ap);
 
-	vcard_printf(vcards, "%s%s%s:", desc, encoding, charset);
-	g_string_truncate(vcards, vcards->len - 2);
+	start = vcards->len;
+	g_string_append_printf(vcards, "%s%s%s:", desc, encoding, charset);
+	vcard_fold(vcards, start);
 
 	param_len = strlen(desc) + strlen(encoding) + strlen(charset) + 1;
 	limit = QP_LINE_LEN - param_len;
@@ -300,29 +315,38 @@ static void vcard_qp_print_encoded(GString *vcards, const char *desc, ...)
 	va_start(ap, desc);
 
 	for (field = va_arg(ap, char *); field != NULL; ) {
-		size_t i, size = strlen(field);
+		while (*field != '\0') {
+			size_t len;
+
+			/* Copy runs of printable characters at once */
+			for (len = 0; field[len] != '\0'; len++) {
+				if (field[len] == ';' ||
+						set_qp_encoding(field[len]))
+					break;
+			}
 
-		for (i = 0; i < size; ++i) {
-			if (set_qp_encoding(field[i])) {
-				if (field[i] == '\n') {
-					append_qp_new_line(vcards, &limit);
-					continue;
-				}
+			append_qp_ascii(vcards, &limit, field, len);
+			field += len;
 
-				append_qp_hex(vcards, &limit, field[i]);
-			} else {
+			if (*field == '\0')
+				break;
+
+			if (*field == '\n')
+				append_qp_new_line(vcards, &limit);
+			else if (*field == ';') {
 				/* According to vCard 2.1 spec. semicolons in
 				 * property parameter value must be escaped */
-				if (field[i] == ';')
-					append_qp_hex(vcards, &limit, QP_ESC);
+				append_qp_hex(vcards, &limit, QP_ESC);
+				append_qp_ascii(vcards, &limit, field, 1);
+			} else
+				append_qp_hex(vcards, &limit, *field);
 
-				append_qp_ascii(vcards, &limit, field[i]);
-			}
+			field++;
 		}
 
 		field = va_arg(ap, char *);
 		if (field)
-			append_qp_ascii(vcards, &limit, ';');
+			append_qp_ascii(vcards, &limit, ";", 1);
 	}
 
 	va_end(ap);
@@ -401,7 +425,7 @@ static gboolean contact_fields_present(struct phonebook_contact * contact)
 static void vcard_printf_name(GString *vcards, uint8_t format,
 					struct phonebook_contact *contact)
 {
-	char *fields;
+	gsize start;
 
 	if (contact_fields_present(contact) == FALSE) {
 		/* If fields are empty, add only 'N:' as parameter.
@@ -425,21 +449,18 @@ static void vcard_printf_name(GString *vcards, uint8_t format,
 		return;
 	}
 
-	get_escaped_fields(format, &fields, contact->family,
+	start = vcards->len;
+	g_string_append(vcards, "N:");
+	vcard_append_fields(vcards, format, contact->family,
 				contact->given, contact->additional,
 				contact->prefix, contact->suffix,
 				NULL);
-
-	vcard_printf(vcards, "N:%s", fields);
-
-	g_free(fields);
+	vcard_line_end(vcards, start);
 }
 
 static void vcard_printf_fullname(GString *vcards, uint8_t format,
 							const char *text)
 {
-	char field[LEN_MAX];
-
 	if (!text || strlen(text) == 0) {
 		vcard_printf(vcards, "FN:");
 		return;
@@ -450,8 +471,7 @@ static void vcard_printf_fullname(GString *vcards, uint8_t format,
 		return;
 	}
 
-	set_escape(format, field, text, LEN_MAX, strlen(text));
-	vcard_printf(vcards, "FN:%s", field);
+	vcard_print_field(vcards, format, "FN", text);
 }
 
 static void vcard_printf_number(GString *vcards, uint8_t format,
@@ -459,7 +479,7 @@ static void vcard_printf_number(GString *vcards, uint8_t format,
 					enum phonebook_number_type category)
 {
 	const char *intl = "", *category_string = "";
-	char buf[LEN_MAX], field[LEN_MAX];
+	char buf[LEN_MAX], *field;
 
 	/* TEL is a mandatory field, include even if empty */
 	if (!number || !strlen(number) || !type) {
@@ -503,29 +523,28 @@ static void vcard_printf_number(GString *vcards, uint8_t format,
 	if ((type == TYPE_INTERNATIONAL) && (number[0] != '+'))
 		intl = "+";
 
-	snprintf(field, sizeof(field), "%s%s", intl, number);
-
 	if (select_qp_encoding(format, number, NULL)) {
+		field = g_strconcat(intl, number, NULL);
 		snprintf(buf, sizeof(buf), "TEL;%s", category_string);
 		vcard_qp_print_encoded(vcards, buf, field, NULL);
+		g_free(field);
 		return;
 	}
 
-	vcard_printf(vcards, "TEL;%s:%s", category_string, field);
+	vcard_printf(vcards, "TEL;%s:%s%s", category_string, intl, number);
 }
 
 static void vcard_printf_tag(GString *vcards, uint8_t format,
 					const char *tag, const char *category,
 					const char *fld)
 {
-	int len;
 	char *separator = "", *type = "";
-	char buf[LEN_MAX], field[LEN_MAX];
+	char buf[LEN_MAX];
 
 	if (tag == NULL || strlen(tag) == 0)
 		return;
 
-	if (fld == NULL || (len = strlen(fld)) == 0) {
+	if (fld == NULL || strlen(fld) == 0) {
 		vcard_printf(vcards, "%s:", tag);
 		return;
 	}
@@ -545,8 +564,7 @@ static void vcard_printf_tag(GString *vcards, uint8_t format,
 		return;
 	}
 
-	set_escape(format, field, fld, LEN_MAX, len);
-	vcard_printf(vcards, "%s:%s", buf, field);
+	vcard_print_field(vcards, format, buf, fld);
 }
 
 static void vcard_printf_email(GString *vcards, uint8_t format,
@@ -554,10 +572,9 @@ static void vcard_printf_email(GString *vcards, uint8_t format,
 					enum phonebook_field_type category)
 {
 	const char *category_string = "";
-	char buf[LEN_MAX], field[LEN_MAX];
-	int len = 0;
+	char buf[LEN_MAX];
 
-	if (!address || !(len = strlen(address))) {
+	if (!address || strlen(address) == 0) {
 		vcard_printf(vcards, "EMAIL:");
 		return;
 	}
@@ -581,14 +598,14 @@ static void vcard_printf_email(GString *vcards, uint8_t format,
 			category_string = "TYPE=INTERNET;TYPE=OTHER";
 	}
 
+	snprintf(buf, sizeof(buf), "EMAIL;%s", category_string);
+
 	if (select_qp_encoding(format, address, NULL)) {
-		snprintf(buf, sizeof(buf), "EMAIL;%s", category_string);
 		vcard_qp_print_encoded(vcards, buf, address, NULL);
 		return;
 	}
 
-	set_escape(format, field, address, LEN_MAX, len);
-	vcard_printf(vcards, "EMAIL;%s:%s", category_string, field);
+	vcard_print_field(vcards, format, buf, address);
 }
 
 static void vcard_printf_url(GString *vcards, uint8_t format,
@@ -596,7 +613,7 @@ static void vcard_printf_url(GString *vcards, uint8_t format,
 					enum phonebook_field_type category)
 {
 	const char *category_string = "";
-	char buf[LEN_MAX], field[LEN_MAX];
+	char buf[LEN_MAX];
 
 	if (!url || strlen(url) == 0) {
 		vcard_printf(vcards, "URL:");
@@ -624,14 +641,14 @@ static void vcard_printf_url(GString *vcards, uint8_t format,
 		break;
 	}
 
+	snprintf(buf, sizeof(buf), "URL;%s", category_string);
+
 	if (select_qp_encoding(format, url, NULL)) {
-		snprintf(buf, sizeof(buf), "URL;%s", category_string);
 		vcard_qp_print_encoded(vcards, buf, url, NULL);
 		return;
 	}
 
-	set_escape(format, field, url, LEN_MAX, strlen(url));
-	vcard_printf(vcards, "URL;%s:%s", category_string, field);
+	vcard_print_field(vcards, format, buf, url);
 }
 
 static gboolean org_fields_present(struct phonebook_contact *contact)
@@ -648,7 +665,7 @@ static gboolean org_fields_present(struct phonebook_contact *contact)
 static void vcard_printf_org(GString *vcards, uint8_t format,
 					struct phonebook_contact *contact)
 {
-	char *fields;
+	gsize start;
 
 	if (org_fields_present(contact) == FALSE)
 		return;
@@ -660,22 +677,20 @@ static void vcard_printf_org(GString *vcards, uint8_t format,
 		return;
 	}
 
-	get_escaped_fields(format, &fields, contact->company,
+	start = vcards->len;
+	g_string_append(vcards, "ORG:");
+	vcard_append_fields(vcards, format, contact->company,
 					contact->department, NULL);
-
-	vcard_printf(vcards, "ORG:%s", fields);
-
-	g_free(fields);
+	vcard_line_end(vcards, start);
 }
 
 static void vcard_printf_address(GString *vcards, uint8_t format,
 					struct phonebook_addr *address)
 {
-	char *fields, field_esc[LEN_MAX];
 	const char *category_string = "";
 	char buf[LEN_MAX], *address_fields[ADDR_FIELD_AMOUNT];
 	int i;
-	size_t len;
+	gsize start;
 	GSList *l;
 
 	if (!address) {
@@ -720,28 +735,21 @@ static void vcard_printf_address(GString *vcards, uint8_t format,
 		return;
 	}
 
-	/* allocate enough memory to insert address fields separated by ';'
-	 * and terminated by '\0' */
-	len = ADDR_FIELD_AMOUNT * LEN_MAX;
-	fields = g_malloc0(len);
+	start = vcards->len;
+	g_string_append_printf(vcards, "ADR;%s:", category_string);
 
 	for (l = address->fields; l; l = l->next) {
 		char *field = l->data;
 
-		if (field) {
-			set_escape(format, field_esc, field, LEN_MAX,
-								strlen(field));
-			g_strlcat(fields, field_esc, len);
-		}
+		if (field)
+			vcard_append_escaped(vcards, format, field);
 
 		if (l->next)
 			/* not adding ';' after last addr field */
-			g_strlcat(fields, ";", len);
+			g_string_append_c(vcards, ';');
 	}
 
-	vcard_printf(vcards,"ADR;%s:%s", category_string, fields);
-
-	g_free(fields);
+	vcard_line_end(vcards, start);
 }
 
 static void vcard_printf_datetime(GString *vcards, uint8_t format,
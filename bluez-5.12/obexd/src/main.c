@@ -51,6 +51,9 @@
 #include "server.h"
 
 #define DEFAULT_CAP_FILE CONFIGDIR "/capability.xml"
+#define DEFAULT_WRITE_BUFFER 256 /* KB */
+#define MIN_WRITE_BUFFER 4 /* KB */
+#define MAX_WRITE_BUFFER 65536 /* KB */
 
 static GMainLoop *main_loop = NULL;
 
@@ -138,6 +141,10 @@ static char *option_noplugin = NULL;
 
 static gboolean option_autoaccept = FALSE;
 static gboolean option_symlinks = FALSE;
+static gboolean option_mmap = FALSE;
+static gboolean option_srm = TRUE;
+static unsigned int option_write_buffer = DEFAULT_WRITE_BUFFER;
+static int option_fsync = OBEX_FSYNC_NEVER;
 
 static gboolean parse_debug(const char *key, const char *value,
 				gpointer user_data, GError **error)
@@ -150,6 +157,46 @@ static gboolean parse_debug(const char *key, const char *value,
 	return TRUE;
 }
 
+static gboolean parse_fsync(const char *key, const char *value,
+				gpointer user_data, GError **error)
+{
+	if (g_str_equal(value, "never"))
+		option_fsync = OBEX_FSYNC_NEVER;
+	else if (g_str_equal(value, "close"))
+		option_fsync = OBEX_FSYNC_CLOSE;
+	else if (g_str_equal(value, "write"))
+		option_fsync = OBEX_FSYNC_WRITE;
+	else {
+		g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+					"Invalid fsync policy: %s", value);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean parse_write_buffer(const char *key, const char *value,
+				gpointer user_data, GError **error)
+{
+	unsigned long size;
+	char *end;
+
+	errno = 0;
+	size = strtoul(value, &end, 10);
+	if (errno != 0 || *value == '\0' || *end != '\0' ||
+			size < MIN_WRITE_BUFFER || size > MAX_WRITE_BUFFER) {
+		g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+				"Invalid write buffer size: %s (%u-%u KB)",
+				value, MIN_WRITE_BUFFER, MAX_WRITE_BUFFER);
+		return FALSE;
+	}
+
+	/* Keep writes aligned to the page size */
+	option_write_buffer = size & ~3UL;
+
+	return TRUE;
+}
+
 static GOptionEntry options[] = {
 	{ "debug", 'd', G_OPTION_FLAG_OPTIONAL_ARG,
 				G_OPTION_ARG_CALLBACK, parse_debug,
@@ -176,6 +223,19 @@ static GOptionEntry options[] = {
 				"scripts", "FILE" },
 	{ "auto-accept", 'a', 0, G_OPTION_ARG_NONE, &option_autoaccept,
 				"Automatically accept push requests" },
+	{ "mmap", 'm', 0, G_OPTION_ARG_NONE, &option_mmap,
+				"Map large files when sending them, files "
+				"must not be truncated while in transfer" },
+	{ "write-buffer", 'w', 0, G_OPTION_ARG_CALLBACK, parse_write_buffer,
+				"Size of the buffer received objects are "
+				"written in", "KB" },
+	{ "fsync", 'f', 0, G_OPTION_ARG_CALLBACK, parse_fsync,
+				"Sync received objects to storage: never, "
+				"close or write", "POLICY" },
+	{ "nosrm", 'M', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE,
+				&option_srm,
+				"Don't use Single Response Mode on packet "
+				"transports" },
 	{ NULL },
 };
 
@@ -194,6 +254,26 @@ gboolean obex_option_symlinks(void)
 	return option_symlinks;
 }
 
+gboolean obex_option_mmap(void)
+{
+	return option_mmap;
+}
+
+gboolean obex_option_srm(void)
+{
+	return option_srm;
+}
+
+size_t obex_option_write_buffer(void)
+{
+	return (size_t) option_write_buffer * 1024;
+}
+
+int obex_option_fsync(void)
+{
+	return option_fsync;
+}
+
 const char *obex_option_capability(void)
 {
 	return option_capability;
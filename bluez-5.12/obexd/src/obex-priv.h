@@ -40,6 +40,7 @@ struct obex_session {
 	size_t nonhdr_len;
 	guint get_rsp;
 	uint8_t *buf;
+	size_t buf_size;
 	int64_t pending;
 	int64_t offset;
 	int64_t size;
@@ -53,6 +54,8 @@ struct obex_session {
 	GObex *obex;
 	struct obex_mime_type_driver *driver;
 	gboolean headers_sent;
+	gint64 progress_time;
+	gboolean finishing;
 };
 
 int obex_session_start(GIOChannel *io, uint16_t tx_mtu, uint16_t rx_mtu,
@@ -65,6 +65,9 @@
 #define USER_ID_TAG 0x01 /* Optional */
 #define DIGEST_NONCE_TAG 0x02 /* Optional */
 
+/* Minimum time between transfer progress updates */
+#define PROGRESS_INTERVAL 200000 /* usec */
+
 static GSList *sessions = NULL;
 
 typedef struct {
@@ -216,6 +219,7 @@ static void os_reset_session(struct obex_session *os)
 	if (os->buf) {
 		g_free(os->buf);
 		os->buf = NULL;
+		os->buf_size = 0;
 	}
 	if (os->path) {
 		g_free(os->path);
@@ -240,6 +244,8 @@ static void os_reset_session(struct obex_session *os)
 	os->size = OBJECT_SIZE_DELETE;
 	os->headers_sent = FALSE;
 	os->checked = FALSE;
+	os->progress_time = 0;
+	os->finishing = FALSE;
 }
 
 static void obex_session_free(struct obex_session *os)
@@ -465,33 +471,68 @@ static void cmd_disconnect(GObex *obex, GObexPacket *req, void *user_data)
 	os_set_response(os, 0);
 }
 
-static ssize_t driver_write(struct obex_session *os)
+static void os_progress(struct obex_session *os)
 {
-	ssize_t len = 0;
+	gint64 now;
+
+	if (os->service->progress == NULL)
+		return;
 
-	while (os->pending > 0) {
-		ssize_t w;
+	now = g_get_monotonic_time();
+	if (now - os->progress_time < PROGRESS_INTERVAL)
+		return;
 
-		w = os->driver->write(os->object, os->buf + len, os->pending);
+	os->progress_time = now;
+	os->service->progress(os, os->service_data);
+}
+
+/* The last update must not be throttled or the final offset is lost */
+static void os_progress_final(struct obex_session *os)
+{
+	if (os->service == NULL || os->service->progress == NULL)
+		return;
+
+	os->progress_time = g_get_monotonic_time();
+	os->service->progress(os, os->service_data);
+}
+
+/*
+ * Unless flushing, only whole write buffers are written so the object
+ * is stored with large aligned writes; the rest stays pending.
+ */
+static ssize_t driver_write(struct obex_session *os, gboolean flush)
+{
+	size_t wbuf = obex_option_write_buffer();
+	ssize_t len = 0, w = 0;
+	int64_t count;
+
+	count = flush ? os->pending : os->pending - os->pending % wbuf;
+
+	while (count > 0) {
+		w = os->driver->write(os->object, os->buf + len, count);
 		if (w < 0) {
 			error("write(): %s (%zd)", strerror(-w), -w);
 			if (w == -EINTR)
 				continue;
-			else if (w == -EINVAL)
-				memmove(os->buf, os->buf + len, os->pending);
-
-			return w;
+			break;
 		}
 
 		len += w;
+		count -= w;
 		os->offset += w;
 		os->pending -= w;
 	}
 
+	if (len > 0 && os->pending > 0)
+		memmove(os->buf, os->buf + len, os->pending);
+
+	if (w < 0)
+		return w;
+
 	DBG("%zd written", len);
 
-	if (os->service->progress != NULL)
-		os->service->progress(os, os->service_data);
+	if (len > 0)
+		os_progress(os);
 
 	return len;
 }
@@ -503,8 +544,7 @@ static gssize driver_read(struct obex_session *os, void *buf, gsize size)
 	if (os->object == NULL)
 		return -EIO;
 
-	if (os->service->progress != NULL)
-		os->service->progress(os, os->service_data);
+	os_progress(os);
 
 	len = os->driver->read(os->object, buf, size);
 	if (len < 0) {
@@ -536,28 +576,98 @@ static gssize send_data(void *buf, gsize size, gpointer user_data)
 	return driver_read(os, buf, size);
 }
 
+static gssize driver_read_ref(struct obex_session *os, const void **buf,
+								gsize size)
+{
+	gssize len;
+
+	if (os->object == NULL)
+		return -EIO;
+
+	os_progress(os);
+
+	len = os->driver->read_ref(os->object, buf, size);
+	if (len < 0) {
+		error("read(): %s (%zd)", strerror(-len), -len);
+		if (len == -ENOSTR)
+			return 0;
+		if (len == -EAGAIN)
+			os->driver->set_io_watch(os->object, handle_async_io,
+									os);
+		return len;
+	}
+
+	os->offset += len;
+
+	DBG("%zd read", len);
+
+	return len;
+}
+
+static gssize send_data_ref(const void **buf, gsize size, gpointer user_data)
+{
+	struct obex_session *os = user_data;
+
+	DBG("name=%s type=%s file=%p size=%zu", os->name, os->type, os->object,
+									size);
+
+	if (os->aborted)
+		return os->err < 0 ? os->err : -EPERM;
+
+	return driver_read_ref(os, buf, size);
+}
+
+static int os_finish_transfer(struct obex_session *os)
+{
+	ssize_t ret;
+
+	if (os->object && os->driver && os->pending > 0) {
+		ret = driver_write(os, TRUE);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (os->object && os->driver && os->driver->flush) {
+		if (os->driver->flush(os->object) == -EAGAIN)
+			return -EAGAIN;
+	}
+
+	return 0;
+}
+
+static void os_transfer_done(struct obex_session *os, int err)
+{
+	if (err < 0) {
+		os->err = err;
+		os->aborted = TRUE;
+	} else
+		os_progress_final(os);
+
+	os_reset_session(os);
+}
+
 static void transfer_complete(GObex *obex, GError *err, gpointer user_data)
 {
 	struct obex_session *os = user_data;
+	int ret;
 
 	DBG("");
 
 	if (err != NULL) {
 		error("transfer failed: %s\n", err->message);
-		goto reset;
+		os_reset_session(os);
+		return;
 	}
 
-	if (os->object && os->driver && os->driver->flush) {
-		if (os->driver->flush(os->object) == -EAGAIN) {
-			g_obex_suspend(os->obex);
-			os->driver->set_io_watch(os->object, handle_async_io,
-									os);
-			return;
-		}
+	ret = os_finish_transfer(os);
+	if (ret == -EAGAIN) {
+		os->finishing = TRUE;
+		g_obex_suspend(os->obex);
+		os->driver->set_io_watch(os->object, handle_async_io, os);
+		return;
 	}
 
-reset:
-	os_reset_session(os);
+	os_transfer_done(os, ret);
 }
 
 static int driver_get_headers(struct obex_session *os)
@@ -611,8 +721,12 @@ done:
 		g_obex_packet_add_header(rsp, hdr);
 	}
 
-	g_obex_get_rsp_pkt(os->obex, rsp, send_data, transfer_complete, os,
-									NULL);
+	if (os->driver->read_ref != NULL)
+		g_obex_get_rsp_pkt_ref(os->obex, rsp, send_data_ref,
+						transfer_complete, os, NULL);
+	else
+		g_obex_get_rsp_pkt(os->obex, rsp, send_data, transfer_complete,
+								os, NULL);
 
 	os->headers_sent = TRUE;
 
@@ -626,11 +740,23 @@ static gboolean handle_async_io(void *object, int flags, int err,
 {
 	struct obex_session *os = user_data;
 
+	if (os->finishing) {
+		if (err == 0)
+			err = os_finish_transfer(os);
+		if (err == -EAGAIN)
+			return TRUE;
+
+		os->finishing = FALSE;
+		os_transfer_done(os, err);
+		g_obex_resume(os->obex);
+		return FALSE;
+	}
+
 	if (err < 0)
 		goto done;
 
 	if (flags & G_IO_OUT)
-		err = driver_write(os);
+		err = driver_write(os, TRUE);
 	if ((flags & G_IO_IN) && !os->headers_sent)
 		err = driver_get_headers(os);
 
@@ -663,7 +789,16 @@ static gboolean recv_data(const void *buf, gsize size, gpointer user_data)
 	if (os->size == OBJECT_SIZE_DELETE)
 		os->size = OBJECT_SIZE_UNKNOWN;
 
-	os->buf = g_realloc(os->buf, os->pending + size);
+	if (os->pending + size > os->buf_size) {
+		size_t wbuf = obex_option_write_buffer();
+
+		if (os->size >= 0 && (uint64_t) os->size < wbuf)
+			wbuf = os->size;
+
+		os->buf_size = MAX(os->pending + size, wbuf);
+		os->buf = g_realloc(os->buf, os->buf_size);
+	}
+
 	memcpy(os->buf + os->pending, buf, size);
 	os->pending += size;
 
@@ -674,7 +809,11 @@ static gboolean recv_data(const void *buf, gsize size, gpointer user_data)
 		return TRUE;
 	}
 
-	ret = driver_write(os);
+	/* Coalesce small body chunks, the remainder is written on completion */
+	if ((size_t) os->pending < obex_option_write_buffer())
+		return TRUE;
+
+	ret = driver_write(os, FALSE);
 	if (ret >= 0)
 		return TRUE;
 
@@ -1124,6 +1263,9 @@ int obex_session_start(GIOChannel *io, uint16_t tx_mtu, uint16_t rx_mtu,
 		return -EIO;
 	}
 
+	if (!obex_option_srm())
+		g_obex_set_srm_policy(obex, G_OBEX_SRM_POLICY_DISABLED);
+
 	g_obex_set_disconnect_function(obex, disconn_func, os);
 	g_obex_add_request_function(obex, G_OBEX_OP_CONNECT, cmd_connect, os);
 	g_obex_add_request_function(obex, G_OBEX_OP_DISCONNECT, cmd_disconnect,
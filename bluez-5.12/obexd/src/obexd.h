@@ -31,6 +31,12 @@
 #define OBEX_MAS	(1 << 8)
 #define OBEX_MNS	(1 << 9)
 
+enum {
+	OBEX_FSYNC_NEVER,
+	OBEX_FSYNC_CLOSE,
+	OBEX_FSYNC_WRITE,
+};
+
 gboolean plugin_init(const char *pattern, const char *exclude);
 void plugin_cleanup(void);
 
@@ -40,4 +46,8 @@ void manager_cleanup(void);
 gboolean obex_option_auto_accept(void);
 const char *obex_option_root_folder(void);
 gboolean obex_option_symlinks(void);
+gboolean obex_option_mmap(void);
+gboolean obex_option_srm(void);
+size_t obex_option_write_buffer(void);
+int obex_option_fsync(void);
 const char *obex_option_capability(void);
@@ -60,11 +60,18 @@
 #define FMT_KILOGRAM_UUID		0xA010
 #define FMT_HANGING_UUID		0xA011
 
+#define MAX_SVC_ATTRS			11
+
 struct gatt_example_adapter {
 	struct btd_adapter	*adapter;
 	GSList			*sdp_handles;
 };
 
+struct service_block {
+	struct attribute	attrs[MAX_SVC_ATTRS];
+	uint16_t		count;
+};
+
 static GSList *adapters = NULL;
 
 static void gatt_example_adapter_free(struct gatt_example_adapter *gadapter)
@@ -94,6 +101,44 @@ static int adapter_cmp(gconstpointer a, gconstpointer b)
 	return -1;
 }
 
+static void block_add(struct service_block *blk, uint16_t handle,
+			bt_uuid_t *uuid, const uint8_t *value, size_t len)
+{
+	struct attribute *a;
+
+	g_assert(blk->count < MAX_SVC_ATTRS);
+
+	a = &blk->attrs[blk->count++];
+	memset(a, 0, sizeof(*a));
+	a->handle = handle;
+	a->uuid = *uuid;
+	a->read_req = ATT_NONE;
+	a->write_req = ATT_NOT_PERMITTED;
+	a->len = len;
+	a->data = g_memdup(value, len);
+}
+
+static gboolean block_register(struct btd_adapter *adapter,
+					struct service_block *blk,
+					const char *name, uint32_t *sdp_handle)
+{
+	struct attribute *attrs;
+	uint16_t i;
+
+	attrs = attrib_db_add_block(adapter, blk->attrs, blk->count, name,
+								sdp_handle);
+
+	for (i = 0; i < blk->count; i++)
+		g_free(blk->attrs[i].data);
+
+	if (attrs == NULL) {
+		error("Unable to add service attributes");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static uint8_t battery_state_read(struct attribute *a,
 				  struct btd_device *device, gpointer user_data)
 {
@@ -132,6 +177,7 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 	const int svc_size = 11;
 	uint32_t sdp_handle;
 	uint8_t atval[256];
+	struct service_block blk;
 	bt_uuid_t uuid;
 	int len;
 
@@ -146,12 +192,12 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 		start_handle, manuf1[0], manuf1[1], manuf2[0], manuf2[1]);
 
 	h = start_handle;
+	blk.count = 0;
 
 	/* Thermometer: primary service definition */
 	bt_uuid16_create(&uuid, GATT_PRIM_SVC_UUID);
 	att_put_u16(THERM_HUMIDITY_SVC_UUID, &atval[0]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 2);
+	block_add(&blk, h++, &uuid, atval, 2);
 
 	bt_uuid16_create(&uuid, GATT_INCLUDE_UUID);
 
@@ -160,8 +206,7 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 		att_put_u16(manuf1[0], &atval[0]);
 		att_put_u16(manuf1[1], &atval[2]);
 		att_put_u16(MANUFACTURER_SVC_UUID, &atval[4]);
-		attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE,
-						ATT_NOT_PERMITTED, atval, 6);
+		block_add(&blk, h++, &uuid, atval, 6);
 	}
 
 	/* Thermometer: Include */
@@ -169,8 +214,7 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 		att_put_u16(manuf2[0], &atval[0]);
 		att_put_u16(manuf2[1], &atval[2]);
 		att_put_u16(VENDOR_SPECIFIC_SVC_UUID, &atval[4]);
-		attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE,
-						ATT_NOT_PERMITTED, atval, 6);
+		block_add(&blk, h++, &uuid, atval, 6);
 	}
 
 	/* Thermometer: temperature characteristic */
@@ -178,15 +222,13 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(TEMPERATURE_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Thermometer: temperature characteristic value */
 	bt_uuid16_create(&uuid, TEMPERATURE_UUID);
 	atval[0] = 0x8A;
 	atval[1] = 0x02;
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 2);
+	block_add(&blk, h++, &uuid, atval, 2);
 
 	/* Thermometer: temperature characteristic format */
 	bt_uuid16_create(&uuid, GATT_CHARAC_FMT_UUID);
@@ -195,29 +237,25 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 	att_put_u16(FMT_CELSIUS_UUID, &atval[2]);
 	atval[4] = 0x01;
 	att_put_u16(FMT_OUTSIDE_UUID, &atval[5]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 7);
+	block_add(&blk, h++, &uuid, atval, 7);
 
 	/* Thermometer: characteristic user description */
 	bt_uuid16_create(&uuid, GATT_CHARAC_USER_DESC_UUID);
 	len = strlen(desc_out_temp);
 	strncpy((char *) atval, desc_out_temp, len);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h++, &uuid, atval, len);
 
 	/* Thermometer: relative humidity characteristic */
 	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(RELATIVE_HUMIDITY_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Thermometer: relative humidity value */
 	bt_uuid16_create(&uuid, RELATIVE_HUMIDITY_UUID);
 	atval[0] = 0x27;
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 1);
+	block_add(&blk, h++, &uuid, atval, 1);
 
 	/* Thermometer: relative humidity characteristic format */
 	bt_uuid16_create(&uuid, GATT_CHARAC_FMT_UUID);
@@ -226,21 +264,21 @@ static void register_termometer_service(struct gatt_example_adapter *adapter,
 	att_put_u16(FMT_PERCENT_UUID, &atval[2]);
 	att_put_u16(BLUETOOTH_SIG_UUID, &atval[4]);
 	att_put_u16(FMT_OUTSIDE_UUID, &atval[6]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 8);
+	block_add(&blk, h++, &uuid, atval, 8);
 
 	/* Thermometer: characteristic user description */
 	bt_uuid16_create(&uuid, GATT_CHARAC_USER_DESC_UUID);
 	len = strlen(desc_out_hum);
 	strncpy((char *) atval, desc_out_hum, len);
-	attrib_db_add(adapter->adapter, h, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h, &uuid, atval, len);
 
 	g_assert(h - start_handle + 1 == svc_size);
 
-	/* Add an SDP record for the above service */
-	sdp_handle = attrib_create_sdp(adapter->adapter, start_handle,
-								"Thermometer");
+	/* Add the attributes and an SDP record for the above service */
+	if (!block_register(adapter->adapter, &blk, "Thermometer",
+								&sdp_handle))
+		return;
+
 	if (sdp_handle)
 		adapter->sdp_handles = g_slist_prepend(adapter->sdp_handles,
 						GUINT_TO_POINTER(sdp_handle));
@@ -254,6 +292,7 @@ static void register_manuf1_service(struct gatt_example_adapter *adapter,
 	uint16_t start_handle, h;
 	const int svc_size = 5;
 	uint8_t atval[256];
+	struct service_block blk;
 	bt_uuid_t uuid;
 	int len;
 
@@ -267,45 +306,44 @@ static void register_manuf1_service(struct gatt_example_adapter *adapter,
 	DBG("start_handle=0x%04x", start_handle);
 
 	h = start_handle;
+	blk.count = 0;
 
 	/* Secondary Service: Manufacturer Service */
 	bt_uuid16_create(&uuid, GATT_SND_SVC_UUID);
 	att_put_u16(MANUFACTURER_SVC_UUID, &atval[0]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 2);
+	block_add(&blk, h++, &uuid, atval, 2);
 
 	/* Manufacturer name characteristic definition */
 	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(MANUFACTURER_NAME_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Manufacturer name characteristic value */
 	bt_uuid16_create(&uuid, MANUFACTURER_NAME_UUID);
 	len = strlen(manufacturer_name1);
 	strncpy((char *) atval, manufacturer_name1, len);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h++, &uuid, atval, len);
 
 	/* Manufacturer serial number characteristic */
 	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(MANUFACTURER_SERIAL_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Manufacturer serial number characteristic value */
 	bt_uuid16_create(&uuid, MANUFACTURER_SERIAL_UUID);
 	len = strlen(serial1);
 	strncpy((char *) atval, serial1, len);
-	attrib_db_add(adapter->adapter, h, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h, &uuid, atval, len);
 
 	g_assert(h - start_handle + 1 == svc_size);
 
+	if (!block_register(adapter->adapter, &blk, NULL, NULL))
+		return;
+
 	range[0] = start_handle;
 	range[1] = start_handle + svc_size - 1;
 }
@@ -318,6 +356,7 @@ static void register_manuf2_service(struct gatt_example_adapter *adapter,
 	uint16_t start_handle, h;
 	const int svc_size = 5;
 	uint8_t atval[256];
+	struct service_block blk;
 	bt_uuid_t uuid;
 	int len;
 
@@ -331,45 +370,44 @@ static void register_manuf2_service(struct gatt_example_adapter *adapter,
 	DBG("start_handle=0x%04x", start_handle);
 
 	h = start_handle;
+	blk.count = 0;
 
 	/* Secondary Service: Manufacturer Service */
 	bt_uuid16_create(&uuid, GATT_SND_SVC_UUID);
 	att_put_u16(MANUFACTURER_SVC_UUID, &atval[0]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 2);
+	block_add(&blk, h++, &uuid, atval, 2);
 
 	/* Manufacturer name characteristic definition */
 	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(MANUFACTURER_NAME_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Manufacturer name attribute */
 	bt_uuid16_create(&uuid, MANUFACTURER_NAME_UUID);
 	len = strlen(manufacturer_name2);
 	strncpy((char *) atval, manufacturer_name2, len);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h++, &uuid, atval, len);
 
 	/* Characteristic: serial number */
 	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(MANUFACTURER_SERIAL_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Serial number characteristic value */
 	bt_uuid16_create(&uuid, MANUFACTURER_SERIAL_UUID);
 	len = strlen(serial2);
 	strncpy((char *) atval, serial2, len);
-	attrib_db_add(adapter->adapter, h, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h, &uuid, atval, len);
 
 	g_assert(h - start_handle + 1 == svc_size);
 
+	if (!block_register(adapter->adapter, &blk, NULL, NULL))
+		return;
+
 	range[0] = start_handle;
 	range[1] = start_handle + svc_size - 1;
 }
@@ -380,6 +418,7 @@ static void register_vendor_service(struct gatt_example_adapter *adapter,
 	uint16_t start_handle, h;
 	const int svc_size = 3;
 	uint8_t atval[256];
+	struct service_block blk;
 	bt_uuid_t uuid;
 
 	bt_uuid16_create(&uuid, VENDOR_SPECIFIC_SVC_UUID);
@@ -392,20 +431,19 @@ static void register_vendor_service(struct gatt_example_adapter *adapter,
 	DBG("start_handle=0x%04x", start_handle);
 
 	h = start_handle;
+	blk.count = 0;
 
 	/* Secondary Service: Vendor Specific Service */
 	bt_uuid16_create(&uuid, GATT_SND_SVC_UUID);
 	att_put_u16(VENDOR_SPECIFIC_SVC_UUID, &atval[0]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 2);
+	block_add(&blk, h++, &uuid, atval, 2);
 
 	/* Vendor Specific Type characteristic definition */
 	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	att_put_u16(VENDOR_SPECIFIC_TYPE_UUID, &atval[3]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 5);
+	block_add(&blk, h++, &uuid, atval, 5);
 
 	/* Vendor Specific Type characteristic value */
 	bt_uuid16_create(&uuid, VENDOR_SPECIFIC_TYPE_UUID);
@@ -415,11 +453,13 @@ static void register_vendor_service(struct gatt_example_adapter *adapter,
 	atval[3] = 0x64;
 	atval[4] = 0x6F;
 	atval[5] = 0x72;
-	attrib_db_add(adapter->adapter, h, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 6);
+	block_add(&blk, h, &uuid, atval, 6);
 
 	g_assert(h - start_handle + 1 == svc_size);
 
+	if (!block_register(adapter->adapter, &blk, NULL, NULL))
+		return;
+
 	range[0] = start_handle;
 	range[1] = start_handle + svc_size - 1;
 }
@@ -439,6 +479,7 @@ static void register_weight_service(struct gatt_example_adapter *adapter,
 	const int svc_size = 6;
 	uint32_t sdp_handle;
 	uint8_t atval[256];
+	struct service_block blk;
 	bt_uuid_t uuid;
 	int len;
 
@@ -455,12 +496,12 @@ static void register_weight_service(struct gatt_example_adapter *adapter,
 							vendor[0], vendor[1]);
 
 	h = start_handle;
+	blk.count = 0;
 
 	/* Weight service: primary service definition */
 	bt_uuid16_create(&uuid, GATT_PRIM_SVC_UUID);
 	memcpy(atval, &prim_weight_uuid_btorder, 16);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 16);
+	block_add(&blk, h++, &uuid, atval, 16);
 
 	if (vendor[0] && vendor[1]) {
 		/* Weight: include */
@@ -468,8 +509,7 @@ static void register_weight_service(struct gatt_example_adapter *adapter,
 		att_put_u16(vendor[0], &atval[0]);
 		att_put_u16(vendor[1], &atval[2]);
 		att_put_u16(MANUFACTURER_SVC_UUID, &atval[4]);
-		attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE,
-						ATT_NOT_PERMITTED, atval, 6);
+		block_add(&blk, h++, &uuid, atval, 6);
 	}
 
 	/* Weight: characteristic */
@@ -477,8 +517,7 @@ static void register_weight_service(struct gatt_example_adapter *adapter,
 	atval[0] = ATT_CHAR_PROPER_READ;
 	att_put_u16(h + 1, &atval[1]);
 	memcpy(&atval[3], &char_weight_uuid_btorder, 16);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 19);
+	block_add(&blk, h++, &uuid, atval, 19);
 
 	/* Weight: characteristic value */
 	bt_uuid128_create(&uuid, char_weight_uuid);
@@ -486,8 +525,7 @@ static void register_weight_service(struct gatt_example_adapter *adapter,
 	atval[1] = 0x55;
 	atval[2] = 0x00;
 	atval[3] = 0x00;
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 4);
+	block_add(&blk, h++, &uuid, atval, 4);
 
 	/* Weight: characteristic format */
 	bt_uuid16_create(&uuid, GATT_CHARAC_FMT_UUID);
@@ -496,20 +534,20 @@ static void register_weight_service(struct gatt_example_adapter *adapter,
 	att_put_u16(FMT_KILOGRAM_UUID, &atval[2]);
 	att_put_u16(BLUETOOTH_SIG_UUID, &atval[4]);
 	att_put_u16(FMT_HANGING_UUID, &atval[6]);
-	attrib_db_add(adapter->adapter, h++, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, 8);
+	block_add(&blk, h++, &uuid, atval, 8);
 
 	/* Weight: characteristic user description */
 	bt_uuid16_create(&uuid, GATT_CHARAC_USER_DESC_UUID);
 	len = strlen(desc_weight);
 	strncpy((char *) atval, desc_weight, len);
-	attrib_db_add(adapter->adapter, h, &uuid, ATT_NONE, ATT_NOT_PERMITTED,
-								atval, len);
+	block_add(&blk, h, &uuid, atval, len);
 	g_assert(h - start_handle + 1 == svc_size);
 
-	/* Add an SDP record for the above service */
-	sdp_handle = attrib_create_sdp(adapter->adapter, start_handle,
-							"Weight Service");
+	/* Add the attributes and an SDP record for the above service */
+	if (!block_register(adapter->adapter, &blk, "Weight Service",
+								&sdp_handle))
+		return;
+
 	if (sdp_handle)
 		adapter->sdp_handles = g_slist_prepend(adapter->sdp_handles,
 						GUINT_TO_POINTER(sdp_handle));
@@ -47,7 +47,6 @@
 #include "profile.h"
 #include "error.h"
 #include "textfile.h"
-#include "attio.h"
 
 #define PHONE_ALERT_STATUS_SVC_UUID	0x180E
 #define ALERT_NOTIF_SVC_UUID		0x1811
@@ -115,19 +114,6 @@ struct alert_adapter {
 	uint16_t hnd_value[NOTIFY_SIZE];
 };
 
-struct notify_data {
-	struct alert_adapter *al_adapter;
-	enum notify_type type;
-	uint8_t *value;
-	size_t len;
-};
-
-struct notify_callback {
-	struct notify_data *notify_data;
-	struct btd_device *device;
-	guint id;
-};
-
 static GSList *registered_alerts = NULL;
 static GSList *alert_adapters = NULL;
 static uint8_t ringer_setting = RINGER_NORMAL;
@@ -322,122 +308,32 @@ static void watcher_disconnect(DBusConnection *conn, void *user_data)
 	g_slist_foreach(alert_adapters, update_supported_categories, NULL);
 }
 
-static gboolean is_notifiable_device(struct btd_device *device, uint16_t ccc)
-{
-	char *filename;
-	GKeyFile *key_file;
-	char handle[6];
-	char *str;
-	uint16_t val;
-	gboolean result;
-
-	sprintf(handle, "%hu", ccc);
-
-	filename = btd_device_get_storage_path(device, "ccc");
-	if (!filename) {
-		warn("Unable to get ccc storage path for device");
-		return FALSE;
-	}
-
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
-
-	str = g_key_file_get_string(key_file, handle, "Value", NULL);
-	if (!str) {
-		result = FALSE;
-		goto end;
-	}
-
-	val = strtol(str, NULL, 16);
-	if (!(val & 0x0001)) {
-		result = FALSE;
-		goto end;
-	}
-
-	result = TRUE;
-end:
-	g_free(str);
-	g_free(filename);
-	g_key_file_free(key_file);
-
-	return result;
-}
-
-static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
+static void notify_devices(struct alert_adapter *al_adapter,
+			enum notify_type type, uint8_t *value, size_t len)
 {
-	struct notify_callback *cb = user_data;
-	struct notify_data *nd = cb->notify_data;
-	enum notify_type type = nd->type;
-	struct alert_adapter *al_adapter = nd->al_adapter;
-	size_t len;
-	uint8_t *pdu = g_attrib_get_buffer(attrib, &len);
-
-
 	switch (type) {
 	case NOTIFY_RINGER_SETTING:
-		len = enc_notification(al_adapter->hnd_value[type],
-				&ringer_setting, sizeof(ringer_setting),
-				pdu, len);
+		value = &ringer_setting;
+		len = sizeof(ringer_setting);
 		break;
 	case NOTIFY_ALERT_STATUS:
-		len = enc_notification(al_adapter->hnd_value[type],
-				&alert_status, sizeof(alert_status),
-				pdu, len);
+		value = &alert_status;
+		len = sizeof(alert_status);
 		break;
 	case NOTIFY_NEW_ALERT:
 	case NOTIFY_UNREAD_ALERT:
-		len = enc_notification(al_adapter->hnd_value[type],
-					nd->value, nd->len, pdu, len);
 		break;
 	default:
 		DBG("Unknown type, could not send notification");
-		goto end;
+		return;
 	}
 
 	DBG("Send notification for handle: 0x%04x, ccc: 0x%04x",
 					al_adapter->hnd_value[type],
 					al_adapter->hnd_ccc[type]);
 
-	g_attrib_send(attrib, 0, pdu, len, NULL, NULL, NULL);
-
-end:
-	btd_device_remove_attio_callback(cb->device, cb->id);
-	btd_device_unref(cb->device);
-	g_free(cb->notify_data->value);
-	g_free(cb->notify_data);
-	g_free(cb);
-}
-
-static void filter_devices_notify(struct btd_device *device, void *user_data)
-{
-	struct notify_data *notify_data = user_data;
-	struct alert_adapter *al_adapter = notify_data->al_adapter;
-	enum notify_type type = notify_data->type;
-	struct notify_callback *cb;
-
-	if (!is_notifiable_device(device, al_adapter->hnd_ccc[type]))
-		return;
-
-	cb = g_new0(struct notify_callback, 1);
-	cb->notify_data = notify_data;
-	cb->device = btd_device_ref(device);
-	cb->id = btd_device_add_attio_callback(device,
-						attio_connected_cb, NULL, cb);
-}
-
-static void notify_devices(struct alert_adapter *al_adapter,
-			enum notify_type type, uint8_t *value, size_t len)
-{
-	struct notify_data *notify_data;
-
-	notify_data = g_new0(struct notify_data, 1);
-	notify_data->al_adapter = al_adapter;
-	notify_data->type = type;
-	notify_data->value = g_memdup(value, len);
-	notify_data->len = len;
-
-	btd_adapter_for_each_device(al_adapter->adapter, filter_devices_notify,
-					notify_data);
+	attrib_db_notify(al_adapter->adapter, al_adapter->hnd_value[type],
+								value, len);
 }
 
 static void pasp_notification(enum notify_type type)
@@ -931,6 +827,7 @@ static int alert_server_probe(struct btd_profile *p,
 						struct btd_adapter *adapter)
 {
 	struct alert_adapter *al_adapter;
+	enum notify_type type;
 
 	al_adapter = g_new0(struct alert_adapter, 1);
 	al_adapter->adapter = btd_adapter_ref(adapter);
@@ -940,6 +837,10 @@ static int alert_server_probe(struct btd_profile *p,
 	register_phone_alert_service(al_adapter);
 	register_alert_notif_service(al_adapter);
 
+	for (type = 0; type < NOTIFY_SIZE; type++)
+		attrib_db_set_notify_queue(adapter, al_adapter->hnd_value[type],
+									TRUE);
+
 	return 0;
 }
 
@@ -41,6 +41,7 @@
 #include "attrib/att.h"
 #include "attrib/gatt.h"
 #include "attio.h"
+#include "watcher-batch.h"
 #include "log.h"
 
 /* min length for ATT indication or notification: opcode (1b) + handle (2b) */
@@ -114,10 +115,11 @@ struct csc {
 };
 
 struct watcher {
-	struct csc_adapter	*cadapter;
-	guint			id;
-	char			*srv;
-	char			*path;
+	struct csc_adapter		*cadapter;
+	guint				id;
+	char				*srv;
+	char				*path;
+	struct btd_watcher_batch	*batch;
 };
 
 struct measurement {
@@ -215,6 +217,7 @@ static void destroy_watcher(gpointer user_data)
 {
 	struct watcher *watcher = user_data;
 
+	btd_watcher_batch_free(watcher->batch);
 	g_free(watcher->path);
 	g_free(watcher->srv);
 	g_free(watcher);
@@ -509,6 +512,23 @@ static void discover_desc(struct csc *csc, struct gatt_char *c,
 	gatt_discover_char_desc(csc->attrib, start, end, discover_desc_cb, ch);
 }
 
+static void append_measurement(DBusMessageIter *dict, struct measurement *m)
+{
+	if (m->has_wheel_rev) {
+		dict_append_entry(dict, "WheelRevolutions",
+					DBUS_TYPE_UINT32, &m->wheel_rev);
+		dict_append_entry(dict, "LastWheelEventTime",
+					DBUS_TYPE_UINT16, &m->last_wheel_time);
+	}
+
+	if (m->has_crank_rev) {
+		dict_append_entry(dict, "CrankRevolutions",
+					DBUS_TYPE_UINT16, &m->crank_rev);
+		dict_append_entry(dict, "LastCrankEventTime",
+					DBUS_TYPE_UINT16, &m->last_crank_time);
+	}
+}
+
 static void update_watcher(gpointer data, gpointer user_data)
 {
 	struct watcher *w = data;
@@ -516,9 +536,19 @@ static void update_watcher(gpointer data, gpointer user_data)
 	struct csc *csc = m->csc;
 	const char *path = device_get_path(csc->dev);
 	DBusMessageIter iter;
-	DBusMessageIter dict;
+	DBusMessageIter dict, *batch_dict;
 	DBusMessage *msg;
 
+	if (w->batch) {
+		batch_dict = btd_watcher_batch_append(w->batch, path);
+		if (batch_dict == NULL)
+			return;
+
+		append_measurement(batch_dict, m);
+		btd_watcher_batch_commit(w->batch);
+		return;
+	}
+
 	msg = dbus_message_new_method_call(w->srv, w->path,
 			CYCLINGSPEED_WATCHER_INTERFACE, "MeasurementReceived");
 	if (msg == NULL)
@@ -533,19 +563,7 @@ static void update_watcher(gpointer data, gpointer user_data)
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	if (m->has_wheel_rev) {
-		dict_append_entry(&dict, "WheelRevolutions",
-					DBUS_TYPE_UINT32, &m->wheel_rev);
-		dict_append_entry(&dict, "LastWheelEventTime",
-					DBUS_TYPE_UINT16, &m->last_wheel_time);
-	}
-
-	if (m->has_crank_rev) {
-		dict_append_entry(&dict, "CrankRevolutions",
-					DBUS_TYPE_UINT16, &m->crank_rev);
-		dict_append_entry(&dict, "LastCrankEventTime",
-					DBUS_TYPE_UINT16, &m->last_crank_time);
-	}
+	append_measurement(&dict, m);
 
 	dbus_message_iter_close_container(&iter, &dict);
 
@@ -880,6 +898,8 @@ static void watcher_exit_cb(DBusConnection *conn, void *user_data)
 
 	DBG("cycling watcher [%s] disconnected", watcher->path);
 
+	btd_watcher_batch_discard(watcher->batch);
+
 	cadapter->watchers = g_slist_remove(cadapter->watchers, watcher);
 	g_dbus_remove_watch(conn, watcher->id);
 
@@ -887,11 +907,11 @@ static void watcher_exit_cb(DBusConnection *conn, void *user_data)
 		g_slist_foreach(cadapter->devices, disable_measurement, 0);
 }
 
-static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
-								void *data)
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+				struct csc_adapter *cadapter, gboolean batched)
 {
-	struct csc_adapter *cadapter = data;
 	struct watcher *watcher;
+	struct btd_watcher_batch *batch = NULL;
 	const char *sender = dbus_message_get_sender(msg);
 	char *path;
 
@@ -903,8 +923,16 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	if (watcher != NULL)
 		return btd_error_already_exists(msg);
 
+	if (batched) {
+		batch = btd_watcher_batch_new(msg,
+					CYCLINGSPEED_WATCHER_INTERFACE);
+		if (batch == NULL)
+			return btd_error_invalid_args(msg);
+	}
+
 	watcher = g_new0(struct watcher, 1);
 	watcher->cadapter = cadapter;
+	watcher->batch = batch;
 	watcher->id = g_dbus_add_disconnect_watch(conn, sender, watcher_exit_cb,
 						watcher, destroy_watcher);
 	watcher->srv = g_strdup(sender);
@@ -920,6 +948,18 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	return add_watcher(conn, msg, data, FALSE);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	return add_watcher(conn, msg, data, TRUE);
+}
+
 static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
 								void *data)
 {
@@ -954,6 +994,9 @@ static const GDBusMethodTable cyclingspeed_manager_methods[] = {
 	{ GDBUS_METHOD("UnregisterWatcher",
 			GDBUS_ARGS({ "agent", "o" }), NULL,
 			unregister_watcher) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "options", "a{sv}" }),
+			NULL, register_batch_watcher) },
 	{ }
 };
 
@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <sdpd.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <glib.h>
 
@@ -1282,6 +1283,19 @@ static void mcl_uncached(struct mcap_mcl *mcl, gpointer data)
 	DBG("Mcl uncached %s", path);
 }
 
+static int read_clock(const bdaddr_t *src, const bdaddr_t *dst, int which,
+			int timeout, uint32_t *clock, uint16_t *accuracy)
+{
+	struct btd_adapter *adapter;
+
+	adapter = adapter_find(src);
+	if (adapter == NULL)
+		return -ENODEV;
+
+	return btd_adapter_read_clock(adapter, dst, which, timeout, clock,
+								accuracy);
+}
+
 static void check_devices_mcl(void)
 {
 	struct hdp_device *dev;
@@ -1347,6 +1361,8 @@ static gboolean update_adapter(struct hdp_adapter *hdp_adapter)
 		return FALSE;
 	}
 
+	mcap_set_read_clock(hdp_adapter->mi, read_clock);
+
 	hdp_adapter->ccpsm = mcap_get_ctrl_psm(hdp_adapter->mi, &err);
 	if (err != NULL) {
 		error("Error getting MCAP control PSM: %s", err->message);
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <string.h>
 
 #include <glib.h>
 
@@ -54,6 +55,15 @@
 	}					\
 } while(0)
 
+struct mcap_stream {
+	struct mcap_mdl		*mdl;		/* MDL being written */
+	uint8_t			*buf;		/* Pending records */
+	size_t			len;		/* Bytes pending in buf */
+	size_t			mtu;		/* Outgoing SDU size */
+	guint			max_delay;	/* Flush timeout (ms) */
+	guint			tid;		/* Flush timer id */
+};
+
 struct connect_mcl {
 	struct mcap_mcl		*mcl;		/* MCL for this operation */
 	mcap_mcl_connect_cb	connect_cb;	/* Connect callback */
@@ -708,6 +718,131 @@ int mcap_mdl_get_fd(struct mcap_mdl *mdl)
 	return g_io_channel_unix_get_fd(mdl->dc);
 }
 
+struct mcap_stream *mcap_stream_new(struct mcap_mdl *mdl, guint max_delay,
+								GError **err)
+{
+	struct mcap_stream *stream;
+	uint16_t omtu;
+
+	if (!mdl || mdl->state != MDL_CONNECTED) {
+		g_set_error(err, MCAP_ERROR, MCAP_ERROR_INVALID_ARGS,
+						"MDL is not connected");
+		return NULL;
+	}
+
+	if (!bt_io_get(mdl->dc, err, BT_IO_OPT_OMTU, &omtu,
+							BT_IO_OPT_INVALID))
+		return NULL;
+
+	stream = g_new0(struct mcap_stream, 1);
+	stream->mdl = mcap_mdl_ref(mdl);
+	stream->mtu = omtu;
+	stream->buf = g_malloc(omtu);
+	stream->max_delay = max_delay;
+
+	return stream;
+}
+
+size_t mcap_stream_get_mtu(struct mcap_stream *stream)
+{
+	return stream->mtu;
+}
+
+gboolean mcap_stream_flush(struct mcap_stream *stream, GError **err)
+{
+	int fd;
+
+	if (stream->tid) {
+		g_source_remove(stream->tid);
+		stream->tid = 0;
+	}
+
+	if (stream->len == 0)
+		return TRUE;
+
+	fd = mcap_mdl_get_fd(stream->mdl);
+	if (fd < 0) {
+		g_set_error(err, MCAP_ERROR, MCAP_ERROR_FAILED,
+						"MDL is not connected");
+		stream->len = 0;
+		return FALSE;
+	}
+
+	/*
+	 * Data channels are ERTM or streaming mode sockets, so every write
+	 * is sent as a single SDU and must not be split.
+	 */
+	if (write(fd, stream->buf, stream->len) < 0) {
+		g_set_error(err, MCAP_ERROR, MCAP_ERROR_FAILED,
+				"Data can't be sent: %s", strerror(errno));
+		stream->len = 0;
+		return FALSE;
+	}
+
+	stream->len = 0;
+
+	return TRUE;
+}
+
+static gboolean stream_timeout(gpointer user_data)
+{
+	struct mcap_stream *stream = user_data;
+	GError *gerr = NULL;
+
+	stream->tid = 0;
+
+	if (!mcap_stream_flush(stream, &gerr)) {
+		DBG("Stream flush failed: %s", gerr->message);
+		g_error_free(gerr);
+	}
+
+	return FALSE;
+}
+
+gboolean mcap_stream_write(struct mcap_stream *stream, const void *rec,
+						size_t len, GError **err)
+{
+	if (len > stream->mtu) {
+		g_set_error(err, MCAP_ERROR, MCAP_ERROR_INVALID_ARGS,
+					"Record exceeds data channel MTU");
+		return FALSE;
+	}
+
+	/* Records are never split across SDUs */
+	if (stream->len + len > stream->mtu &&
+				!mcap_stream_flush(stream, err))
+		return FALSE;
+
+	memcpy(stream->buf + stream->len, rec, len);
+	stream->len += len;
+
+	if (stream->len == stream->mtu)
+		return mcap_stream_flush(stream, err);
+
+	if (stream->max_delay == 0)
+		return mcap_stream_flush(stream, err);
+
+	if (!stream->tid)
+		stream->tid = g_timeout_add(stream->max_delay, stream_timeout,
+									stream);
+
+	return TRUE;
+}
+
+void mcap_stream_free(struct mcap_stream *stream)
+{
+	GError *gerr = NULL;
+
+	if (!mcap_stream_flush(stream, &gerr)) {
+		DBG("Stream flush failed: %s", gerr->message);
+		g_error_free(gerr);
+	}
+
+	mcap_mdl_unref(stream->mdl);
+	g_free(stream->buf);
+	g_free(stream);
+}
+
 uint16_t mcap_mdl_get_mdlid(struct mcap_mdl *mdl)
 {
 	if (!mdl)
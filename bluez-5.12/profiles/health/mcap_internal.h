@@ -77,6 +77,7 @@ struct mcap_instance {
 	int			ref;			/* Reference counter */
 
 	gboolean		csp_enabled;		/* CSP: functionality enabled */
+	mcap_read_clock_cb	read_clock;		/* CSP: clock reader */
 };
 
 struct mcap_csp;
@@ -61,6 +61,7 @@ typedef enum {
 struct mcap_instance;
 struct mcap_mcl;
 struct mcap_mdl;
+struct mcap_stream;
 struct sync_info_ind_data;
 
 /************ Callbacks ************/
@@ -109,6 +110,13 @@ typedef void (* mcap_sync_set_cb) (struct mcap_mcl *mcl,
 					GError *err,
 					gpointer data);
 
+typedef int (* mcap_read_clock_cb) (const bdaddr_t *src,
+					const bdaddr_t *dst,
+					int which,
+					int timeout,
+					uint32_t *clock,
+					uint16_t *accuracy);
+
 /************ Operations ************/
 
 /* MDL operations */
@@ -154,6 +162,16 @@ uint16_t mcap_mdl_get_mdlid(struct mcap_mdl *mdl);
 struct mcap_mdl *mcap_mdl_ref(struct mcap_mdl *mdl);
 void mcap_mdl_unref(struct mcap_mdl *mdl);
 
+/* Data channel streaming */
+
+struct mcap_stream *mcap_stream_new(struct mcap_mdl *mdl, guint max_delay,
+								GError **err);
+gboolean mcap_stream_write(struct mcap_stream *stream, const void *rec,
+						size_t len, GError **err);
+gboolean mcap_stream_flush(struct mcap_stream *stream, GError **err);
+size_t mcap_stream_get_mtu(struct mcap_stream *stream);
+void mcap_stream_free(struct mcap_stream *stream);
+
 /* MCL operations */
 
 gboolean mcap_create_mcl(struct mcap_instance *mi,
@@ -175,6 +193,7 @@ void mcap_mcl_unref(struct mcap_mcl *mcl);
 
 void mcap_enable_csp(struct mcap_instance *mi);
 void mcap_disable_csp(struct mcap_instance *mi);
+void mcap_set_read_clock(struct mcap_instance *mi, mcap_read_clock_cb cb);
 
 uint64_t mcap_get_timestamp(struct mcap_mcl *mcl,
 				struct timespec *given_time);
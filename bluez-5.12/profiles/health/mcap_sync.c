@@ -33,7 +33,6 @@
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/l2cap.h>
-#include <adapter.h>
 #include <btio/btio.h>
 #include <log.h>
 
@@ -228,13 +227,11 @@ static gboolean read_btclock(struct mcap_mcl *mcl, uint32_t *btclock,
 							uint16_t *btaccuracy)
 {
 	int which = 1;
-	struct btd_adapter *adapter;
 
-	adapter = adapter_find(&mcl->mi->src);
-	if (!adapter)
+	if (!mcl->mi->read_clock)
 		return FALSE;
 
-	if (btd_adapter_read_clock(adapter, &mcl->addr, which, 1000,
+	if (mcl->mi->read_clock(&mcl->mi->src, &mcl->addr, which, 1000,
 						btclock, btaccuracy) < 0)
 		return FALSE;
 
@@ -1008,3 +1005,8 @@ void mcap_disable_csp(struct mcap_instance *mi)
 {
 	mi->csp_enabled = FALSE;
 }
+
+void mcap_set_read_clock(struct mcap_instance *mi, mcap_read_clock_cb cb)
+{
+	mi->read_clock = cb;
+}
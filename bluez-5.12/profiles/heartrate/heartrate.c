@@ -41,6 +41,7 @@
 #include "attrib/att.h"
 #include "attrib/gatt.h"
 #include "attio.h"
+#include "watcher-batch.h"
 #include "log.h"
 
 #define HEART_RATE_INTERFACE		"org.bluez.HeartRate1"
@@ -80,6 +81,7 @@ struct watcher {
 	guint				id;
 	char				*srv;
 	char				*path;
+	struct btd_watcher_batch	*batch;
 };
 
 struct measurement {
@@ -165,6 +167,7 @@ static void destroy_watcher(gpointer user_data)
 {
 	struct watcher *watcher = user_data;
 
+	btd_watcher_batch_free(watcher->batch);
 	g_free(watcher->path);
 	g_free(watcher->srv);
 	g_free(watcher);
@@ -261,6 +264,23 @@ static void char_write_cb(guint8 status, const guint8 *pdu, guint16 len,
 	g_free(msg);
 }
 
+static void append_measurement(DBusMessageIter *dict, struct measurement *m)
+{
+	dict_append_entry(dict, "Value", DBUS_TYPE_UINT16, &m->value);
+
+	if (m->has_energy)
+		dict_append_entry(dict, "Energy", DBUS_TYPE_UINT16,
+								&m->energy);
+
+	if (m->has_contact)
+		dict_append_entry(dict, "Contact", DBUS_TYPE_BOOLEAN,
+								&m->contact);
+
+	if (m->num_interval > 0)
+		dict_append_array(dict, "Interval", DBUS_TYPE_UINT16,
+						&m->interval, m->num_interval);
+}
+
 static void update_watcher(gpointer data, gpointer user_data)
 {
 	struct watcher *w = data;
@@ -268,9 +288,19 @@ static void update_watcher(gpointer data, gpointer user_data)
 	struct heartrate *hr = m->hr;
 	const char *path = device_get_path(hr->dev);
 	DBusMessageIter iter;
-	DBusMessageIter dict;
+	DBusMessageIter dict, *batch_dict;
 	DBusMessage *msg;
 
+	if (w->batch) {
+		batch_dict = btd_watcher_batch_append(w->batch, path);
+		if (batch_dict == NULL)
+			return;
+
+		append_measurement(batch_dict, m);
+		btd_watcher_batch_commit(w->batch);
+		return;
+	}
+
 	msg = dbus_message_new_method_call(w->srv, w->path,
 			HEART_RATE_WATCHER_INTERFACE, "MeasurementReceived");
 	if (msg == NULL)
@@ -285,19 +315,7 @@ static void update_watcher(gpointer data, gpointer user_data)
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	dict_append_entry(&dict, "Value", DBUS_TYPE_UINT16, &m->value);
-
-	if (m->has_energy)
-		dict_append_entry(&dict, "Energy", DBUS_TYPE_UINT16,
-								&m->energy);
-
-	if (m->has_contact)
-		dict_append_entry(&dict, "Contact", DBUS_TYPE_BOOLEAN,
-								&m->contact);
-
-	if (m->num_interval > 0)
-		dict_append_array(&dict, "Interval", DBUS_TYPE_UINT16,
-						&m->interval, m->num_interval);
+	append_measurement(&dict, m);
 
 	dbus_message_iter_close_container(&iter, &dict);
 
@@ -568,6 +586,8 @@ static void watcher_exit_cb(DBusConnection *conn, void *user_data)
 
 	DBG("heartrate watcher [%s] disconnected", watcher->path);
 
+	btd_watcher_batch_discard(watcher->batch);
+
 	hradapter->watchers = g_slist_remove(hradapter->watchers, watcher);
 	g_dbus_remove_watch(conn, watcher->id);
 
@@ -575,11 +595,12 @@ static void watcher_exit_cb(DBusConnection *conn, void *user_data)
 		g_slist_foreach(hradapter->devices, disable_measurement, 0);
 }
 
-static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
-								void *data)
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+				struct heartrate_adapter *hradapter,
+				gboolean batched)
 {
-	struct heartrate_adapter *hradapter = data;
 	struct watcher *watcher;
+	struct btd_watcher_batch *batch = NULL;
 	const char *sender = dbus_message_get_sender(msg);
 	char *path;
 
@@ -591,8 +612,16 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	if (watcher != NULL)
 		return btd_error_already_exists(msg);
 
+	if (batched) {
+		batch = btd_watcher_batch_new(msg,
+						HEART_RATE_WATCHER_INTERFACE);
+		if (batch == NULL)
+			return btd_error_invalid_args(msg);
+	}
+
 	watcher = g_new0(struct watcher, 1);
 	watcher->hradapter = hradapter;
+	watcher->batch = batch;
 	watcher->id = g_dbus_add_disconnect_watch(conn, sender, watcher_exit_cb,
 						watcher, destroy_watcher);
 	watcher->srv = g_strdup(sender);
@@ -608,6 +637,18 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	return add_watcher(conn, msg, data, FALSE);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	return add_watcher(conn, msg, data, TRUE);
+}
+
 static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
 								void *data)
 {
@@ -642,6 +683,9 @@ static const GDBusMethodTable heartrate_manager_methods[] = {
 	{ GDBUS_METHOD("UnregisterWatcher",
 			GDBUS_ARGS({ "agent", "o" }), NULL,
 			unregister_watcher) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "options", "a{sv}" }),
+			NULL, register_batch_watcher) },
 	{ }
 };
 
@@ -27,13 +27,16 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
 #include "uhid_copy.h"
 
 #include <bluetooth/bluetooth.h>
@@ -54,6 +57,8 @@
 #include "attrib/gattrib.h"
 #include "attio.h"
 #include "attrib/gatt.h"
+#include "textfile.h"
+#include "src/shared/trace.h"
 
 #define HOG_UUID		"00001812-0000-1000-8000-00805f9b34fb"
 
@@ -90,6 +95,12 @@ struct hog_device {
 	uint16_t		proto_mode_handle;
 	uint16_t		ctrlpt_handle;
 	uint8_t			flags;
+	uint8_t			*report_map;
+	uint16_t		report_map_len;
+	gboolean		uhid_created;
+	gboolean		uhid_input2;
+	guint			store_id;
+	gboolean		fast_conn;
 };
 
 struct report {
@@ -98,6 +109,12 @@ struct report {
 	guint			notifyid;
 	struct gatt_char	*decl;
 	struct hog_device	*hogdev;
+	uint16_t		ccc_handle;
+	gboolean		ccc_enabled;
+	struct uhid_event	*ev;
+	unsigned int		input_count;
+	uint64_t		latency_total;
+	uint32_t		latency_max;
 };
 
 struct disc_desc_cb_data {
@@ -108,13 +125,155 @@ struct disc_desc_cb_data {
 static gboolean suspend_supported = FALSE;
 static GSList *devices = NULL;
 
+static gboolean store_hog_cb(gpointer user_data)
+{
+	struct hog_device *hogdev = user_data;
+	char *filename, group[6], *str;
+	GKeyFile *key_file;
+	char **reports;
+	char *data;
+	gsize length = 0;
+	GSList *l;
+	int i;
+
+	hogdev->store_id = 0;
+
+	if (hogdev->report_map == NULL)
+		return FALSE;
+
+	filename = btd_device_get_storage_path(hogdev->device, "hog");
+	if (!filename) {
+		warn("Unable to get hog storage path for device");
+		return FALSE;
+	}
+
+	key_file = g_key_file_new();
+	g_key_file_load_from_file(key_file, filename, 0, NULL);
+
+	snprintf(group, sizeof(group), "%hu", hogdev->id);
+	g_key_file_remove_group(key_file, group, NULL);
+
+	str = g_malloc0(hogdev->report_map_len * 2 + 1);
+	for (i = 0; i < hogdev->report_map_len; i++)
+		sprintf(str + (i * 2), "%2.2X", hogdev->report_map[i]);
+	g_key_file_set_string(key_file, group, "ReportMap", str);
+	g_free(str);
+
+	str = g_strdup_printf("%4.4X%2.2X%2.2X", hogdev->bcdhid,
+					hogdev->bcountrycode, hogdev->flags);
+	g_key_file_set_string(key_file, group, "Info", str);
+	g_free(str);
+
+	g_key_file_set_integer(key_file, group, "ProtocolModeHandle",
+						hogdev->proto_mode_handle);
+	g_key_file_set_integer(key_file, group, "ControlPointHandle",
+						hogdev->ctrlpt_handle);
+
+	reports = g_new0(char *, g_slist_length(hogdev->reports) + 1);
+
+	for (l = hogdev->reports, i = 0; l; l = l->next, i++) {
+		struct report *r = l->data;
+
+		reports[i] = g_strdup_printf("%hu:%hhu:%hu:%hhu:%hhu:%hu:%d:%s",
+					r->decl->handle, r->decl->properties,
+					r->decl->value_handle, r->id, r->type,
+					r->ccc_handle, r->ccc_enabled,
+					r->decl->uuid);
+	}
+
+	g_key_file_set_string_list(key_file, group, "Reports",
+					(const char **) reports, i);
+	g_strfreev(reports);
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (length > 0) {
+		create_file(filename, S_IRUSR | S_IWUSR);
+		g_file_set_contents(filename, data, length, NULL);
+	}
+
+	g_free(data);
+	g_free(filename);
+	g_key_file_free(key_file);
+
+	return FALSE;
+}
+
+static void store_hog(struct hog_device *hogdev)
+{
+	if (hogdev->store_id > 0 || !device_is_bonded(hogdev->device))
+		return;
+
+	hogdev->store_id = g_idle_add(store_hog_cb, hogdev);
+}
+
+static void forget_hog(struct hog_device *hogdev)
+{
+	char *filename, group[6];
+	GKeyFile *key_file;
+	char *data;
+	gsize length = 0;
+
+	if (hogdev->store_id > 0) {
+		g_source_remove(hogdev->store_id);
+		hogdev->store_id = 0;
+	}
+
+	filename = btd_device_get_storage_path(hogdev->device, "hog");
+	if (!filename)
+		return;
+
+	key_file = g_key_file_new();
+	g_key_file_load_from_file(key_file, filename, 0, NULL);
+
+	snprintf(group, sizeof(group), "%hu", hogdev->id);
+	g_key_file_remove_group(key_file, group, NULL);
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	g_file_set_contents(filename, data, length, NULL);
+
+	g_free(data);
+	g_free(filename);
+	g_key_file_free(key_file);
+}
+
+static uint64_t get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void reset_report_event(gpointer data, gpointer user_data)
+{
+	struct report *report = data;
+
+	g_free(report->ev);
+	report->ev = NULL;
+}
+
+static struct uhid_event *report_event_new(struct report *report)
+{
+	struct uhid_event *ev;
+
+	/* Legacy UHID_INPUT writes the whole event, so no byte of it may
+	 * be left uninitialized */
+	ev = g_new0(struct uhid_event, 1);
+	ev->type = report->hogdev->uhid_input2 ? UHID_INPUT2 : UHID_INPUT;
+
+	return ev;
+}
+
 static void report_value_cb(const uint8_t *pdu, uint16_t len,
 							gpointer user_data)
 {
 	struct report *report = user_data;
 	struct hog_device *hogdev = report->hogdev;
-	struct uhid_event ev;
-	uint16_t report_size = len - 3;
+	struct uhid_event *ev = report->ev;
+	uint64_t start = 0;
+	uint16_t size;
+	size_t ev_len;
 	uint8_t *buf;
 
 	if (len < 3) { /* 1-byte opcode + 2-byte handle */
@@ -122,23 +281,68 @@ static void report_value_cb(const uint8_t *pdu, uint16_t len,
 		return;
 	}
 
-	memset(&ev, 0, sizeof(ev));
-	ev.type = UHID_INPUT;
-	ev.u.input.size = MIN(report_size, UHID_DATA_MAX);
+	if (trace_is_enabled())
+		start = get_usec();
+
+	if (ev == NULL)
+		ev = report->ev = report_event_new(report);
+
+	/* The template is only ever partially rewritten: the kernel uses
+	 * the size field, so stale bytes past it are never looked at. */
+	if (ev->type == UHID_INPUT2)
+		buf = ev->u.input2.data;
+	else
+		buf = ev->u.input.data;
+
+	size = MIN(len - 3, UHID_DATA_MAX - 1);
 
-	buf = ev.u.input.data;
 	if (hogdev->has_report_id) {
 		*buf = report->id;
 		buf++;
-		ev.u.input.size++;
 	}
 
-	memcpy(buf, &pdu[3], MIN(report_size, UHID_DATA_MAX));
+	memcpy(buf, &pdu[3], size);
+
+	if (hogdev->has_report_id)
+		size++;
+
+	if (ev->type == UHID_INPUT2) {
+		ev->u.input2.size = size;
+		ev_len = offsetof(struct uhid_event, u.input2.data) + size;
+	} else {
+		ev->u.input.size = size;
+		ev_len = sizeof(*ev);
+	}
+
+	if (write(hogdev->uhid_fd, ev, ev_len) < 0) {
+		if (ev->type == UHID_INPUT2 &&
+				(errno == EOPNOTSUPP || errno == EINVAL)) {
+			DBG("uHID input2 not supported, using legacy input");
+			hogdev->uhid_input2 = FALSE;
+			g_slist_foreach(hogdev->reports, reset_report_event,
+									NULL);
+			report_value_cb(pdu, len, user_data);
+			return;
+		}
 
-	if (write(hogdev->uhid_fd, &ev, sizeof(ev)) < 0)
 		error("uHID write failed: %s", strerror(errno));
-	else
-		DBG("Report from HoG device 0x%04X written to uHID fd %d",
+		return;
+	}
+
+	if (start) {
+		uint32_t latency = get_usec() - start;
+
+		report->input_count++;
+		report->latency_total += latency;
+		if (latency > report->latency_max)
+			report->latency_max = latency;
+
+		trace_event(TRACE_HOG_INPUT, hogdev->id << 16 |
+					report->decl->value_handle, size,
+					latency);
+	}
+
+	DBG("Report from HoG device 0x%04X written to uHID fd %d",
 						hogdev->id, hogdev->uhid_fd);
 }
 
@@ -154,11 +358,20 @@ static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 		return;
 	}
 
-	report->notifyid = g_attrib_register(hogdev->attrib,
+	if (hogdev->attrib == NULL)
+		return;
+
+	if (report->notifyid == 0)
+		report->notifyid = g_attrib_register(hogdev->attrib,
 					ATT_OP_HANDLE_NOTIFY,
 					report->decl->value_handle,
 					report_value_cb, report, NULL);
 
+	if (!report->ccc_enabled) {
+		report->ccc_enabled = TRUE;
+		store_hog(hogdev);
+	}
+
 	DBG("Report characteristic descriptor written: notifications enabled");
 }
 
@@ -168,6 +381,8 @@ static void write_ccc(uint16_t handle, gpointer user_data)
 	struct hog_device *hogdev = report->hogdev;
 	uint8_t value[] = { 0x01, 0x00 };
 
+	report->ccc_handle = handle;
+
 	gatt_write_char(hogdev->attrib, handle, value, sizeof(value),
 					report_ccc_written_cb, report);
 }
@@ -191,6 +406,8 @@ static void report_reference_cb(guint8 status, const guint8 *pdu,
 	report->id = pdu[1];
 	report->type = pdu[2];
 	DBG("Report ID: 0x%02x Report type: 0x%02x", pdu[1], pdu[2]);
+
+	store_hog(report->hogdev);
 }
 
 static void external_report_reference_cb(guint8 status, const guint8 *pdu,
@@ -343,27 +560,11 @@ static void external_report_reference_cb(guint8 status, const guint8 *pdu,
 					external_service_char_cb, hogdev);
 }
 
-static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
-							gpointer user_data)
+static void parse_report_map(struct hog_device *hogdev, const uint8_t *value,
+								ssize_t vlen)
 {
-	struct hog_device *hogdev = user_data;
-	uint8_t value[HOG_REPORT_MAP_MAX_SIZE];
-	struct uhid_event ev;
-	uint16_t vendor_src, vendor, product, version;
-	ssize_t vlen;
 	int i;
 
-	if (status != 0) {
-		error("Report Map read failed: %s", att_ecode2str(status));
-		return;
-	}
-
-	vlen = dec_read_resp(pdu, plen, value, sizeof(value));
-	if (vlen < 0) {
-		error("ATT protocol error");
-		return;
-	}
-
 	DBG("Report MAP:");
 	for (i = 0; i < vlen; i++) {
 		switch (value[i]) {
@@ -381,6 +582,19 @@ static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 		}
 	}
 
+	g_free(hogdev->report_map);
+	hogdev->report_map = g_memdup(value, vlen);
+	hogdev->report_map_len = vlen;
+}
+
+static void create_uhid(struct hog_device *hogdev)
+{
+	struct uhid_event ev;
+	uint16_t vendor_src, vendor, product, version;
+
+	if (hogdev->uhid_created)
+		return;
+
 	vendor_src = btd_device_get_vendor_src(hogdev->device);
 	vendor = btd_device_get_vendor(hogdev->device);
 	product = btd_device_get_product(hogdev->device);
@@ -397,11 +611,61 @@ static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 	ev.u.create.version = version;
 	ev.u.create.country = hogdev->bcountrycode;
 	ev.u.create.bus = BUS_BLUETOOTH;
-	ev.u.create.rd_data = value;
-	ev.u.create.rd_size = vlen;
+	ev.u.create.rd_data = hogdev->report_map;
+	ev.u.create.rd_size = hogdev->report_map_len;
 
-	if (write(hogdev->uhid_fd, &ev, sizeof(ev)) < 0)
+	if (write(hogdev->uhid_fd, &ev, sizeof(ev)) < 0) {
 		error("Failed to create uHID device: %s", strerror(errno));
+		return;
+	}
+
+	hogdev->uhid_created = TRUE;
+	hogdev->uhid_input2 = TRUE;
+}
+
+static void request_fast_conn(struct hog_device *hogdev)
+{
+	if (hogdev->fast_conn)
+		return;
+
+	hogdev->fast_conn = TRUE;
+	btd_device_request_fast_conn(hogdev->device);
+}
+
+static void release_fast_conn(struct hog_device *hogdev)
+{
+	if (!hogdev->fast_conn)
+		return;
+
+	hogdev->fast_conn = FALSE;
+	btd_device_release_fast_conn(hogdev->device);
+}
+
+static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
+							gpointer user_data)
+{
+	struct hog_device *hogdev = user_data;
+	uint8_t value[HOG_REPORT_MAP_MAX_SIZE];
+	ssize_t vlen;
+
+	/* The idle timeout covers the descriptor setup still in flight */
+	release_fast_conn(hogdev);
+
+	if (status != 0) {
+		error("Report Map read failed: %s", att_ecode2str(status));
+		return;
+	}
+
+	vlen = dec_read_resp(pdu, plen, value, sizeof(value));
+	if (vlen < 0) {
+		error("ATT protocol error");
+		return;
+	}
+
+	parse_report_map(hogdev, value, vlen);
+	create_uhid(hogdev);
+
+	store_hog(hogdev);
 }
 
 static void info_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
@@ -429,6 +693,8 @@ static void info_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 
 	DBG("bcdHID: 0x%04X bCountryCode: 0x%02X Flags: 0x%02X",
 			hogdev->bcdhid, hogdev->bcountrycode, hogdev->flags);
+
+	store_hog(hogdev);
 }
 
 static void proto_mode_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
@@ -472,10 +738,12 @@ static void char_discovered_cb(GSList *chars, guint8 status, gpointer user_data)
 	struct report *report;
 	GSList *l;
 	uint16_t info_handle = 0, proto_mode_handle = 0;
+	gboolean report_map = FALSE;
 
 	if (status != 0) {
 		const char *str = att_ecode2str(status);
 		DBG("Discover all characteristics failed: %s", str);
+		release_fast_conn(hogdev);
 		return;
 	}
 
@@ -511,6 +779,7 @@ static void char_discovered_cb(GSList *chars, guint8 status, gpointer user_data)
 		} else if (bt_uuid_cmp(&uuid, &report_map_uuid) == 0) {
 			gatt_read_char(hogdev->attrib, chr->value_handle,
 						report_map_read_cb, hogdev);
+			report_map = TRUE;
 			discover_descriptor(hogdev->attrib, start, end, hogdev);
 		} else if (bt_uuid_cmp(&uuid, &info_uuid) == 0)
 			info_handle = chr->value_handle;
@@ -520,6 +789,9 @@ static void char_discovered_cb(GSList *chars, guint8 status, gpointer user_data)
 			hogdev->ctrlpt_handle = chr->value_handle;
 	}
 
+	if (!report_map)
+		release_fast_conn(hogdev);
+
 	if (proto_mode_handle) {
 		hogdev->proto_mode_handle = proto_mode_handle;
 		gatt_read_char(hogdev->attrib, proto_mode_handle,
@@ -534,6 +806,11 @@ static void char_discovered_cb(GSList *chars, guint8 status, gpointer user_data)
 static void output_written_cb(guint8 status, const guint8 *pdu,
 					guint16 plen, gpointer user_data)
 {
+	struct hog_device *hogdev = user_data;
+
+	if (status == ATT_ECODE_INVALID_HANDLE)
+		forget_hog(hogdev);
+
 	if (status != 0) {
 		error("Write output report failed: %s", att_ecode2str(status));
 		return;
@@ -673,10 +950,98 @@ failed:
 	return FALSE;
 }
 
+static void report_free(void *data);
+
+static gboolean cached_report_matches(struct hog_device *hogdev,
+						const struct gatt_char *chr)
+{
+	GSList *l;
+
+	for (l = hogdev->reports; l; l = l->next) {
+		struct report *r = l->data;
+
+		if (r->decl->handle == chr->handle &&
+				r->decl->value_handle == chr->value_handle &&
+				r->decl->properties == chr->properties)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean cache_matches(struct hog_device *hogdev, GSList *chars)
+{
+	bt_uuid_t report_uuid, proto_mode_uuid, ctrlpt_uuid;
+	uint16_t proto_mode_handle = 0, ctrlpt_handle = 0;
+	unsigned int reports = 0;
+	GSList *l;
+
+	bt_uuid16_create(&report_uuid, HOG_REPORT_UUID);
+	bt_uuid16_create(&proto_mode_uuid, HOG_PROTO_MODE_UUID);
+	bt_uuid16_create(&ctrlpt_uuid, HOG_CONTROL_POINT_UUID);
+
+	for (l = chars; l; l = g_slist_next(l)) {
+		struct gatt_char *chr = l->data;
+		bt_uuid_t uuid;
+
+		bt_string_to_uuid(&uuid, chr->uuid);
+
+		if (bt_uuid_cmp(&uuid, &report_uuid) == 0) {
+			if (!cached_report_matches(hogdev, chr))
+				return FALSE;
+			reports++;
+		} else if (bt_uuid_cmp(&uuid, &proto_mode_uuid) == 0)
+			proto_mode_handle = chr->value_handle;
+		else if (bt_uuid_cmp(&uuid, &ctrlpt_uuid) == 0)
+			ctrlpt_handle = chr->value_handle;
+	}
+
+	return reports == g_slist_length(hogdev->reports) &&
+			proto_mode_handle == hogdev->proto_mode_handle &&
+			ctrlpt_handle == hogdev->ctrlpt_handle;
+}
+
+static void cache_verify_cb(GSList *chars, guint8 status, gpointer user_data)
+{
+	struct hog_device *hogdev = user_data;
+	struct uhid_event ev;
+
+	if (status != 0) {
+		DBG("Cache check failed: %s", att_ecode2str(status));
+		return;
+	}
+
+	if (cache_matches(hogdev, chars))
+		return;
+
+	DBG("HoG 0x%04X database changed, rediscovering", hogdev->id);
+
+	forget_hog(hogdev);
+
+	g_slist_free_full(hogdev->reports, report_free);
+	hogdev->reports = NULL;
+	hogdev->proto_mode_handle = 0;
+	hogdev->ctrlpt_handle = 0;
+	hogdev->has_report_id = FALSE;
+
+	if (hogdev->uhid_created) {
+		memset(&ev, 0, sizeof(ev));
+		ev.type = UHID_DESTROY;
+		if (write(hogdev->uhid_fd, &ev, sizeof(ev)) < 0)
+			error("Failed to destroy uHID device: %s",
+							strerror(errno));
+		hogdev->uhid_created = FALSE;
+	}
+
+	request_fast_conn(hogdev);
+	char_discovered_cb(chars, status, hogdev);
+}
+
 static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
 {
 	struct hog_device *hogdev = user_data;
 	struct gatt_primary *prim = hogdev->hog_primary;
+	gboolean bonded;
 	GSList *l;
 
 	DBG("HoG connected");
@@ -684,12 +1049,19 @@ static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
 	hogdev->attrib = g_attrib_ref(attrib);
 
 	if (hogdev->reports == NULL) {
+		/* Keep the link fast until the report map is read */
+		request_fast_conn(hogdev);
+
 		gatt_discover_char(hogdev->attrib, prim->range.start,
 						prim->range.end, NULL,
 						char_discovered_cb, hogdev);
 		return;
 	}
 
+	/* Bonded devices keep the CCC configuration across connections,
+	 * so only descriptors that were never written need replaying. */
+	bonded = device_is_bonded(hogdev->device);
+
 	for (l = hogdev->reports; l; l = l->next) {
 		struct report *r = l->data;
 
@@ -697,7 +1069,15 @@ static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
 					ATT_OP_HANDLE_NOTIFY,
 					r->decl->value_handle,
 					report_value_cb, r, NULL);
+
+		if (r->ccc_handle && (!bonded || !r->ccc_enabled))
+			write_ccc(r->ccc_handle, r);
 	}
+
+	/* Input flows from the cache right away, but the device may have
+	 * changed its database since, so check the handles it reports. */
+	gatt_discover_char(hogdev->attrib, prim->range.start, prim->range.end,
+					NULL, cache_verify_cb, hogdev);
 }
 
 static void attio_disconnected_cb(gpointer user_data)
@@ -707,16 +1087,137 @@ static void attio_disconnected_cb(gpointer user_data)
 
 	DBG("HoG disconnected");
 
+	release_fast_conn(hogdev);
+
 	for (l = hogdev->reports; l; l = l->next) {
 		struct report *r = l->data;
 
 		g_attrib_unregister(hogdev->attrib, r->notifyid);
+		r->notifyid = 0;
+
+		if (r->input_count == 0)
+			continue;
+
+		DBG("Report 0x%04X: %u inputs, latency avg %u max %u usec",
+				r->decl->value_handle, r->input_count,
+				(unsigned int) (r->latency_total /
+							r->input_count),
+				r->latency_max);
+
+		r->input_count = 0;
+		r->latency_total = 0;
+		r->latency_max = 0;
 	}
 
 	g_attrib_unref(hogdev->attrib);
 	hogdev->attrib = NULL;
 }
 
+static gboolean load_report(struct hog_device *hogdev, const char *str)
+{
+	struct report *report;
+	struct gatt_char chr;
+	unsigned int handle, props, value_handle, id, type, ccc;
+	int enabled;
+
+	memset(&chr, 0, sizeof(chr));
+
+	if (sscanf(str, "%u:%u:%u:%u:%u:%u:%d:%36s", &handle, &props,
+				&value_handle, &id, &type, &ccc, &enabled,
+				chr.uuid) != 8)
+		return FALSE;
+
+	chr.handle = handle;
+	chr.properties = props;
+	chr.value_handle = value_handle;
+
+	report = g_new0(struct report, 1);
+	report->hogdev = hogdev;
+	report->decl = g_memdup(&chr, sizeof(chr));
+	report->id = id;
+	report->type = type;
+	report->ccc_handle = ccc;
+	report->ccc_enabled = enabled;
+	hogdev->reports = g_slist_append(hogdev->reports, report);
+
+	return TRUE;
+}
+
+static gboolean load_hog(struct hog_device *hogdev)
+{
+	char *filename, group[6], *str;
+	uint8_t value[HOG_REPORT_MAP_MAX_SIZE];
+	GKeyFile *key_file;
+	char **reports;
+	gsize len = 0;
+	gboolean ret = FALSE;
+	unsigned int i;
+
+	if (!device_is_bonded(hogdev->device))
+		return FALSE;
+
+	filename = btd_device_get_storage_path(hogdev->device, "hog");
+	if (!filename)
+		return FALSE;
+
+	key_file = g_key_file_new();
+	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	g_free(filename);
+
+	snprintf(group, sizeof(group), "%hu", hogdev->id);
+
+	str = g_key_file_get_string(key_file, group, "ReportMap", NULL);
+	if (str == NULL || strlen(str) / 2 > sizeof(value)) {
+		g_free(str);
+		goto done;
+	}
+
+	for (i = 0; i < strlen(str) / 2; i++)
+		sscanf(str + (i * 2), "%02hhX", &value[i]);
+
+	parse_report_map(hogdev, value, i);
+	g_free(str);
+
+	str = g_key_file_get_string(key_file, group, "Info", NULL);
+	if (str && sscanf(str, "%04hX%02hhX%02hhX", &hogdev->bcdhid,
+				&hogdev->bcountrycode, &hogdev->flags) != 3)
+		DBG("Invalid cached HID Information");
+	g_free(str);
+
+	hogdev->proto_mode_handle = g_key_file_get_integer(key_file, group,
+						"ProtocolModeHandle", NULL);
+	hogdev->ctrlpt_handle = g_key_file_get_integer(key_file, group,
+						"ControlPointHandle", NULL);
+
+	reports = g_key_file_get_string_list(key_file, group, "Reports",
+								&len, NULL);
+	for (i = 0; i < len; i++) {
+		if (load_report(hogdev, reports[i]))
+			continue;
+
+		g_slist_free_full(hogdev->reports, report_free);
+		hogdev->reports = NULL;
+		break;
+	}
+	g_strfreev(reports);
+
+	ret = hogdev->reports != NULL;
+	if (!ret) {
+		g_free(hogdev->report_map);
+		hogdev->report_map = NULL;
+		hogdev->report_map_len = 0;
+		hogdev->has_report_id = FALSE;
+	}
+
+	DBG("HoG 0x%04X cached database %s", hogdev->id,
+						ret ? "loaded" : "invalid");
+
+done:
+	g_key_file_free(key_file);
+
+	return ret;
+}
+
 static struct hog_device *hog_new_device(struct btd_device *device,
 								uint16_t id)
 {
@@ -740,16 +1241,25 @@ static void report_free(void *data)
 	if (hogdev->attrib)
 		g_attrib_unregister(hogdev->attrib, report->notifyid);
 
+	g_free(report->ev);
 	g_free(report->decl);
 	g_free(report);
 }
 
 static void hog_free_device(struct hog_device *hogdev)
 {
+	release_fast_conn(hogdev);
+
+	if (hogdev->store_id > 0) {
+		g_source_remove(hogdev->store_id);
+		store_hog_cb(hogdev);
+	}
+
 	btd_device_unref(hogdev->device);
 	g_slist_free_full(hogdev->reports, report_free);
 	g_attrib_unref(hogdev->attrib);
 	g_free(hogdev->hog_primary);
+	g_free(hogdev->report_map);
 	g_free(hogdev);
 }
 
@@ -780,6 +1290,9 @@ static struct hog_device *hog_register_device(struct btd_device *device,
 
 	hogdev->hog_primary = g_memdup(prim, sizeof(*prim));
 
+	if (load_hog(hogdev))
+		create_uhid(hogdev);
+
 	hogdev->attioid = btd_device_add_attio_callback(device,
 							attio_connected_cb,
 							attio_disconnected_cb,
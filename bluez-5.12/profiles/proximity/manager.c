@@ -40,6 +40,7 @@
 #include "attrib/gattrib.h"
 #include "attrib/gatt.h"
 #include "monitor.h"
+#include "sampler.h"
 #include "reporter.h"
 #include "manager.h"
 
@@ -140,7 +141,8 @@ static struct btd_profile pxp_reporter_profile = {
 static void load_config_file(GKeyFile *config)
 {
 	char **list;
-	int i;
+	int i, interval;
+	GError *gerr = NULL;
 
 	if (config == NULL)
 		return;
@@ -157,6 +159,16 @@ static void load_config_file(GKeyFile *config)
 	}
 
 	g_strfreev(list);
+
+	interval = g_key_file_get_integer(config, "General", "SampleInterval",
+									&gerr);
+	if (gerr) {
+		g_clear_error(&gerr);
+		return;
+	}
+
+	if (interval > 0)
+		sampler_set_interval(interval);
 }
 
 int proximity_manager_init(GKeyFile *config)
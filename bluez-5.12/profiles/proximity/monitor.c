@@ -49,6 +49,7 @@
 #include "attrib/gatt.h"
 #include "attio.h"
 #include "monitor.h"
+#include "sampler.h"
 #include "textfile.h"
 
 #define PROXIMITY_INTERFACE "org.bluez.ProximityMonitor1"
@@ -79,6 +80,8 @@ struct monitor {
 	uint16_t linklosshandle;	/* Link Loss Characteristic
 					 * Value Handle */
 	uint16_t txpowerhandle;		/* Tx Characteristic Value Handle */
+	gboolean txpowervalid;
+	int8_t txpowerlevel;		/* Cached Tx Power Level */
 	uint16_t immediatehandle;	/* Immediate Alert Value Handle */
 	guint immediateto;		/* Reset Immediate Alert to "none" */
 	guint attioid;
@@ -237,6 +240,7 @@ static int write_alert_level(struct monitor *monitor)
 static void tx_power_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 							gpointer user_data)
 {
+	struct monitor *monitor = user_data;
 	uint8_t value[TX_POWER_SIZE];
 	ssize_t vlen;
 
@@ -257,6 +261,42 @@ static void tx_power_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 	}
 
 	DBG("Tx Power Level: %02x", (int8_t) value[0]);
+
+	monitor->txpowerlevel = value[0];
+	monitor->txpowervalid = TRUE;
+
+	sampler_set_txpower(monitor->device, monitor->txpowerlevel);
+}
+
+static void signal_level_cb(const char *level, void *user_data)
+{
+	struct monitor *monitor = user_data;
+	const char *path = device_get_path(monitor->device);
+
+	if (g_strcmp0(monitor->signallevel, level) == 0)
+		return;
+
+	g_free(monitor->signallevel);
+	monitor->signallevel = g_strdup(level);
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(), path,
+				PROXIMITY_INTERFACE, "SignalLevel");
+}
+
+static void start_sampling(struct monitor *monitor)
+{
+	if (sampler_add_device(monitor->device, signal_level_cb, monitor) < 0)
+		return;
+
+	if (monitor->txpowervalid)
+		sampler_set_txpower(monitor->device, monitor->txpowerlevel);
+}
+
+static void stop_sampling(struct monitor *monitor)
+{
+	sampler_remove_device(monitor->device);
+
+	signal_level_cb("unknown", monitor);
 }
 
 static void tx_power_handle_cb(GSList *characteristics, guint8 status,
@@ -387,8 +427,10 @@ static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
 	if (monitor->enabled.linkloss)
 		write_alert_level(monitor);
 
-	if (monitor->enabled.pathloss)
+	if (monitor->enabled.pathloss) {
+		start_sampling(monitor);
 		read_tx_power(monitor);
+	}
 
 	if (monitor->immediatehandle == 0) {
 		if(monitor->enabled.pathloss || monitor->enabled.findme)
@@ -405,6 +447,8 @@ static void attio_disconnected_cb(gpointer user_data)
 	g_attrib_unref(monitor->attrib);
 	monitor->attrib = NULL;
 
+	stop_sampling(monitor);
+
 	if (monitor->immediateto == 0)
 		return;
 
@@ -798,6 +842,7 @@ void monitor_unregister_txpower(struct btd_device *device)
 	monitor->txpower = NULL;
 	monitor->enabled.pathloss = FALSE;
 
+	stop_sampling(monitor);
 	cleanup_monitor(monitor);
 }
 
@@ -814,5 +859,6 @@ void monitor_unregister_immediate(struct btd_device *device)
 	monitor->enabled.findme = FALSE;
 	monitor->enabled.pathloss = FALSE;
 
+	stop_sampling(monitor);
 	cleanup_monitor(monitor);
 }
@@ -0,0 +1,434 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <glib.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+#include "adapter.h"
+#include "device.h"
+#include "log.h"
+#include "sampler.h"
+
+#define DEFAULT_INTERVAL	2	/* seconds */
+#define MAX_CONNECTIONS		64
+#define INVALID_HANDLE		0xffff
+
+/* Path loss is smoothed with an EWMA of weight 1/SMOOTH_WEIGHT */
+#define SMOOTH_SCALE		16
+#define SMOOTH_WEIGHT		4
+
+/* Path loss thresholds (dB) and the hysteresis needed to cross them */
+#define GOOD_MAX_LOSS		65
+#define REGULAR_MAX_LOSS	85
+#define LOSS_HYSTERESIS		3
+
+enum {
+	SIGNAL_UNKNOWN = 0,
+	SIGNAL_GOOD,
+	SIGNAL_REGULAR,
+	SIGNAL_WEAK,
+};
+
+static const char *signal_levels[] = {
+	"unknown",
+	"good",
+	"regular",
+	"weak",
+};
+
+struct sampler {
+	struct btd_adapter *adapter;
+	GIOChannel *io;
+	guint watch;
+	guint timer;
+	GSList *devices;
+};
+
+struct sampled_device {
+	struct sampler *sampler;
+	struct btd_device *device;
+	uint16_t handle;
+	gboolean has_txpower;
+	int8_t txpower;			/* Cached Tx Power Level */
+	gboolean has_loss;
+	int loss;			/* Smoothed path loss, scaled */
+	int level;
+	sampler_level_cb cb;
+	void *user_data;
+};
+
+static GSList *samplers = NULL;
+static unsigned int sample_interval = DEFAULT_INTERVAL;
+
+static struct sampler *find_sampler(struct btd_adapter *adapter)
+{
+	GSList *l;
+
+	for (l = samplers; l; l = l->next) {
+		struct sampler *sampler = l->data;
+
+		if (sampler->adapter == adapter)
+			return sampler;
+	}
+
+	return NULL;
+}
+
+static struct sampled_device *find_device(struct btd_device *device)
+{
+	struct sampler *sampler;
+	GSList *l;
+
+	sampler = find_sampler(device_get_adapter(device));
+	if (sampler == NULL)
+		return NULL;
+
+	for (l = sampler->devices; l; l = l->next) {
+		struct sampled_device *dev = l->data;
+
+		if (dev->device == device)
+			return dev;
+	}
+
+	return NULL;
+}
+
+static struct sampled_device *find_handle(struct sampler *sampler,
+							uint16_t handle)
+{
+	GSList *l;
+
+	for (l = sampler->devices; l; l = l->next) {
+		struct sampled_device *dev = l->data;
+
+		if (dev->handle == handle)
+			return dev;
+	}
+
+	return NULL;
+}
+
+static int loss2level(int loss)
+{
+	if (loss < GOOD_MAX_LOSS)
+		return SIGNAL_GOOD;
+
+	if (loss < REGULAR_MAX_LOSS)
+		return SIGNAL_REGULAR;
+
+	return SIGNAL_WEAK;
+}
+
+static void update_sample(struct sampled_device *dev, int8_t rssi)
+{
+	int sample, loss, level;
+
+	if (!dev->has_txpower)
+		return;
+
+	sample = (dev->txpower - rssi) * SMOOTH_SCALE;
+
+	if (!dev->has_loss) {
+		dev->loss = sample;
+		dev->has_loss = TRUE;
+	} else
+		dev->loss += (sample - dev->loss) / SMOOTH_WEIGHT;
+
+	loss = dev->loss / SMOOTH_SCALE;
+	level = loss2level(loss);
+
+	if (level == dev->level)
+		return;
+
+	/* Don't flap around a threshold */
+	if (level > dev->level && dev->level != SIGNAL_UNKNOWN &&
+			loss2level(loss - LOSS_HYSTERESIS) <= dev->level)
+		return;
+
+	if (level < dev->level &&
+			loss2level(loss + LOSS_HYSTERESIS) >= dev->level)
+		return;
+
+	DBG("%s path loss %d dB", signal_levels[level], loss);
+
+	dev->level = level;
+	dev->cb(signal_levels[level], dev->user_data);
+}
+
+static gboolean sampler_event(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct sampler *sampler = user_data;
+	unsigned char buf[HCI_MAX_EVENT_SIZE];
+	hci_event_hdr *hdr;
+	evt_cmd_complete *cc;
+	read_rssi_rp *rp;
+	struct sampled_device *dev;
+	ssize_t len;
+
+	if (cond & (G_IO_NVAL | G_IO_ERR | G_IO_HUP)) {
+		sampler->watch = 0;
+		return FALSE;
+	}
+
+	len = read(g_io_channel_unix_get_fd(io), buf, sizeof(buf));
+	if (len < 0)
+		return TRUE;
+
+	if (len < 1 + HCI_EVENT_HDR_SIZE + EVT_CMD_COMPLETE_SIZE +
+							READ_RSSI_RP_SIZE)
+		return TRUE;
+
+	hdr = (void *) (buf + 1);
+	if (buf[0] != HCI_EVENT_PKT || hdr->evt != EVT_CMD_COMPLETE)
+		return TRUE;
+
+	cc = (void *) (buf + 1 + HCI_EVENT_HDR_SIZE);
+	if (btohs(cc->opcode) != cmd_opcode_pack(OGF_STATUS_PARAM,
+							OCF_READ_RSSI))
+		return TRUE;
+
+	rp = (void *) (buf + 1 + HCI_EVENT_HDR_SIZE + EVT_CMD_COMPLETE_SIZE);
+	if (rp->status)
+		return TRUE;
+
+	dev = find_handle(sampler, btohs(rp->handle) & 0x0fff);
+	if (dev)
+		update_sample(dev, rp->rssi);
+
+	return TRUE;
+}
+
+static struct hci_conn_info *find_conn(struct hci_conn_list_req *cl,
+							const bdaddr_t *bdaddr)
+{
+	struct hci_conn_info *ci = cl->conn_info;
+	int i;
+
+	for (i = 0; i < cl->conn_num; i++, ci++) {
+		if (ci->type == SCO_LINK || ci->type == ESCO_LINK)
+			continue;
+
+		if (bacmp(&ci->bdaddr, bdaddr) == 0)
+			return ci;
+	}
+
+	return NULL;
+}
+
+/*
+ * Reads RSSI for every sampled device of an adapter in one pass: the
+ * connection list is fetched once and all Read RSSI commands are queued
+ * back to back. Completions are collected by sampler_event() instead of
+ * waiting on each command.
+ */
+static gboolean sample_timeout(gpointer user_data)
+{
+	struct sampler *sampler = user_data;
+	struct hci_conn_list_req *cl;
+	GSList *l;
+	int dd;
+
+	dd = g_io_channel_unix_get_fd(sampler->io);
+
+	cl = g_malloc0(sizeof(*cl) +
+			MAX_CONNECTIONS * sizeof(struct hci_conn_info));
+	cl->dev_id = btd_adapter_get_index(sampler->adapter);
+	cl->conn_num = MAX_CONNECTIONS;
+
+	if (ioctl(dd, HCIGETCONNLIST, cl) < 0) {
+		error("Can't get connection list: %s (%d)", strerror(errno),
+									errno);
+		g_free(cl);
+		return TRUE;
+	}
+
+	for (l = sampler->devices; l; l = l->next) {
+		struct sampled_device *dev = l->data;
+		struct hci_conn_info *ci;
+		uint16_t handle;
+
+		ci = find_conn(cl, device_get_address(dev->device));
+		if (ci == NULL) {
+			dev->handle = INVALID_HANDLE;
+			continue;
+		}
+
+		dev->handle = ci->handle;
+		handle = htobs(ci->handle);
+
+		if (hci_send_cmd(dd, OGF_STATUS_PARAM, OCF_READ_RSSI,
+						sizeof(handle), &handle) < 0) {
+			error("Can't read RSSI: %s (%d)", strerror(errno),
+									errno);
+			break;
+		}
+	}
+
+	g_free(cl);
+
+	return TRUE;
+}
+
+static struct sampler *sampler_new(struct btd_adapter *adapter)
+{
+	struct sampler *sampler;
+	struct hci_filter flt;
+	int dd;
+
+	dd = hci_open_dev(btd_adapter_get_index(adapter));
+	if (dd < 0) {
+		error("Can't open HCI device: %s (%d)", strerror(errno),
+									errno);
+		return NULL;
+	}
+
+	hci_filter_clear(&flt);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &flt);
+	hci_filter_set_event(EVT_CMD_COMPLETE, &flt);
+	hci_filter_set_opcode(cmd_opcode_pack(OGF_STATUS_PARAM,
+						OCF_READ_RSSI), &flt);
+
+	if (setsockopt(dd, SOL_HCI, HCI_FILTER, &flt, sizeof(flt)) < 0) {
+		error("Can't set HCI filter: %s (%d)", strerror(errno), errno);
+		hci_close_dev(dd);
+		return NULL;
+	}
+
+	sampler = g_new0(struct sampler, 1);
+	sampler->adapter = adapter;
+	sampler->io = g_io_channel_unix_new(dd);
+	g_io_channel_set_close_on_unref(sampler->io, TRUE);
+	sampler->watch = g_io_add_watch(sampler->io,
+				G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+				sampler_event, sampler);
+	sampler->timer = g_timeout_add_seconds(sample_interval,
+						sample_timeout, sampler);
+
+	samplers = g_slist_append(samplers, sampler);
+
+	return sampler;
+}
+
+static void sampler_free(struct sampler *sampler)
+{
+	samplers = g_slist_remove(samplers, sampler);
+
+	if (sampler->timer > 0)
+		g_source_remove(sampler->timer);
+
+	if (sampler->watch > 0)
+		g_source_remove(sampler->watch);
+
+	g_io_channel_unref(sampler->io);
+	g_free(sampler);
+}
+
+void sampler_set_interval(unsigned int seconds)
+{
+	if (seconds > 0)
+		sample_interval = seconds;
+}
+
+int sampler_add_device(struct btd_device *device, sampler_level_cb cb,
+							void *user_data)
+{
+	struct btd_adapter *adapter = device_get_adapter(device);
+	struct sampled_device *dev;
+	struct sampler *sampler;
+
+	dev = find_device(device);
+	if (dev) {
+		dev->cb = cb;
+		dev->user_data = user_data;
+		return 0;
+	}
+
+	sampler = find_sampler(adapter);
+	if (sampler == NULL) {
+		sampler = sampler_new(adapter);
+		if (sampler == NULL)
+			return -EIO;
+	}
+
+	dev = g_new0(struct sampled_device, 1);
+	dev->sampler = sampler;
+	dev->device = btd_device_ref(device);
+	dev->handle = INVALID_HANDLE;
+	dev->cb = cb;
+	dev->user_data = user_data;
+
+	sampler->devices = g_slist_append(sampler->devices, dev);
+
+	return 0;
+}
+
+void sampler_remove_device(struct btd_device *device)
+{
+	struct sampled_device *dev;
+	struct sampler *sampler;
+
+	dev = find_device(device);
+	if (dev == NULL)
+		return;
+
+	sampler = dev->sampler;
+	sampler->devices = g_slist_remove(sampler->devices, dev);
+
+	btd_device_unref(dev->device);
+	g_free(dev);
+
+	if (sampler->devices == NULL)
+		sampler_free(sampler);
+}
+
+void sampler_set_txpower(struct btd_device *device, int8_t txpower)
+{
+	struct sampled_device *dev;
+
+	dev = find_device(device);
+	if (dev == NULL)
+		return;
+
+	/* Restart smoothing if the reference level changed */
+	if (dev->has_txpower && dev->txpower != txpower)
+		dev->has_loss = FALSE;
+
+	dev->txpower = txpower;
+	dev->has_txpower = TRUE;
+}
@@ -0,0 +1,1022 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <glib.h>
+#include <gdbus/gdbus.h>
+
+#include "lib/uuid.h"
+#include "plugin.h"
+#include "adapter.h"
+#include "dbus-common.h"
+#include "device.h"
+#include "profile.h"
+#include "service.h"
+#include "error.h"
+#include "attrib/gattrib.h"
+#include "attrib/att.h"
+#include "attrib/gatt.h"
+#include "attio.h"
+#include "watcher-batch.h"
+#include "log.h"
+
+#define SENSORTAG_MANAGER_INTERFACE	"org.bluez.SensorTagManager1"
+#define SENSORTAG_WATCHER_INTERFACE	"org.bluez.SensorTagWatcher1"
+
+#define TI_UUID(x)	"f000" x "-0451-4000-b000-000000000000"
+
+#define IR_TEMPERATURE_UUID		TI_UUID("aa00")
+#define IR_TEMPERATURE_DATA_UUID	TI_UUID("aa01")
+#define IR_TEMPERATURE_CONFIG_UUID	TI_UUID("aa02")
+#define IR_TEMPERATURE_PERIOD_UUID	TI_UUID("aa03")
+#define ACCELEROMETER_UUID		TI_UUID("aa10")
+#define ACCELEROMETER_DATA_UUID		TI_UUID("aa11")
+#define ACCELEROMETER_CONFIG_UUID	TI_UUID("aa12")
+#define ACCELEROMETER_PERIOD_UUID	TI_UUID("aa13")
+#define HUMIDITY_UUID			TI_UUID("aa20")
+#define HUMIDITY_DATA_UUID		TI_UUID("aa21")
+#define HUMIDITY_CONFIG_UUID		TI_UUID("aa22")
+#define HUMIDITY_PERIOD_UUID		TI_UUID("aa23")
+#define MAGNETOMETER_UUID		TI_UUID("aa30")
+#define MAGNETOMETER_DATA_UUID		TI_UUID("aa31")
+#define MAGNETOMETER_CONFIG_UUID	TI_UUID("aa32")
+#define MAGNETOMETER_PERIOD_UUID	TI_UUID("aa33")
+#define BAROMETER_UUID			TI_UUID("aa40")
+#define BAROMETER_DATA_UUID		TI_UUID("aa41")
+#define BAROMETER_CONFIG_UUID		TI_UUID("aa42")
+#define BAROMETER_CALIB_UUID		TI_UUID("aa43")
+#define BAROMETER_PERIOD_UUID		TI_UUID("aa44")
+#define GYROSCOPE_UUID			TI_UUID("aa50")
+#define GYROSCOPE_DATA_UUID		TI_UUID("aa51")
+#define GYROSCOPE_CONFIG_UUID		TI_UUID("aa52")
+#define GYROSCOPE_PERIOD_UUID		TI_UUID("aa53")
+#define SIMPLE_KEYS_UUID		"0000ffe0-0000-1000-8000-00805f9b34fb"
+#define SIMPLE_KEYS_DATA_UUID		"0000ffe1-0000-1000-8000-00805f9b34fb"
+
+#define SENSOR_DISABLE		0x00
+#define SENSOR_ENABLE		0x01
+#define BAROMETER_CALIBRATE	0x02
+#define GYROSCOPE_ENABLE_XYZ	0x07
+
+#define BAROMETER_CALIB_SIZE	16
+
+/* Sampling period is written in units of 10 ms */
+#define DEFAULT_PERIOD		1000
+#define MIN_PERIOD		100
+#define MAX_PERIOD		2550
+
+struct sensor;
+
+struct sensor_desc {
+	const char *name;
+	const char *uuid;
+	const char *data_uuid;
+	const char *config_uuid;
+	const char *period_uuid;
+	const char *calib_uuid;
+	uint8_t enable;
+	uint16_t data_len;
+	void (*convert) (struct sensor *sensor, const uint8_t *data,
+						DBusMessageIter *dict);
+};
+
+struct sensortag_adapter {
+	struct btd_adapter	*adapter;
+	GSList			*devices;
+	GSList			*watchers;
+};
+
+struct sensortag {
+	struct btd_device		*dev;
+	struct sensortag_adapter	*stadapter;
+	GAttrib				*attrib;
+	guint				attioid;
+	GSList				*sensors;
+};
+
+struct sensor {
+	struct sensortag		*tag;
+	const struct sensor_desc	*desc;
+	struct att_range		range;
+	uint16_t			data_handle;
+	uint16_t			ccc_handle;
+	uint16_t			config_handle;
+	uint16_t			period_handle;
+	uint16_t			calib_handle;
+	guint				notifyid;
+	guint				calibid;
+	gboolean			calibrated;
+	uint16_t			calib[8];
+};
+
+struct watcher {
+	struct sensortag_adapter	*stadapter;
+	guint				id;
+	char				*srv;
+	char				*path;
+	struct btd_watcher_batch	*batch;
+};
+
+static GSList *sensortag_adapters = NULL;
+
+static unsigned int enabled_sensors = ~0u;
+static uint8_t sample_period = DEFAULT_PERIOD / 10;
+
+static void append_xyz(DBusMessageIter *dict, double x, double y, double z)
+{
+	dict_append_entry(dict, "X", DBUS_TYPE_DOUBLE, &x);
+	dict_append_entry(dict, "Y", DBUS_TYPE_DOUBLE, &y);
+	dict_append_entry(dict, "Z", DBUS_TYPE_DOUBLE, &z);
+}
+
+/* TMP006 thermopile conversion from the sensor datasheet */
+static void convert_ir_temperature(struct sensor *sensor,
+				const uint8_t *data, DBusMessageIter *dict)
+{
+	double obj = (int16_t) att_get_u16(data);
+	double amb = (int16_t) att_get_u16(data + 2) / 128.0;
+	double tdie = amb + 273.15;
+	double dt = tdie - 298.15;
+	double vobj = obj * 0.00000015625;
+	double s, vos, fobj, tobj;
+
+	s = 6.4e-14 * (1 + 1.75e-3 * dt - 1.678e-5 * dt * dt);
+	vos = -2.94e-5 - 5.7e-7 * dt + 4.63e-9 * dt * dt;
+	fobj = (vobj - vos) + 13.4 * (vobj - vos) * (vobj - vos);
+	tobj = sqrt(sqrt(tdie * tdie * tdie * tdie + fobj / s)) - 273.15;
+
+	dict_append_entry(dict, "AmbientTemperature", DBUS_TYPE_DOUBLE, &amb);
+	dict_append_entry(dict, "ObjectTemperature", DBUS_TYPE_DOUBLE, &tobj);
+}
+
+static void convert_accelerometer(struct sensor *sensor,
+				const uint8_t *data, DBusMessageIter *dict)
+{
+	/* Default range of +-2 G */
+	append_xyz(dict, (int8_t) data[0] / 64.0, (int8_t) data[1] / 64.0,
+						(int8_t) data[2] / 64.0);
+}
+
+static void convert_humidity(struct sensor *sensor, const uint8_t *data,
+							DBusMessageIter *dict)
+{
+	/* The two low bits of both values are status bits */
+	double temp = -46.85 + 175.72 / 65536 * (att_get_u16(data) & ~0x0003);
+	double hum = -6.0 + 125.0 / 65536 * (att_get_u16(data + 2) & ~0x0003);
+
+	dict_append_entry(dict, "Temperature", DBUS_TYPE_DOUBLE, &temp);
+	dict_append_entry(dict, "Humidity", DBUS_TYPE_DOUBLE, &hum);
+}
+
+static void convert_magnetometer(struct sensor *sensor,
+				const uint8_t *data, DBusMessageIter *dict)
+{
+	double scale = 2000.0 / 65536;
+
+	append_xyz(dict, (int16_t) att_get_u16(data) * scale,
+				(int16_t) att_get_u16(data + 2) * scale,
+				(int16_t) att_get_u16(data + 4) * scale);
+}
+
+/* T5400 compensation, using the coefficients read at enable time */
+static void convert_barometer(struct sensor *sensor, const uint8_t *data,
+							DBusMessageIter *dict)
+{
+	const uint16_t *c = sensor->calib;
+	double tr = (int16_t) att_get_u16(data);
+	double pr = att_get_u16(data + 2);
+	double temp, sens, offset, pressure;
+
+	temp = (c[0] * tr / 256 + c[1] * 64.0) / 65536;
+
+	sens = c[2] + c[3] * tr / 131072 +
+			((int16_t) c[4] * tr / 32768) * tr / 524288;
+	offset = (int16_t) c[5] * 16384.0 + (int16_t) c[6] * tr / 8 +
+			((int16_t) c[7] * tr / 32768) * tr / 16;
+	pressure = (sens * pr + offset) / 16384 / 100;
+
+	dict_append_entry(dict, "Temperature", DBUS_TYPE_DOUBLE, &temp);
+	dict_append_entry(dict, "Pressure", DBUS_TYPE_DOUBLE, &pressure);
+}
+
+static void convert_gyroscope(struct sensor *sensor, const uint8_t *data,
+							DBusMessageIter *dict)
+{
+	double scale = 500.0 / 65536;
+
+	append_xyz(dict, (int16_t) att_get_u16(data) * scale,
+				(int16_t) att_get_u16(data + 2) * scale,
+				(int16_t) att_get_u16(data + 4) * scale);
+}
+
+static void convert_keys(struct sensor *sensor, const uint8_t *data,
+							DBusMessageIter *dict)
+{
+	dbus_bool_t right = !!(data[0] & 0x01);
+	dbus_bool_t left = !!(data[0] & 0x02);
+
+	dict_append_entry(dict, "Left", DBUS_TYPE_BOOLEAN, &left);
+	dict_append_entry(dict, "Right", DBUS_TYPE_BOOLEAN, &right);
+}
+
+static const struct sensor_desc sensor_descs[] = {
+	{ "temperature", IR_TEMPERATURE_UUID, IR_TEMPERATURE_DATA_UUID,
+		IR_TEMPERATURE_CONFIG_UUID, IR_TEMPERATURE_PERIOD_UUID, NULL,
+		SENSOR_ENABLE, 4, convert_ir_temperature },
+	{ "accelerometer", ACCELEROMETER_UUID, ACCELEROMETER_DATA_UUID,
+		ACCELEROMETER_CONFIG_UUID, ACCELEROMETER_PERIOD_UUID, NULL,
+		SENSOR_ENABLE, 3, convert_accelerometer },
+	{ "humidity", HUMIDITY_UUID, HUMIDITY_DATA_UUID,
+		HUMIDITY_CONFIG_UUID, HUMIDITY_PERIOD_UUID, NULL,
+		SENSOR_ENABLE, 4, convert_humidity },
+	{ "magnetometer", MAGNETOMETER_UUID, MAGNETOMETER_DATA_UUID,
+		MAGNETOMETER_CONFIG_UUID, MAGNETOMETER_PERIOD_UUID, NULL,
+		SENSOR_ENABLE, 6, convert_magnetometer },
+	{ "barometer", BAROMETER_UUID, BAROMETER_DATA_UUID,
+		BAROMETER_CONFIG_UUID, BAROMETER_PERIOD_UUID,
+		BAROMETER_CALIB_UUID, SENSOR_ENABLE, 4, convert_barometer },
+	{ "gyroscope", GYROSCOPE_UUID, GYROSCOPE_DATA_UUID,
+		GYROSCOPE_CONFIG_UUID, GYROSCOPE_PERIOD_UUID, NULL,
+		GYROSCOPE_ENABLE_XYZ, 6, convert_gyroscope },
+	{ "keys", SIMPLE_KEYS_UUID, SIMPLE_KEYS_DATA_UUID, NULL, NULL, NULL,
+		0, 1, convert_keys },
+};
+
+static int cmp_adapter(gconstpointer a, gconstpointer b)
+{
+	const struct sensortag_adapter *stadapter = a;
+	const struct btd_adapter *adapter = b;
+
+	if (adapter == stadapter->adapter)
+		return 0;
+
+	return -1;
+}
+
+static int cmp_device(gconstpointer a, gconstpointer b)
+{
+	const struct sensortag *tag = a;
+	const struct btd_device *dev = b;
+
+	if (dev == tag->dev)
+		return 0;
+
+	return -1;
+}
+
+static int cmp_watcher(gconstpointer a, gconstpointer b)
+{
+	const struct watcher *watcher = a;
+	const struct watcher *match = b;
+	int ret;
+
+	ret = g_strcmp0(watcher->srv, match->srv);
+	if (ret != 0)
+		return ret;
+
+	return g_strcmp0(watcher->path, match->path);
+}
+
+static struct sensortag_adapter *
+find_sensortag_adapter(struct btd_adapter *adapter)
+{
+	GSList *l = g_slist_find_custom(sensortag_adapters, adapter,
+								cmp_adapter);
+	if (!l)
+		return NULL;
+
+	return l->data;
+}
+
+static void destroy_watcher(gpointer user_data)
+{
+	struct watcher *watcher = user_data;
+
+	btd_watcher_batch_free(watcher->batch);
+	g_free(watcher->path);
+	g_free(watcher->srv);
+	g_free(watcher);
+}
+
+static struct watcher *find_watcher(GSList *list, const char *sender,
+							const char *path)
+{
+	struct watcher match;
+	GSList *l;
+
+	match.srv = (char *) sender;
+	match.path = (char *) path;
+
+	l = g_slist_find_custom(list, &match, cmp_watcher);
+	if (l != NULL)
+		return l->data;
+
+	return NULL;
+}
+
+static void sensor_detach(gpointer data, gpointer user_data)
+{
+	struct sensor *sensor = data;
+	struct sensortag *tag = sensor->tag;
+
+	if (tag->attrib == NULL)
+		return;
+
+	if (sensor->notifyid > 0) {
+		g_attrib_unregister(tag->attrib, sensor->notifyid);
+		sensor->notifyid = 0;
+	}
+
+	if (sensor->calibid > 0) {
+		g_attrib_cancel(tag->attrib, sensor->calibid);
+		sensor->calibid = 0;
+	}
+
+	sensor->data_handle = 0;
+	sensor->ccc_handle = 0;
+	sensor->config_handle = 0;
+	sensor->period_handle = 0;
+	sensor->calib_handle = 0;
+}
+
+static void destroy_sensortag(gpointer user_data)
+{
+	struct sensortag *tag = user_data;
+
+	if (tag->attioid > 0)
+		btd_device_remove_attio_callback(tag->dev, tag->attioid);
+
+	g_slist_foreach(tag->sensors, sensor_detach, NULL);
+	g_slist_free_full(tag->sensors, g_free);
+
+	if (tag->attrib != NULL)
+		g_attrib_unref(tag->attrib);
+
+	btd_device_unref(tag->dev);
+	g_free(tag);
+}
+
+static void remove_watcher(gpointer user_data)
+{
+	struct watcher *watcher = user_data;
+
+	g_dbus_remove_watch(btd_get_dbus_connection(), watcher->id);
+}
+
+static void destroy_sensortag_adapter(gpointer user_data)
+{
+	struct sensortag_adapter *stadapter = user_data;
+
+	g_slist_free_full(stadapter->watchers, remove_watcher);
+
+	g_free(stadapter);
+}
+
+static void char_write_cb(guint8 status, const guint8 *pdu, guint16 len,
+							gpointer user_data)
+{
+	char *msg = user_data;
+
+	if (status != 0)
+		error("%s failed: %s", msg, att_ecode2str(status));
+
+	g_free(msg);
+}
+
+static void write_u8(struct sensor *sensor, uint16_t handle, uint8_t value,
+							const char *what)
+{
+	char *msg;
+
+	if (!handle)
+		return;
+
+	msg = g_strdup_printf("%s %s", what, sensor->desc->name);
+	gatt_write_char(sensor->tag->attrib, handle, &value, sizeof(value),
+							char_write_cb, msg);
+}
+
+static void write_ccc(struct sensor *sensor, uint16_t value)
+{
+	uint8_t attr_val[2];
+	char *msg;
+
+	att_put_u16(value, attr_val);
+
+	msg = g_strdup_printf("%s %s notifications",
+				value ? "Enable" : "Disable",
+				sensor->desc->name);
+	gatt_write_char(sensor->tag->attrib, sensor->ccc_handle, attr_val,
+					sizeof(attr_val), char_write_cb, msg);
+}
+
+static void read_calib_cb(guint8 status, const guint8 *pdu, guint16 len,
+							gpointer user_data)
+{
+	struct sensor *sensor = user_data;
+	uint8_t value[BAROMETER_CALIB_SIZE];
+	ssize_t vlen;
+	int i;
+
+	sensor->calibid = 0;
+
+	if (status != 0) {
+		error("Read %s calibration failed: %s", sensor->desc->name,
+							att_ecode2str(status));
+		return;
+	}
+
+	vlen = dec_read_resp(pdu, len, value, sizeof(value));
+	if (vlen != sizeof(value)) {
+		error("Invalid length for %s calibration", sensor->desc->name);
+		return;
+	}
+
+	for (i = 0; i < 8; i++)
+		sensor->calib[i] = att_get_u16(&value[i * 2]);
+
+	sensor->calibrated = TRUE;
+}
+
+static bool sensor_ready(struct sensor *sensor)
+{
+	return sensor->tag->attrib != NULL && sensor->ccc_handle != 0;
+}
+
+static void enable_sensor(gpointer data, gpointer user_data)
+{
+	struct sensor *sensor = data;
+
+	if (!sensor_ready(sensor))
+		return;
+
+	/*
+	 * All writes are queued on the same bearer and go out in order, so
+	 * the calibration read completes before the first notification.
+	 */
+	if (sensor->calib_handle && !sensor->calibrated) {
+		write_u8(sensor, sensor->config_handle, BAROMETER_CALIBRATE,
+							"Calibrate");
+		sensor->calibid = gatt_read_char(sensor->tag->attrib,
+						sensor->calib_handle,
+						read_calib_cb, sensor);
+	}
+
+	write_u8(sensor, sensor->period_handle, sample_period, "Set period of");
+	write_u8(sensor, sensor->config_handle, sensor->desc->enable,
+							"Enable");
+	write_ccc(sensor, GATT_CLIENT_CHARAC_CFG_NOTIF_BIT);
+}
+
+static void disable_sensor(gpointer data, gpointer user_data)
+{
+	struct sensor *sensor = data;
+
+	if (!sensor_ready(sensor))
+		return;
+
+	write_ccc(sensor, 0x0000);
+	write_u8(sensor, sensor->config_handle, SENSOR_DISABLE, "Disable");
+}
+
+static void enable_sensortag(gpointer data, gpointer user_data)
+{
+	struct sensortag *tag = data;
+
+	g_slist_foreach(tag->sensors, enable_sensor, NULL);
+}
+
+static void disable_sensortag(gpointer data, gpointer user_data)
+{
+	struct sensortag *tag = data;
+
+	g_slist_foreach(tag->sensors, disable_sensor, NULL);
+}
+
+struct measurement {
+	struct sensor	*sensor;
+	const uint8_t	*data;
+};
+
+static void append_measurement(DBusMessageIter *dict, struct measurement *m)
+{
+	struct sensor *sensor = m->sensor;
+	const char *name = sensor->desc->name;
+
+	dict_append_entry(dict, "Sensor", DBUS_TYPE_STRING, &name);
+
+	sensor->desc->convert(sensor, m->data, dict);
+}
+
+static void update_watcher(gpointer data, gpointer user_data)
+{
+	struct watcher *w = data;
+	struct measurement *m = user_data;
+	const char *path = device_get_path(m->sensor->tag->dev);
+	DBusMessageIter iter;
+	DBusMessageIter dict, *batch_dict;
+	DBusMessage *msg;
+
+	if (w->batch) {
+		batch_dict = btd_watcher_batch_append(w->batch, path);
+		if (batch_dict == NULL)
+			return;
+
+		append_measurement(batch_dict, m);
+		btd_watcher_batch_commit(w->batch);
+		return;
+	}
+
+	msg = dbus_message_new_method_call(w->srv, w->path,
+			SENSORTAG_WATCHER_INTERFACE, "MeasurementReceived");
+	if (msg == NULL)
+		return;
+
+	dbus_message_iter_init_append(msg, &iter);
+
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_OBJECT_PATH, &path);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
+
+	append_measurement(&dict, m);
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	dbus_message_set_no_reply(msg, TRUE);
+	g_dbus_send_message(btd_get_dbus_connection(), msg);
+}
+
+static void notify_handler(const uint8_t *pdu, uint16_t len, gpointer user_data)
+{
+	struct sensor *sensor = user_data;
+	struct measurement m;
+
+	/* should be at least opcode (1b) + handle (2b) + sensor data */
+	if (len < 3 + sensor->desc->data_len) {
+		error("Invalid %s PDU received", sensor->desc->name);
+		return;
+	}
+
+	/* Raw values mean nothing until the coefficients are known */
+	if (sensor->desc->calib_uuid != NULL && !sensor->calibrated)
+		return;
+
+	m.sensor = sensor;
+	m.data = pdu + 3;
+
+	g_slist_foreach(sensor->tag->stadapter->watchers, update_watcher, &m);
+}
+
+static void discover_ccc_cb(guint8 status, const guint8 *pdu,
+						guint16 len, gpointer user_data)
+{
+	struct sensor *sensor = user_data;
+	struct att_data_list *list;
+	uint8_t format;
+	int i;
+
+	if (status != 0) {
+		error("Discover %s descriptors failed: %s", sensor->desc->name,
+							att_ecode2str(status));
+		return;
+	}
+
+	list = dec_find_info_resp(pdu, len, &format);
+	if (list == NULL)
+		return;
+
+	if (format != ATT_FIND_INFO_RESP_FMT_16BIT)
+		goto done;
+
+	for (i = 0; i < list->num; i++) {
+		uint8_t *value = list->data[i];
+
+		if (att_get_u16(value + 2) != GATT_CLIENT_CHARAC_CFG_UUID)
+			continue;
+
+		sensor->ccc_handle = att_get_u16(value);
+
+		if (sensor->tag->stadapter->watchers != NULL)
+			enable_sensor(sensor, NULL);
+
+		break;
+	}
+
+done:
+	att_data_list_free(list);
+}
+
+static void discover_char_cb(GSList *chars, guint8 status, gpointer user_data)
+{
+	struct sensor *sensor = user_data;
+	const struct sensor_desc *desc = sensor->desc;
+	uint16_t end = 0;
+
+	if (status) {
+		error("Discover %s characteristics failed: %s", desc->name,
+							att_ecode2str(status));
+		return;
+	}
+
+	for (; chars; chars = chars->next) {
+		struct gatt_char *c = chars->data;
+
+		if (g_strcmp0(c->uuid, desc->data_uuid) == 0) {
+			struct gatt_char *c_next =
+				(chars->next ? chars->next->data : NULL);
+
+			sensor->data_handle = c->value_handle;
+			end = c_next ? c_next->handle - 1 : sensor->range.end;
+		} else if (g_strcmp0(c->uuid, desc->config_uuid) == 0) {
+			sensor->config_handle = c->value_handle;
+		} else if (g_strcmp0(c->uuid, desc->period_uuid) == 0) {
+			sensor->period_handle = c->value_handle;
+		} else if (g_strcmp0(c->uuid, desc->calib_uuid) == 0) {
+			sensor->calib_handle = c->value_handle;
+		}
+	}
+
+	if (!sensor->data_handle || end <= sensor->data_handle) {
+		DBG("No %s data notifications", desc->name);
+		return;
+	}
+
+	sensor->notifyid = g_attrib_register(sensor->tag->attrib,
+						ATT_OP_HANDLE_NOTIFY,
+						sensor->data_handle,
+						notify_handler, sensor, NULL);
+
+	gatt_discover_char_desc(sensor->tag->attrib, sensor->data_handle + 1,
+					end, discover_ccc_cb, sensor);
+}
+
+static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
+{
+	struct sensortag *tag = user_data;
+	GSList *l;
+
+	DBG("");
+
+	tag->attrib = g_attrib_ref(attrib);
+
+	for (l = tag->sensors; l; l = l->next) {
+		struct sensor *sensor = l->data;
+
+		gatt_discover_char(tag->attrib, sensor->range.start,
+					sensor->range.end, NULL,
+					discover_char_cb, sensor);
+	}
+}
+
+static void attio_disconnected_cb(gpointer user_data)
+{
+	struct sensortag *tag = user_data;
+
+	DBG("");
+
+	g_slist_foreach(tag->sensors, sensor_detach, NULL);
+
+	g_attrib_unref(tag->attrib);
+	tag->attrib = NULL;
+}
+
+static void watcher_exit_cb(DBusConnection *conn, void *user_data)
+{
+	struct watcher *watcher = user_data;
+	struct sensortag_adapter *stadapter = watcher->stadapter;
+
+	DBG("sensortag watcher [%s] disconnected", watcher->path);
+
+	btd_watcher_batch_discard(watcher->batch);
+
+	stadapter->watchers = g_slist_remove(stadapter->watchers, watcher);
+	g_dbus_remove_watch(conn, watcher->id);
+
+	if (stadapter->watchers == NULL)
+		g_slist_foreach(stadapter->devices, disable_sensortag, NULL);
+}
+
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+				struct sensortag_adapter *stadapter,
+				gboolean batched)
+{
+	struct watcher *watcher;
+	struct btd_watcher_batch *batch = NULL;
+	const char *sender = dbus_message_get_sender(msg);
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+							DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	watcher = find_watcher(stadapter->watchers, sender, path);
+	if (watcher != NULL)
+		return btd_error_already_exists(msg);
+
+	if (batched) {
+		batch = btd_watcher_batch_new(msg,
+						SENSORTAG_WATCHER_INTERFACE);
+		if (batch == NULL)
+			return btd_error_invalid_args(msg);
+	}
+
+	watcher = g_new0(struct watcher, 1);
+	watcher->stadapter = stadapter;
+	watcher->batch = batch;
+	watcher->id = g_dbus_add_disconnect_watch(conn, sender, watcher_exit_cb,
+						watcher, destroy_watcher);
+	watcher->srv = g_strdup(sender);
+	watcher->path = g_strdup(path);
+
+	if (stadapter->watchers == NULL)
+		g_slist_foreach(stadapter->devices, enable_sensortag, NULL);
+
+	stadapter->watchers = g_slist_prepend(stadapter->watchers, watcher);
+
+	DBG("sensortag watcher [%s] registered", path);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	return add_watcher(conn, msg, data, FALSE);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	return add_watcher(conn, msg, data, TRUE);
+}
+
+static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	struct sensortag_adapter *stadapter = data;
+	struct watcher *watcher;
+	const char *sender = dbus_message_get_sender(msg);
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+							DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	watcher = find_watcher(stadapter->watchers, sender, path);
+	if (watcher == NULL)
+		return btd_error_does_not_exist(msg);
+
+	stadapter->watchers = g_slist_remove(stadapter->watchers, watcher);
+	g_dbus_remove_watch(conn, watcher->id);
+
+	if (stadapter->watchers == NULL)
+		g_slist_foreach(stadapter->devices, disable_sensortag, NULL);
+
+	DBG("sensortag watcher [%s] unregistered", path);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static const GDBusMethodTable sensortag_manager_methods[] = {
+	{ GDBUS_METHOD("RegisterWatcher",
+			GDBUS_ARGS({ "agent", "o" }), NULL,
+			register_watcher) },
+	{ GDBUS_METHOD("UnregisterWatcher",
+			GDBUS_ARGS({ "agent", "o" }), NULL,
+			unregister_watcher) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "options", "a{sv}" }),
+			NULL, register_batch_watcher) },
+	{ }
+};
+
+static int sensortag_adapter_probe(struct btd_profile *p,
+						struct btd_adapter *adapter)
+{
+	struct sensortag_adapter *stadapter;
+
+	stadapter = g_new0(struct sensortag_adapter, 1);
+	stadapter->adapter = adapter;
+
+	if (!g_dbus_register_interface(btd_get_dbus_connection(),
+						adapter_get_path(adapter),
+						SENSORTAG_MANAGER_INTERFACE,
+						sensortag_manager_methods,
+						NULL, NULL, stadapter,
+						destroy_sensortag_adapter)) {
+		error("D-Bus failed to register %s interface",
+						SENSORTAG_MANAGER_INTERFACE);
+		destroy_sensortag_adapter(stadapter);
+		return -EIO;
+	}
+
+	sensortag_adapters = g_slist_prepend(sensortag_adapters, stadapter);
+
+	return 0;
+}
+
+static void sensortag_adapter_remove(struct btd_profile *p,
+						struct btd_adapter *adapter)
+{
+	struct sensortag_adapter *stadapter;
+
+	stadapter = find_sensortag_adapter(adapter);
+	if (stadapter == NULL)
+		return;
+
+	sensortag_adapters = g_slist_remove(sensortag_adapters, stadapter);
+
+	g_dbus_unregister_interface(btd_get_dbus_connection(),
+					adapter_get_path(stadapter->adapter),
+					SENSORTAG_MANAGER_INTERFACE);
+}
+
+static int sensortag_device_probe(struct btd_service *service)
+{
+	struct btd_device *device = btd_service_get_device(service);
+	struct sensortag_adapter *stadapter;
+	struct sensortag *tag;
+	unsigned int i;
+
+	stadapter = find_sensortag_adapter(device_get_adapter(device));
+	if (stadapter == NULL)
+		return -1;
+
+	tag = g_new0(struct sensortag, 1);
+	tag->dev = btd_device_ref(device);
+	tag->stadapter = stadapter;
+
+	for (i = 0; i < G_N_ELEMENTS(sensor_descs); i++) {
+		struct gatt_primary *prim;
+		struct sensor *sensor;
+
+		if (!(enabled_sensors & (1 << i)))
+			continue;
+
+		prim = btd_device_get_primary(device, sensor_descs[i].uuid);
+		if (prim == NULL)
+			continue;
+
+		sensor = g_new0(struct sensor, 1);
+		sensor->tag = tag;
+		sensor->desc = &sensor_descs[i];
+		sensor->range = prim->range;
+
+		tag->sensors = g_slist_append(tag->sensors, sensor);
+	}
+
+	if (tag->sensors == NULL) {
+		DBG("No configured sensors on %s", device_get_path(device));
+		destroy_sensortag(tag);
+		return -ENOENT;
+	}
+
+	stadapter->devices = g_slist_prepend(stadapter->devices, tag);
+
+	tag->attioid = btd_device_add_attio_callback(device, attio_connected_cb,
+						attio_disconnected_cb, tag);
+
+	return 0;
+}
+
+static void sensortag_device_remove(struct btd_service *service)
+{
+	struct btd_device *device = btd_service_get_device(service);
+	struct sensortag_adapter *stadapter;
+	GSList *l;
+
+	stadapter = find_sensortag_adapter(device_get_adapter(device));
+	if (stadapter == NULL)
+		return;
+
+	l = g_slist_find_custom(stadapter->devices, device, cmp_device);
+	if (l == NULL)
+		return;
+
+	stadapter->devices = g_slist_remove(stadapter->devices, l->data);
+
+	destroy_sensortag(l->data);
+}
+
+static struct btd_profile sensortag_profile = {
+	.name		= "SensorTag GATT Driver",
+	.remote_uuid	= IR_TEMPERATURE_UUID,
+
+	.device_probe	= sensortag_device_probe,
+	.device_remove	= sensortag_device_remove,
+
+	.adapter_probe	= sensortag_adapter_probe,
+	.adapter_remove	= sensortag_adapter_remove,
+};
+
+static GKeyFile *load_config_file(const char *file)
+{
+	GKeyFile *keyfile;
+	GError *err = NULL;
+
+	keyfile = g_key_file_new();
+
+	if (!g_key_file_load_from_file(keyfile, file, 0, &err)) {
+		if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			error("Parsing %s failed: %s", file, err->message);
+		g_error_free(err);
+		g_key_file_free(keyfile);
+		return NULL;
+	}
+
+	return keyfile;
+}
+
+static void parse_config(GKeyFile *config)
+{
+	GError *err = NULL;
+	char **sensors;
+	int period;
+	unsigned int i, j;
+
+	sensors = g_key_file_get_string_list(config, "General", "Sensors",
+								NULL, &err);
+	if (err) {
+		DBG("sensortag.conf: %s", err->message);
+		g_clear_error(&err);
+	} else {
+		enabled_sensors = 0;
+
+		for (i = 0; sensors[i] != NULL; i++) {
+			for (j = 0; j < G_N_ELEMENTS(sensor_descs); j++) {
+				if (g_strcmp0(sensors[i],
+						sensor_descs[j].name) == 0)
+					break;
+			}
+
+			if (j == G_N_ELEMENTS(sensor_descs)) {
+				error("Unknown sensor %s", sensors[i]);
+				continue;
+			}
+
+			enabled_sensors |= 1 << j;
+		}
+
+		g_strfreev(sensors);
+	}
+
+	period = g_key_file_get_integer(config, "General", "Period", &err);
+	if (err) {
+		DBG("sensortag.conf: %s", err->message);
+		g_clear_error(&err);
+	} else if (period < MIN_PERIOD || period > MAX_PERIOD) {
+		error("Invalid sampling period %d ms", period);
+	} else {
+		sample_period = period / 10;
+	}
+}
+
+static int sensortag_init(void)
+{
+	GKeyFile *config;
+
+	config = load_config_file(CONFIGDIR "/sensortag.conf");
+	if (config) {
+		parse_config(config);
+		g_key_file_free(config);
+	}
+
+	return btd_profile_register(&sensortag_profile);
+}
+
+static void sensortag_exit(void)
+{
+	btd_profile_unregister(&sensortag_profile);
+}
+
+BLUETOOTH_PLUGIN_DEFINE(sensortag, VERSION, BLUETOOTH_PLUGIN_PRIORITY_DEFAULT,
+					sensortag_init, sensortag_exit)
@@ -40,6 +40,7 @@
 #include "log.h"
 #include "attrib/gattrib.h"
 #include "attio.h"
+#include "watcher-batch.h"
 #include "attrib/att.h"
 #include "attrib/gatt.h"
 
@@ -100,6 +101,7 @@ struct watcher {
 	guint				id;
 	char				*srv;
 	char				*path;
+	struct btd_watcher_batch	*batch;
 };
 
 struct measurement {
@@ -146,6 +148,7 @@ static void destroy_watcher(gpointer user_data)
 {
 	struct watcher *watcher = user_data;
 
+	btd_watcher_batch_free(watcher->batch);
 	g_free(watcher->path);
 	g_free(watcher->srv);
 	g_free(watcher);
@@ -273,15 +276,38 @@ static void change_property(struct thermometer *t, const char *name,
 						THERMOMETER_INTERFACE, name);
 }
 
+static void append_measurement(DBusMessageIter *dict, struct measurement *m)
+{
+	dict_append_entry(dict, "Exponent", DBUS_TYPE_INT16, &m->exp);
+	dict_append_entry(dict, "Mantissa", DBUS_TYPE_INT32, &m->mant);
+	dict_append_entry(dict, "Unit", DBUS_TYPE_STRING, &m->unit);
+
+	if (m->suptime)
+		dict_append_entry(dict, "Time", DBUS_TYPE_UINT64, &m->time);
+
+	dict_append_entry(dict, "Type", DBUS_TYPE_STRING, &m->type);
+	dict_append_entry(dict, "Measurement", DBUS_TYPE_STRING, &m->value);
+}
+
 static void update_watcher(gpointer data, gpointer user_data)
 {
 	struct watcher *w = data;
 	struct measurement *m = user_data;
 	const char *path = device_get_path(m->t->dev);
 	DBusMessageIter iter;
-	DBusMessageIter dict;
+	DBusMessageIter dict, *batch_dict;
 	DBusMessage *msg;
 
+	if (w->batch) {
+		batch_dict = btd_watcher_batch_append(w->batch, path);
+		if (batch_dict == NULL)
+			return;
+
+		append_measurement(batch_dict, m);
+		btd_watcher_batch_commit(w->batch);
+		return;
+	}
+
 	msg = dbus_message_new_method_call(w->srv, w->path,
 				THERMOMETER_WATCHER_INTERFACE,
 				"MeasurementReceived");
@@ -297,15 +323,7 @@ static void update_watcher(gpointer data, gpointer user_data)
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	dict_append_entry(&dict, "Exponent", DBUS_TYPE_INT16, &m->exp);
-	dict_append_entry(&dict, "Mantissa", DBUS_TYPE_INT32, &m->mant);
-	dict_append_entry(&dict, "Unit", DBUS_TYPE_STRING, &m->unit);
-
-	if (m->suptime)
-		dict_append_entry(&dict, "Time", DBUS_TYPE_UINT64, &m->time);
-
-	dict_append_entry(&dict, "Type", DBUS_TYPE_STRING, &m->type);
-	dict_append_entry(&dict, "Measurement", DBUS_TYPE_STRING, &m->value);
+	append_measurement(&dict, m);
 
 	dbus_message_iter_close_container(&iter, &dict);
 
@@ -867,6 +885,8 @@ static void watcher_exit(DBusConnection *conn, void *user_data)
 
 	DBG("Thermometer watcher %s disconnected", watcher->path);
 
+	btd_watcher_batch_discard(watcher->batch);
+
 	remove_int_watcher(tadapter, watcher);
 
 	tadapter->fwatchers = g_slist_remove(tadapter->fwatchers, watcher);
@@ -896,11 +916,12 @@ static struct watcher *find_watcher(GSList *list, const char *sender,
 	return NULL;
 }
 
-static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
-								void *data)
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+				struct thermometer_adapter *tadapter,
+				gboolean batched)
 {
 	const char *sender = dbus_message_get_sender(msg);
-	struct thermometer_adapter *tadapter = data;
+	struct btd_watcher_batch *batch = NULL;
 	struct watcher *watcher;
 	char *path;
 
@@ -912,9 +933,17 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	if (watcher != NULL)
 		return btd_error_already_exists(msg);
 
+	if (batched) {
+		batch = btd_watcher_batch_new(msg,
+					THERMOMETER_WATCHER_INTERFACE);
+		if (batch == NULL)
+			return btd_error_invalid_args(msg);
+	}
+
 	DBG("Thermometer watcher %s registered", path);
 
 	watcher = g_new0(struct watcher, 1);
+	watcher->batch = batch;
 	watcher->srv = g_strdup(sender);
 	watcher->path = g_strdup(path);
 	watcher->tadapter = tadapter;
@@ -929,6 +958,18 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	return add_watcher(conn, msg, data, FALSE);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	return add_watcher(conn, msg, data, TRUE);
+}
+
 static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
 								void *data)
 {
@@ -1239,6 +1280,9 @@ static const GDBusMethodTable thermometer_manager_methods[] = {
 	{ GDBUS_METHOD("DisableIntermediateMeasurement",
 			GDBUS_ARGS({ "agent", "o" }), NULL,
 			disable_intermediate) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "options", "a{sv}" }),
+			NULL, register_batch_watcher) },
 	{ }
 };
 
@@ -106,18 +106,22 @@ static int encode_current_time(uint8_t value[10])
 	return 0;
 }
 
-static uint8_t current_time_read(struct attribute *a,
-				 struct btd_device *device, gpointer user_data)
+static ssize_t current_time_value(struct attribute *a,
+				struct btd_device *device, uint8_t *buf,
+				size_t len, uint16_t offset, gpointer user_data)
 {
-	struct btd_adapter *adapter = user_data;
 	uint8_t value[10];
 
+	if (offset >= sizeof(value))
+		return -ATT_ECODE_INVALID_OFFSET;
+
 	if (encode_current_time(value) < 0)
-		return ATT_ECODE_IO;
+		return -ATT_ECODE_IO;
 
-	attrib_db_update(adapter, a->handle, NULL, value, sizeof(value), NULL);
+	len = MIN(len, sizeof(value) - offset);
+	memcpy(buf, &value[offset], len);
 
-	return 0;
+	return len;
 }
 
 static uint8_t local_time_info_read(struct attribute *a,
@@ -155,8 +159,8 @@ static gboolean register_current_time_service(struct btd_adapter *adapter)
 				GATT_OPT_CHR_UUID16, CT_TIME_CHR_UUID,
 				GATT_OPT_CHR_PROPS, ATT_CHAR_PROPER_READ |
 							ATT_CHAR_PROPER_NOTIFY,
-				GATT_OPT_CHR_VALUE_CB, ATTRIB_READ,
-						current_time_read, adapter,
+				GATT_OPT_CHR_VALUE_CB, ATTRIB_READ_VALUE,
+						current_time_value, adapter,
 
 				/* Local Time Information characteristic */
 				GATT_OPT_CHR_UUID16, LOCAL_TIME_INFO_CHR_UUID,
@@ -190,6 +190,10 @@ struct btd_adapter {
 	guint pair_device_timeout;
 
 	bool is_default;		/* true if adapter is default one */
+
+	GIOChannel *hci_io;		/* HCI events for conn updates */
+	guint hci_watch;
+	GSList *conn_updates;		/* Pending LE connection updates */
 };
 
 static struct btd_adapter *btd_adapter_lookup(uint16_t index)
@@ -2931,6 +2935,14 @@ static void adapter_free(gpointer user_data)
 	g_queue_foreach(adapter->auths, free_service_auth, NULL);
 	g_queue_free(adapter->auths);
 
+	g_slist_free_full(adapter->conn_updates, g_free);
+
+	if (adapter->hci_watch > 0)
+		g_source_remove(adapter->hci_watch);
+
+	if (adapter->hci_io)
+		g_io_channel_unref(adapter->hci_io);
+
 	/*
 	 * Unregister all handlers for this specific index since
 	 * the adapter bound to them is no longer valid.
@@ -4081,20 +4093,25 @@ static void update_found_devices(struct btd_adapter *adapter,
 					const uint8_t *data, uint8_t data_len)
 {
 	struct btd_device *dev;
+	struct eir_view view;
 	struct eir_data eir_data;
 	char addr[18];
 	GSList *list;
 	bool name_known;
+	int flags;
 
-	memset(&eir_data, 0, sizeof(eir_data));
-	eir_parse(&eir_data, data, data_len);
+	/*
+	 * Many LE reports are for non-discoverable devices that are dropped
+	 * on the flags check below, so only look at the raw data until the
+	 * device is known to be kept.
+	 */
+	eir_view_init(&view, data, data_len);
+	flags = eir_view_get_flags(&view);
 
 	/* Avoid creating LE device if it's not discoverable */
 	if (bdaddr_type != BDADDR_BREDR &&
-			!(eir_data.flags & (EIR_LIM_DISC | EIR_GEN_DISC))) {
-		eir_data_free(&eir_data);
+				!(flags & (EIR_LIM_DISC | EIR_GEN_DISC)))
 		return;
-	}
 
 	ba2str(bdaddr, addr);
 
@@ -4104,10 +4121,8 @@ static void update_found_devices(struct btd_adapter *adapter,
 		 * If no client has requested discovery, then do not
 		 * create new device objects.
 		 */
-		if (!adapter->discovery_list) {
-			eir_data_free(&eir_data);
+		if (!adapter->discovery_list)
 			return;
-		}
 
 		dev = adapter_create_device(adapter, bdaddr, bdaddr_type);
 	} else
@@ -4115,10 +4130,12 @@ static void update_found_devices(struct btd_adapter *adapter,
 
 	if (!dev) {
 		error("Unable to create object for found device %s", addr);
-		eir_data_free(&eir_data);
 		return;
 	}
 
+	memset(&eir_data, 0, sizeof(eir_data));
+	eir_view_parse(&view, &eir_data);
+
 	if (eir_data.name != NULL && eir_data.name_complete)
 		device_store_cached_name(dev, eir_data.name);
 
@@ -4559,6 +4576,271 @@ int btd_adapter_read_clock(struct btd_adapter *adapter, const bdaddr_t *bdaddr,
 	return -ENOSYS;
 }
 
+struct conn_update {
+	uint16_t handle;
+	bool status_pending;
+	btd_adapter_conn_update_cb_t cb;
+	void *user_data;
+};
+
+static void hci_events_close(struct btd_adapter *adapter)
+{
+	if (adapter->hci_watch > 0) {
+		g_source_remove(adapter->hci_watch);
+		adapter->hci_watch = 0;
+	}
+
+	if (adapter->hci_io) {
+		g_io_channel_unref(adapter->hci_io);
+		adapter->hci_io = NULL;
+	}
+}
+
+static struct conn_update *find_conn_update(struct btd_adapter *adapter,
+							uint16_t handle)
+{
+	GSList *l;
+
+	for (l = adapter->conn_updates; l; l = l->next) {
+		struct conn_update *update = l->data;
+
+		if (update->handle == handle)
+			return update;
+	}
+
+	return NULL;
+}
+
+static void conn_update_complete(struct btd_adapter *adapter,
+				struct conn_update *update, uint8_t status,
+				uint16_t interval, uint16_t latency,
+				uint16_t timeout)
+{
+	adapter->conn_updates = g_slist_remove(adapter->conn_updates, update);
+
+	if (update->cb)
+		update->cb(status, interval, latency, timeout,
+							update->user_data);
+
+	g_free(update);
+
+	if (adapter->conn_updates == NULL)
+		hci_events_close(adapter);
+}
+
+static void conn_update_cmd_status(struct btd_adapter *adapter,
+						const evt_cmd_status *evt)
+{
+	GSList *l;
+
+	if (evt->opcode != htobs(cmd_opcode_pack(OGF_LE_CTL,
+							OCF_LE_CONN_UPDATE)))
+		return;
+
+	/* Commands are answered in order, so this is the oldest one */
+	for (l = adapter->conn_updates; l; l = l->next) {
+		struct conn_update *update = l->data;
+
+		if (!update->status_pending)
+			continue;
+
+		update->status_pending = false;
+
+		if (evt->status != 0 || update->cb == NULL)
+			conn_update_complete(adapter, update, evt->status,
+								0, 0, 0);
+		return;
+	}
+}
+
+static gboolean hci_event_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	unsigned char buf[HCI_MAX_EVENT_SIZE];
+	const evt_le_connection_update_complete *up;
+	const evt_disconn_complete *dc;
+	const evt_le_meta_event *meta;
+	const hci_event_hdr *hdr;
+	struct conn_update *update;
+	const void *ptr;
+	ssize_t len;
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		adapter->hci_watch = 0;
+
+		while (adapter->conn_updates)
+			conn_update_complete(adapter,
+						adapter->conn_updates->data,
+						HCI_UNSPECIFIED_ERROR, 0, 0, 0);
+
+		hci_events_close(adapter);
+
+		return FALSE;
+	}
+
+	len = read(g_io_channel_unix_get_fd(io), buf, sizeof(buf));
+	if (len < 1 + HCI_EVENT_HDR_SIZE)
+		return TRUE;
+
+	hdr = (void *) (buf + 1);
+	ptr = buf + 1 + HCI_EVENT_HDR_SIZE;
+	len -= 1 + HCI_EVENT_HDR_SIZE;
+
+	switch (hdr->evt) {
+	case EVT_CMD_STATUS:
+		if (len < EVT_CMD_STATUS_SIZE)
+			break;
+
+		conn_update_cmd_status(adapter, ptr);
+		break;
+	case EVT_LE_META_EVENT:
+		meta = ptr;
+		if (len < 1 + EVT_LE_CONN_UPDATE_COMPLETE_SIZE ||
+			meta->subevent != EVT_LE_CONN_UPDATE_COMPLETE)
+			break;
+
+		up = (void *) meta->data;
+		update = find_conn_update(adapter, btohs(up->handle));
+		if (update == NULL)
+			break;
+
+		conn_update_complete(adapter, update, up->status,
+					btohs(up->interval), btohs(up->latency),
+					btohs(up->supervision_timeout));
+		break;
+	case EVT_DISCONN_COMPLETE:
+		dc = ptr;
+		if (len < EVT_DISCONN_COMPLETE_SIZE || dc->status != 0)
+			break;
+
+		update = find_conn_update(adapter, btohs(dc->handle));
+		if (update == NULL)
+			break;
+
+		conn_update_complete(adapter, update, dc->reason, 0, 0, 0);
+		break;
+	}
+
+	return adapter->hci_watch > 0;
+}
+
+static int hci_events_open(struct btd_adapter *adapter)
+{
+	struct hci_filter flt;
+	int dd;
+
+	if (adapter->hci_io)
+		return 0;
+
+	dd = hci_open_dev(adapter->dev_id);
+	if (dd < 0)
+		return -errno;
+
+	hci_filter_clear(&flt);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &flt);
+	hci_filter_set_event(EVT_CMD_STATUS, &flt);
+	hci_filter_set_event(EVT_LE_META_EVENT, &flt);
+	hci_filter_set_event(EVT_DISCONN_COMPLETE, &flt);
+
+	if (setsockopt(dd, SOL_HCI, HCI_FILTER, &flt, sizeof(flt)) < 0) {
+		int err = -errno;
+
+		hci_close_dev(dd);
+		return err;
+	}
+
+	adapter->hci_io = g_io_channel_unix_new(dd);
+	g_io_channel_set_close_on_unref(adapter->hci_io, TRUE);
+	adapter->hci_watch = g_io_add_watch(adapter->hci_io,
+				G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+				hci_event_cb, adapter);
+
+	return 0;
+}
+
+int btd_adapter_le_conn_update(struct btd_adapter *adapter, uint16_t handle,
+				uint16_t min_interval, uint16_t max_interval,
+				uint16_t latency, uint16_t supervision_timeout,
+				btd_adapter_conn_update_cb_t cb,
+				void *user_data)
+{
+	le_connection_update_cp cp;
+	struct conn_update *update;
+	int err;
+
+	if (!(adapter->current_settings & MGMT_SETTING_POWERED))
+		return -EINVAL;
+
+	if (find_conn_update(adapter, handle))
+		return -EBUSY;
+
+	DBG("hci%u handle %u interval 0x%4.4x-0x%4.4x latency %u to 0x%4.4x",
+				adapter->dev_id, handle, min_interval,
+				max_interval, latency, supervision_timeout);
+
+	/*
+	 * The result only arrives with the LE Connection Update Complete
+	 * event several connection events later, so listen for it rather
+	 * than blocking the mainloop.
+	 */
+	err = hci_events_open(adapter);
+	if (err < 0)
+		return err;
+
+	memset(&cp, 0, sizeof(cp));
+	cp.handle = htobs(handle);
+	cp.min_interval = htobs(min_interval);
+	cp.max_interval = htobs(max_interval);
+	cp.latency = htobs(latency);
+	cp.supervision_timeout = htobs(supervision_timeout);
+	cp.min_ce_length = htobs(0x0001);
+	cp.max_ce_length = htobs(0x0001);
+
+	if (hci_send_cmd(g_io_channel_unix_get_fd(adapter->hci_io),
+				OGF_LE_CTL, OCF_LE_CONN_UPDATE,
+				LE_CONN_UPDATE_CP_SIZE, &cp) < 0) {
+		err = -errno;
+
+		if (adapter->conn_updates == NULL)
+			hci_events_close(adapter);
+
+		return err;
+	}
+
+	update = g_new0(struct conn_update, 1);
+	update->handle = handle;
+	update->status_pending = true;
+	update->cb = cb;
+	update->user_data = user_data;
+
+	adapter->conn_updates = g_slist_append(adapter->conn_updates, update);
+
+	return 0;
+}
+
+void btd_adapter_le_conn_update_cancel(struct btd_adapter *adapter,
+							uint16_t handle)
+{
+	struct conn_update *update;
+
+	update = find_conn_update(adapter, handle);
+	if (update == NULL)
+		return;
+
+	/* Keep a placeholder so the Command Status still pairs up */
+	if (update->status_pending) {
+		update->cb = NULL;
+		return;
+	}
+
+	adapter->conn_updates = g_slist_remove(adapter->conn_updates, update);
+	g_free(update);
+
+	if (adapter->conn_updates == NULL)
+		hci_events_close(adapter);
+}
+
 int btd_adapter_remove_bonding(struct btd_adapter *adapter,
 				const bdaddr_t *bdaddr, uint8_t bdaddr_type)
 {
@@ -154,6 +154,19 @@ int btd_adapter_read_clock(struct btd_adapter *adapter, const bdaddr_t *bdaddr,
 				int which, int timeout, uint32_t *clock,
 				uint16_t *accuracy);
 
+typedef void (*btd_adapter_conn_update_cb_t) (uint8_t status,
+					uint16_t interval, uint16_t latency,
+					uint16_t supervision_timeout,
+					void *user_data);
+
+int btd_adapter_le_conn_update(struct btd_adapter *adapter, uint16_t handle,
+				uint16_t min_interval, uint16_t max_interval,
+				uint16_t latency, uint16_t supervision_timeout,
+				btd_adapter_conn_update_cb_t cb,
+				void *user_data);
+void btd_adapter_le_conn_update_cancel(struct btd_adapter *adapter,
+							uint16_t handle);
+
 int btd_adapter_block_address(struct btd_adapter *adapter,
 				const bdaddr_t *bdaddr, uint8_t bdaddr_type);
 int btd_adapter_unblock_address(struct btd_adapter *adapter,
@@ -0,0 +1,482 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include <gdbus/gdbus.h>
+
+#include "lib/uuid.h"
+#include "log.h"
+#include "error.h"
+#include "dbus-common.h"
+#include "adapter.h"
+#include "device.h"
+#include "attrib/att.h"
+#include "attrib/gattrib.h"
+#include "attio.h"
+#include "attrib-proxy.h"
+
+/*
+ * External clients get one end of a SOCK_SEQPACKET socketpair that carries
+ * raw ATT PDUs, one per packet. Requests are queued on the GAttrib the
+ * daemon already holds for the link, so they are serialized together with
+ * those of the internal profiles, and notifications and indications are
+ * copied to every proxy. Clients confirm indications themselves, GAttrib
+ * only passes on the first confirmation for each indication.
+ */
+struct attrib_proxy {
+	struct btd_device *device;
+	DBusMessage *msg;
+	char *owner;
+	guint owner_watch;
+	guint attio_id;
+	guint destroy_id;
+	GAttrib *attrib;
+	GIOChannel *io;
+	guint io_watch;
+	uint8_t *buf;
+	size_t buflen;
+	guint notify_id;
+	guint ind_id;
+	GSList *requests;
+};
+
+struct proxy_request {
+	struct attrib_proxy *proxy;
+	guint id;
+	uint8_t opcode;
+	uint16_t handle;
+};
+
+static GSList *proxies = NULL;
+
+static void proxy_write(struct attrib_proxy *proxy, const uint8_t *pdu,
+								size_t len)
+{
+	int fd;
+
+	if (!proxy->io)
+		return;
+
+	fd = g_io_channel_unix_get_fd(proxy->io);
+
+	if (send(fd, pdu, len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		DBG("Unable to forward PDU 0x%02x: %s (%d)", pdu[0],
+						strerror(errno), errno);
+}
+
+static void proxy_error(struct attrib_proxy *proxy, uint8_t opcode,
+					uint16_t handle, uint8_t ecode)
+{
+	uint8_t pdu[5];
+	uint16_t len;
+
+	len = enc_error_resp(opcode, handle, ecode, pdu, sizeof(pdu));
+	if (len > 0)
+		proxy_write(proxy, pdu, len);
+}
+
+static void request_result(guint8 status, const guint8 *pdu, guint16 len,
+							gpointer user_data)
+{
+	struct proxy_request *req = user_data;
+
+	if (!req->proxy)
+		return;
+
+	if (status == 0) {
+		proxy_write(req->proxy, pdu, len);
+		return;
+	}
+
+	/* Errors from the remote are forwarded as they are */
+	if (pdu && len >= 5 && pdu[0] == ATT_OP_ERROR) {
+		proxy_write(req->proxy, pdu, len);
+		return;
+	}
+
+	/* Local failures (timeout, abort) have no valid error code */
+	proxy_error(req->proxy, req->opcode, req->handle, ATT_ECODE_UNLIKELY);
+}
+
+static void request_destroy(gpointer user_data)
+{
+	struct proxy_request *req = user_data;
+
+	if (req->proxy)
+		req->proxy->requests = g_slist_remove(req->proxy->requests,
+									req);
+
+	g_free(req);
+}
+
+static bool opcode_is_request(uint8_t opcode)
+{
+	switch (opcode) {
+	case ATT_OP_MTU_REQ:
+	case ATT_OP_FIND_INFO_REQ:
+	case ATT_OP_FIND_BY_TYPE_REQ:
+	case ATT_OP_READ_BY_TYPE_REQ:
+	case ATT_OP_READ_REQ:
+	case ATT_OP_READ_BLOB_REQ:
+	case ATT_OP_READ_MULTI_REQ:
+	case ATT_OP_READ_BY_GROUP_REQ:
+	case ATT_OP_WRITE_REQ:
+	case ATT_OP_PREP_WRITE_REQ:
+	case ATT_OP_EXEC_WRITE_REQ:
+		return true;
+	}
+
+	return false;
+}
+
+static void proxy_send(struct attrib_proxy *proxy, const uint8_t *pdu,
+								size_t len)
+{
+	struct proxy_request *req;
+	uint8_t opcode = pdu[0];
+	uint16_t handle = 0;
+
+	switch (opcode) {
+	case ATT_OP_MTU_REQ:
+		/*
+		 * The MTU belongs to the bearer shared with the internal
+		 * profiles, so clients have to stay on the default one.
+		 */
+		proxy_error(proxy, opcode, 0, ATT_ECODE_REQ_NOT_SUPP);
+		return;
+	case ATT_OP_HANDLE_CNF:
+		g_attrib_send(proxy->attrib, 0, pdu, len, NULL, NULL, NULL);
+		return;
+	case ATT_OP_WRITE_CMD:
+	case ATT_OP_SIGNED_WRITE_CMD:
+		break;
+	default:
+		if (!opcode_is_request(opcode)) {
+			DBG("Dropping unexpected PDU 0x%02x", opcode);
+			return;
+		}
+		break;
+	}
+
+	if (len >= 3)
+		handle = att_get_u16(&pdu[1]);
+
+	req = g_new0(struct proxy_request, 1);
+	req->proxy = proxy;
+	req->opcode = opcode;
+	req->handle = handle;
+
+	req->id = g_attrib_send(proxy->attrib, 0, pdu, len, request_result,
+						req, request_destroy);
+	if (req->id == 0) {
+		g_free(req);
+		if (opcode_is_request(opcode))
+			proxy_error(proxy, opcode, handle, ATT_ECODE_UNLIKELY);
+		return;
+	}
+
+	proxy->requests = g_slist_prepend(proxy->requests, req);
+}
+
+static void proxy_free(struct attrib_proxy *proxy);
+
+static gboolean client_data(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct attrib_proxy *proxy = user_data;
+	ssize_t len;
+
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL))
+		goto closed;
+
+	len = recv(g_io_channel_unix_get_fd(io), proxy->buf, proxy->buflen,
+								MSG_DONTWAIT);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+		goto closed;
+	}
+
+	if (len == 0)
+		goto closed;
+
+	proxy_send(proxy, proxy->buf, len);
+
+	return TRUE;
+
+closed:
+	DBG("Client closed ATT channel of %s", device_get_path(proxy->device));
+
+	proxy->io_watch = 0;
+	proxy_free(proxy);
+
+	return FALSE;
+}
+
+static void forward_event(const guint8 *pdu, guint16 len, gpointer user_data)
+{
+	struct attrib_proxy *proxy = user_data;
+
+	proxy_write(proxy, pdu, len);
+}
+
+static void proxy_detach(struct attrib_proxy *proxy)
+{
+	GSList *l, *requests = proxy->requests;
+
+	proxy->requests = NULL;
+
+	/*
+	 * A request already on the air is only released once its response
+	 * arrives, so detach it from the proxy instead of freeing it here.
+	 */
+	for (l = requests; l; l = l->next) {
+		struct proxy_request *req = l->data;
+
+		req->proxy = NULL;
+		g_attrib_cancel(proxy->attrib, req->id);
+	}
+
+	g_slist_free(requests);
+
+	if (proxy->io_watch > 0) {
+		g_source_remove(proxy->io_watch);
+		proxy->io_watch = 0;
+	}
+
+	if (proxy->io) {
+		g_io_channel_shutdown(proxy->io, FALSE, NULL);
+		g_io_channel_unref(proxy->io);
+		proxy->io = NULL;
+	}
+
+	if (proxy->attrib) {
+		g_attrib_unregister(proxy->attrib, proxy->notify_id);
+		g_attrib_unregister(proxy->attrib, proxy->ind_id);
+		g_attrib_unref(proxy->attrib);
+		proxy->attrib = NULL;
+	}
+
+	g_free(proxy->buf);
+	proxy->buf = NULL;
+}
+
+static void proxy_free(struct attrib_proxy *proxy)
+{
+	proxies = g_slist_remove(proxies, proxy);
+
+	proxy_detach(proxy);
+
+	if (proxy->destroy_id > 0)
+		g_source_remove(proxy->destroy_id);
+
+	if (proxy->attio_id > 0)
+		btd_device_remove_attio_callback(proxy->device,
+							proxy->attio_id);
+
+	if (proxy->owner_watch > 0)
+		g_dbus_remove_watch(btd_get_dbus_connection(),
+							proxy->owner_watch);
+
+	if (proxy->msg) {
+		DBusMessage *reply;
+
+		reply = btd_error_failed(proxy->msg, "Acquire canceled");
+		g_dbus_send_message(btd_get_dbus_connection(), reply);
+		dbus_message_unref(proxy->msg);
+	}
+
+	g_free(proxy->owner);
+	g_free(proxy);
+}
+
+static gboolean proxy_destroy(gpointer user_data)
+{
+	struct attrib_proxy *proxy = user_data;
+
+	proxy->destroy_id = 0;
+	proxy_free(proxy);
+
+	return FALSE;
+}
+
+static void owner_exit(DBusConnection *conn, void *user_data)
+{
+	struct attrib_proxy *proxy = user_data;
+
+	DBG("%s exited before the ATT channel was ready", proxy->owner);
+
+	proxy->owner_watch = 0;
+
+	dbus_message_unref(proxy->msg);
+	proxy->msg = NULL;
+
+	proxy_free(proxy);
+}
+
+static void attio_connected(GAttrib *attrib, gpointer user_data)
+{
+	struct attrib_proxy *proxy = user_data;
+	DBusMessage *reply;
+	int fds[2];
+
+	if (!proxy->msg)
+		return;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		int err = errno;
+
+		error("socketpair: %s (%d)", strerror(err), err);
+		reply = btd_error_failed(proxy->msg, strerror(err));
+		goto done;
+	}
+
+	proxy->attrib = g_attrib_ref(attrib);
+
+	/*
+	 * Client PDUs can be as large as the MTU of the bearer, but the
+	 * GAttrib buffer is in use by its own traffic, so use another.
+	 */
+	g_attrib_get_buffer(attrib, &proxy->buflen);
+	proxy->buf = g_malloc(proxy->buflen);
+
+	proxy->io = g_io_channel_unix_new(fds[0]);
+	g_io_channel_set_close_on_unref(proxy->io, TRUE);
+	proxy->io_watch = g_io_add_watch(proxy->io,
+				G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL,
+				client_data, proxy);
+
+	proxy->notify_id = g_attrib_register(attrib, ATT_OP_HANDLE_NOTIFY,
+						GATTRIB_ALL_HANDLES,
+						forward_event, proxy, NULL);
+	proxy->ind_id = g_attrib_register(attrib, ATT_OP_HANDLE_IND,
+						GATTRIB_ALL_HANDLES,
+						forward_event, proxy, NULL);
+
+	reply = g_dbus_create_reply(proxy->msg, DBUS_TYPE_UNIX_FD, &fds[1],
+							DBUS_TYPE_INVALID);
+	close(fds[1]);
+
+done:
+	g_dbus_send_message(btd_get_dbus_connection(), reply);
+
+	dbus_message_unref(proxy->msg);
+	proxy->msg = NULL;
+
+	/* From now on the channel itself tracks the client lifetime */
+	g_dbus_remove_watch(btd_get_dbus_connection(), proxy->owner_watch);
+	proxy->owner_watch = 0;
+
+	if (!proxy->io)
+		proxy->destroy_id = g_idle_add(proxy_destroy, proxy);
+}
+
+static void attio_disconnected(gpointer user_data)
+{
+	struct attrib_proxy *proxy = user_data;
+
+	DBG("ATT bearer of %s lost", device_get_path(proxy->device));
+
+	/*
+	 * Closing our end signals the client that the link is gone. The
+	 * attio callback can't be removed from within its own invocation,
+	 * so the rest of the cleanup is deferred.
+	 */
+	proxy_detach(proxy);
+
+	if (proxy->destroy_id == 0)
+		proxy->destroy_id = g_idle_add(proxy_destroy, proxy);
+}
+
+static int proxy_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct attrib_proxy *proxy = a;
+	const struct attrib_proxy *match = b;
+
+	if (proxy->device != match->device)
+		return -1;
+
+	return g_strcmp0(proxy->owner, match->owner);
+}
+
+DBusMessage *attrib_proxy_acquire(DBusConnection *conn, DBusMessage *msg,
+						struct btd_device *device)
+{
+	struct attrib_proxy *proxy, match;
+	const char *sender = dbus_message_get_sender(msg);
+
+	match.device = device;
+	match.owner = (char *) sender;
+
+	if (g_slist_find_custom(proxies, &match, proxy_cmp))
+		return btd_error_already_exists(msg);
+
+	proxy = g_new0(struct attrib_proxy, 1);
+	proxy->device = device;
+	proxy->owner = g_strdup(sender);
+	proxy->msg = dbus_message_ref(msg);
+
+	proxy->owner_watch = g_dbus_add_disconnect_watch(conn, sender,
+						owner_exit, proxy, NULL);
+
+	/* Registering also makes the device connect if it is not already */
+	proxy->attio_id = btd_device_add_attio_callback(device,
+						attio_connected,
+						attio_disconnected, proxy);
+
+	proxies = g_slist_append(proxies, proxy);
+
+	DBG("%s acquiring ATT channel of %s", sender,
+						device_get_path(device));
+
+	return NULL;
+}
+
+void attrib_proxy_remove_device(struct btd_device *device)
+{
+	GSList *l, *next;
+
+	for (l = proxies; l; l = next) {
+		struct attrib_proxy *proxy = l->data;
+
+		next = l->next;
+
+		if (proxy->device == device)
+			proxy_free(proxy);
+	}
+}
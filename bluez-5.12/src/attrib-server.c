@@ -54,6 +54,8 @@
 
 #include "attrib-server.h"
 
+#define CCC_STORE_TIMEOUT 2
+
 static GSList *servers = NULL;
 
 struct gatt_server {
@@ -66,6 +68,32 @@ struct gatt_server {
 	GSList *clients;
 	uint16_t name_handle;
 	uint16_t appearance_handle;
+	GSList *ccc_devices;
+	GHashTable *subscribers;	/* CCC handle -> GSList of device_ccc */
+	guint ccc_store_id;
+	GSList *queued_handles;
+	GList *uuid16_last;
+};
+
+struct attrib_block {
+	size_t size;
+	uint16_t refs;
+	struct attribute attrs[0];
+};
+
+struct device_ccc {
+	struct gatt_server *server;
+	struct btd_device *device;
+	char *filename;
+	GHashTable *values;
+	gboolean dirty;
+	GSList *pending;
+};
+
+struct pending_notify {
+	uint16_t handle;
+	uint8_t *value;
+	size_t len;
 };
 
 struct gatt_channel {
@@ -96,17 +124,104 @@ static bt_uuid_t snd_uuid = {
 			.type = BT_UUID16,
 			.value.u16 = GATT_SND_SVC_UUID
 };
+static bt_uuid_t chr_uuid = {
+			.type = BT_UUID16,
+			.value.u16 = GATT_CHARAC_UUID
+};
 static bt_uuid_t ccc_uuid = {
 			.type = BT_UUID16,
 			.value.u16 = GATT_CLIENT_CHARAC_CFG_UUID
 };
 
-static void attrib_free(void *data)
+static gboolean block_contains(struct attrib_block *block, const void *ptr)
+{
+	const uint8_t *p = ptr;
+
+	return p >= (uint8_t *) block && p < (uint8_t *) block + block->size;
+}
+
+static void attrib_free(struct attribute *a)
+{
+	struct attrib_block *block = a->block;
+
+	if (block == NULL) {
+		g_free(a->data);
+		g_free(a);
+		return;
+	}
+
+	if (!block_contains(block, a->data))
+		g_free(a->data);
+
+	if (--block->refs > 0)
+		return;
+
+	g_free(block);
+}
+
+static int attrib_set_value(struct attribute *a, const uint8_t *value,
+								size_t len)
+{
+	struct attrib_block *block;
+	uint8_t *data;
+
+	if (len == a->len) {
+		if (len > 0)
+			memcpy(a->data, value, len);
+		return 0;
+	}
+
+	block = a->block;
+	if (block && block_contains(block, a->data)) {
+		/* Values of block attributes live in the block itself */
+		data = g_try_malloc(len);
+	} else
+		data = g_try_realloc(a->data, len);
+
+	if (len && data == NULL)
+		return -ENOMEM;
+
+	a->data = data;
+	a->len = len;
+	memcpy(a->data, value, len);
+
+	return 0;
+}
+
+static uint8_t read_provided_value(struct gatt_channel *channel,
+							struct attribute *a)
+{
+	uint8_t value[ATT_MAX_VALUE_LEN];
+	ssize_t vlen;
+
+	vlen = a->value_cb(a, channel->device, value, sizeof(value), 0,
+							a->cb_user_data);
+	if (vlen < 0)
+		return -vlen;
+
+	if (attrib_set_value(a, value, vlen) < 0)
+		return ATT_ECODE_INSUFF_RESOURCES;
+
+	return 0;
+}
+
+static uint16_t enc_provided_resp(struct gatt_channel *channel,
+				struct attribute *a, uint8_t opcode,
+				uint16_t offset, uint8_t *pdu, size_t len)
 {
-	struct attribute *a = data;
+	ssize_t vlen;
+
+	vlen = a->value_cb(a, channel->device, &pdu[1], len - 1, offset,
+							a->cb_user_data);
+	if (vlen < 0)
+		return enc_error_resp(opcode, a->handle, -vlen, pdu, len);
+
+	if (opcode == ATT_OP_READ_REQ)
+		pdu[0] = ATT_OP_READ_RESP;
+	else
+		pdu[0] = ATT_OP_READ_BLOB_RESP;
 
-	g_free(a->data);
-	g_free(a);
+	return vlen + 1;
 }
 
 static void channel_free(struct gatt_channel *channel)
@@ -122,9 +237,102 @@ static void channel_free(struct gatt_channel *channel)
 	g_free(channel);
 }
 
+static void store_device_ccc(struct device_ccc *dccc)
+{
+	GKeyFile *key_file;
+	GHashTableIter iter;
+	gpointer key, val;
+	char group[6], value[5];
+	char *data;
+	gsize length = 0;
+
+	dccc->dirty = FALSE;
+
+	key_file = g_key_file_new();
+
+	g_hash_table_iter_init(&iter, dccc->values);
+	while (g_hash_table_iter_next(&iter, &key, &val)) {
+		sprintf(group, "%hu", GPOINTER_TO_UINT(key));
+		sprintf(value, "%hX", GPOINTER_TO_UINT(val));
+		g_key_file_set_string(key_file, group, "Value", value);
+	}
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (length > 0) {
+		create_file(dccc->filename, S_IRUSR | S_IWUSR);
+		g_file_set_contents(dccc->filename, data, length, NULL);
+	}
+
+	g_free(data);
+	g_key_file_free(key_file);
+}
+
+static void pending_notify_free(gpointer data)
+{
+	struct pending_notify *pn = data;
+
+	g_free(pn->value);
+	g_free(pn);
+}
+
+static void update_subscriber(struct device_ccc *dccc, uint16_t handle,
+								uint16_t value)
+{
+	GHashTable *subscribers = dccc->server->subscribers;
+	gpointer key = GUINT_TO_POINTER(handle);
+	GSList *list;
+
+	list = g_hash_table_lookup(subscribers, key);
+
+	if (value & GATT_CLIENT_CHARAC_CFG_NOTIF_BIT) {
+		if (g_slist_find(list, dccc))
+			return;
+
+		list = g_slist_prepend(list, dccc);
+	} else
+		list = g_slist_remove(list, dccc);
+
+	if (list)
+		g_hash_table_insert(subscribers, key, list);
+	else
+		g_hash_table_remove(subscribers, key);
+}
+
+static void device_ccc_free(gpointer data)
+{
+	struct device_ccc *dccc = data;
+	GHashTableIter iter;
+	gpointer key;
+
+	if (dccc->dirty)
+		store_device_ccc(dccc);
+
+	g_hash_table_iter_init(&iter, dccc->values);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		update_subscriber(dccc, GPOINTER_TO_UINT(key), 0);
+
+	g_slist_free_full(dccc->pending, pending_notify_free);
+	g_hash_table_destroy(dccc->values);
+	g_free(dccc->filename);
+	g_free(dccc);
+}
+
 static void gatt_server_free(struct gatt_server *server)
 {
-	g_list_free_full(server->database, attrib_free);
+	if (server->ccc_store_id > 0)
+		g_source_remove(server->ccc_store_id);
+
+	g_slist_free_full(server->ccc_devices, device_ccc_free);
+	g_hash_table_destroy(server->subscribers);
+	g_slist_free(server->queued_handles);
+
+	while (server->database) {
+		struct attribute *a = server->database->data;
+
+		server->database = g_list_delete_link(server->database,
+							server->database);
+		attrib_free(a);
+	}
 
 	if (server->l2cap_io != NULL) {
 		g_io_channel_shutdown(server->l2cap_io, FALSE, NULL);
@@ -554,6 +762,9 @@ static uint16_t read_by_type(struct gatt_channel *channel, uint16_t start,
 			status = a->read_cb(a, channel->device,
 							a->cb_user_data);
 
+		if (status == 0x00 && a->value_cb)
+			status = read_provided_value(channel, a);
+
 		if (status) {
 			g_slist_free(types);
 			return enc_error_resp(ATT_OP_READ_BY_TYPE_REQ,
@@ -746,38 +957,169 @@ static uint16_t find_by_type(struct gatt_channel *channel, uint16_t start,
 	return len;
 }
 
-static int read_device_ccc(struct btd_device *device, uint16_t handle,
-				uint16_t *value)
+static struct gatt_server *find_device_server(struct btd_device *device)
+{
+	GSList *l;
+
+	l = g_slist_find_custom(servers, device_get_adapter(device),
+								adapter_cmp);
+	if (l == NULL)
+		return NULL;
+
+	return l->data;
+}
+
+static int device_ccc_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct device_ccc *dccc = a;
+
+	return dccc->device == b ? 0 : -1;
+}
+
+static void load_device_ccc(struct device_ccc *dccc)
 {
-	char *filename;
 	GKeyFile *key_file;
-	char group[6];
-	char *str;
-	unsigned int config;
-	int err = 0;
+	char **groups, **group;
+
+	key_file = g_key_file_new();
+	g_key_file_load_from_file(key_file, dccc->filename, 0, NULL);
+
+	groups = g_key_file_get_groups(key_file, NULL);
+
+	for (group = groups; *group; group++) {
+		unsigned int handle, config;
+		char *str;
+
+		if (sscanf(*group, "%u", &handle) != 1 || handle > 0xffff)
+			continue;
+
+		str = g_key_file_get_string(key_file, *group, "Value", NULL);
+		if (str && sscanf(str, "%04X", &config) == 1) {
+			g_hash_table_insert(dccc->values,
+						GUINT_TO_POINTER(handle),
+						GUINT_TO_POINTER(config));
+			update_subscriber(dccc, handle, config);
+		}
+
+		g_free(str);
+	}
+
+	g_strfreev(groups);
+	g_key_file_free(key_file);
+}
+
+static struct device_ccc *get_device_ccc(struct gatt_server *server,
+						struct btd_device *device)
+{
+	struct device_ccc *dccc;
+	char *filename;
+	GSList *l;
+
+	l = g_slist_find_custom(server->ccc_devices, device, device_ccc_cmp);
+	if (l)
+		return l->data;
 
 	filename = btd_device_get_storage_path(device, "ccc");
 	if (!filename) {
 		warn("Unable to get ccc storage path for device");
-		return -ENOENT;
+		return NULL;
 	}
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	dccc = g_new0(struct device_ccc, 1);
+	dccc->server = server;
+	dccc->device = device;
+	dccc->filename = filename;
+	dccc->values = g_hash_table_new(NULL, NULL);
 
-	sprintf(group, "%hu", handle);
+	load_device_ccc(dccc);
 
-	str = g_key_file_get_string(key_file, group, "Value", NULL);
-	if (!str || sscanf(str, "%04X", &config) != 1)
-		err = -ENOENT;
-	else
-		*value = config;
+	server->ccc_devices = g_slist_prepend(server->ccc_devices, dccc);
 
-	g_free(str);
-	g_free(filename);
-	g_key_file_free(key_file);
+	return dccc;
+}
+
+static void remove_device_ccc(struct gatt_server *server,
+				struct btd_device *device, gboolean store)
+{
+	struct device_ccc *dccc;
+	GSList *l;
+
+	l = g_slist_find_custom(server->ccc_devices, device, device_ccc_cmp);
+	if (!l)
+		return;
+
+	dccc = l->data;
+	if (!store)
+		dccc->dirty = FALSE;
 
-	return err;
+	server->ccc_devices = g_slist_delete_link(server->ccc_devices, l);
+	device_ccc_free(dccc);
+}
+
+static gboolean store_ccc_cb(gpointer user_data)
+{
+	struct gatt_server *server = user_data;
+	GSList *l;
+
+	server->ccc_store_id = 0;
+
+	for (l = server->ccc_devices; l; l = l->next) {
+		struct device_ccc *dccc = l->data;
+
+		if (dccc->dirty)
+			store_device_ccc(dccc);
+	}
+
+	return FALSE;
+}
+
+static int read_device_ccc(struct gatt_server *server,
+				struct btd_device *device, uint16_t handle,
+				uint16_t *value)
+{
+	struct device_ccc *dccc;
+	gpointer val;
+
+	dccc = get_device_ccc(server, device);
+	if (!dccc)
+		return -ENOENT;
+
+	if (!g_hash_table_lookup_extended(dccc->values,
+					GUINT_TO_POINTER(handle), NULL, &val))
+		return -ENOENT;
+
+	*value = GPOINTER_TO_UINT(val);
+
+	return 0;
+}
+
+static int write_device_ccc(struct gatt_server *server,
+				struct btd_device *device, uint16_t handle,
+				uint16_t value)
+{
+	struct device_ccc *dccc;
+	gpointer val;
+
+	dccc = get_device_ccc(server, device);
+	if (!dccc)
+		return -ENOENT;
+
+	if (g_hash_table_lookup_extended(dccc->values,
+					GUINT_TO_POINTER(handle), NULL, &val) &&
+					GPOINTER_TO_UINT(val) == value)
+		return 0;
+
+	g_hash_table_insert(dccc->values, GUINT_TO_POINTER(handle),
+						GUINT_TO_POINTER(value));
+	update_subscriber(dccc, handle, value);
+
+	dccc->dirty = TRUE;
+
+	if (server->ccc_store_id == 0)
+		server->ccc_store_id = g_timeout_add_seconds(CCC_STORE_TIMEOUT,
+							store_ccc_cb, server);
+
+	return 0;
 }
 
 static uint16_t read_value(struct gatt_channel *channel, uint16_t handle,
@@ -798,7 +1140,8 @@ static uint16_t read_value(struct gatt_channel *channel, uint16_t handle,
 	a = l->data;
 
 	if (bt_uuid_cmp(&ccc_uuid, &a->uuid) == 0 &&
-		read_device_ccc(channel->device, handle, &cccval) == 0) {
+		read_device_ccc(channel->server, channel->device, handle,
+							&cccval) == 0) {
 		uint8_t config[2];
 
 		att_put_u16(cccval, config);
@@ -814,6 +1157,10 @@ static uint16_t read_value(struct gatt_channel *channel, uint16_t handle,
 		return enc_error_resp(ATT_OP_READ_REQ, handle, status, pdu,
 									len);
 
+	if (a->value_cb)
+		return enc_provided_resp(channel, a, ATT_OP_READ_REQ, 0, pdu,
+									len);
+
 	return enc_read_resp(a->data, a->len, pdu, len);
 }
 
@@ -834,12 +1181,13 @@ static uint16_t read_blob(struct gatt_channel *channel, uint16_t handle,
 
 	a = l->data;
 
-	if (a->len <= offset)
+	if (a->value_cb == NULL && a->len <= offset)
 		return enc_error_resp(ATT_OP_READ_BLOB_REQ, handle,
 					ATT_ECODE_INVALID_OFFSET, pdu, len);
 
 	if (bt_uuid_cmp(&ccc_uuid, &a->uuid) == 0 &&
-		read_device_ccc(channel->device, handle, &cccval) == 0) {
+		read_device_ccc(channel->server, channel->device, handle,
+							&cccval) == 0) {
 		uint8_t config[2];
 
 		att_put_u16(cccval, config);
@@ -856,6 +1204,10 @@ static uint16_t read_blob(struct gatt_channel *channel, uint16_t handle,
 		return enc_error_resp(ATT_OP_READ_BLOB_REQ, handle, status,
 								pdu, len);
 
+	if (a->value_cb)
+		return enc_provided_resp(channel, a, ATT_OP_READ_BLOB_REQ,
+							offset, pdu, len);
+
 	return enc_read_blob_resp(a->data, a->len, offset, pdu, len);
 }
 
@@ -883,8 +1235,7 @@ static uint16_t write_value(struct gatt_channel *channel, uint16_t handle,
 
 	if (bt_uuid_cmp(&ccc_uuid, &a->uuid) != 0) {
 
-		attrib_db_update(channel->server->adapter, handle, NULL,
-							value, vlen, NULL);
+		attrib_set_value(a, value, vlen);
 
 		if (a->write_cb) {
 			status = a->write_cb(a, channel->device,
@@ -895,36 +1246,12 @@ static uint16_t write_value(struct gatt_channel *channel, uint16_t handle,
 		}
 	} else {
 		uint16_t cccval = att_get_u16(value);
-		char *filename;
-		GKeyFile *key_file;
-		char group[6], value[5];
-		char *data;
-		gsize length = 0;
-
-		filename = btd_device_get_storage_path(channel->device, "ccc");
-		if (!filename) {
-			warn("Unable to get ccc storage path for device");
+
+		if (write_device_ccc(channel->server, channel->device, handle,
+								cccval) < 0)
 			return enc_error_resp(ATT_OP_WRITE_REQ, handle,
 						ATT_ECODE_WRITE_NOT_PERM,
 						pdu, len);
-		}
-
-		key_file = g_key_file_new();
-		g_key_file_load_from_file(key_file, filename, 0, NULL);
-
-		sprintf(group, "%hu", handle);
-		sprintf(value, "%hhX", cccval);
-		g_key_file_set_string(key_file, group, "Value", value);
-
-		data = g_key_file_to_data(key_file, &length, NULL);
-		if (length > 0) {
-			create_file(filename, S_IRUSR | S_IWUSR);
-			g_file_set_contents(filename, data, length, NULL);
-		}
-
-		g_free(data);
-		g_free(filename);
-		g_key_file_free(key_file);
 	}
 
 	return enc_write_resp(pdu);
@@ -1098,6 +1425,82 @@ done:
 	g_attrib_send(channel->attrib, 0, opdu, length, NULL, NULL, NULL);
 }
 
+static uint16_t find_ccc_handle(struct gatt_server *server, uint16_t handle)
+{
+	guint h = handle;
+	GList *l;
+
+	l = g_list_find_custom(server->database, GUINT_TO_POINTER(h),
+								handle_cmp);
+	if (l == NULL)
+		return 0;
+
+	for (l = l->next; l; l = l->next) {
+		struct attribute *a = l->data;
+
+		if (bt_uuid_cmp(&ccc_uuid, &a->uuid) == 0)
+			return a->handle;
+
+		if (bt_uuid_cmp(&chr_uuid, &a->uuid) == 0 ||
+				bt_uuid_cmp(&prim_uuid, &a->uuid) == 0 ||
+				bt_uuid_cmp(&snd_uuid, &a->uuid) == 0)
+			break;
+	}
+
+	return 0;
+}
+
+static gboolean channel_notify_enabled(struct gatt_channel *channel,
+								uint16_t ccc)
+{
+	uint16_t cccval;
+
+	if (read_device_ccc(channel->server, channel->device, ccc,
+								&cccval) < 0)
+		return FALSE;
+
+	return (cccval & GATT_CLIENT_CHARAC_CFG_NOTIF_BIT) ? TRUE : FALSE;
+}
+
+static void channel_notify(struct gatt_channel *channel, uint16_t handle,
+					const uint8_t *value, size_t vlen)
+{
+	uint8_t pdu[ATT_MAX_VALUE_LEN + 3];
+	uint16_t len;
+
+	len = enc_notification(handle, (uint8_t *) value,
+				MIN(vlen, ATT_MAX_VALUE_LEN), pdu, sizeof(pdu));
+
+	g_attrib_send(channel->attrib, 0, pdu, MIN(len, channel->mtu),
+							NULL, NULL, NULL);
+}
+
+static void send_pending_notify(struct gatt_channel *channel)
+{
+	struct gatt_server *server = channel->server;
+	struct device_ccc *dccc;
+	GSList *l;
+
+	l = g_slist_find_custom(server->ccc_devices, channel->device,
+								device_ccc_cmp);
+	if (l == NULL)
+		return;
+
+	dccc = l->data;
+
+	for (l = dccc->pending; l; l = l->next) {
+		struct pending_notify *pn = l->data;
+		uint16_t ccc = find_ccc_handle(server, pn->handle);
+
+		if (ccc && channel_notify_enabled(channel, ccc))
+			channel_notify(channel, pn->handle, pn->value,
+								pn->len);
+	}
+
+	g_slist_free_full(dccc->pending, pending_notify_free);
+	dccc->pending = NULL;
+}
+
 guint attrib_channel_attach(GAttrib *attrib)
 {
 	struct gatt_server *server;
@@ -1147,6 +1550,8 @@ guint attrib_channel_attach(GAttrib *attrib)
 	if (device_is_bonded(device) == FALSE) {
 		char *filename;
 
+		remove_device_ccc(server, device, FALSE);
+
 		filename = btd_device_get_storage_path(device, "ccc");
 		if (filename) {
 			unlink(filename);
@@ -1173,6 +1578,8 @@ guint attrib_channel_attach(GAttrib *attrib)
 
 	server->clients = g_slist_append(server->clients, channel);
 
+	send_pending_notify(channel);
+
 	return channel->id;
 }
 
@@ -1309,6 +1716,7 @@ int btd_adapter_gatt_server_start(struct btd_adapter *adapter)
 
 	server = g_new0(struct gatt_server, 1);
 	server->adapter = btd_adapter_ref(adapter);
+	server->subscribers = g_hash_table_new(NULL, NULL);
 
 	addr = btd_adapter_get_address(server->adapter);
 
@@ -1383,6 +1791,32 @@ void attrib_free_sdp(struct btd_adapter *adapter, uint32_t sdp_handle)
 	adapter_service_remove(adapter, sdp_handle);
 }
 
+static gboolean is_service(struct attribute *a)
+{
+	return bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
+				bt_uuid_cmp(&a->uuid, &snd_uuid) == 0;
+}
+
+static uint16_t find_uuid16_after(GList *dl, uint16_t nitems)
+{
+	struct attribute *a = dl->data;
+	uint16_t handle;
+
+	if (a->handle == 0xffff)
+		return 0;
+
+	handle = a->handle + 1;
+
+	if (dl->next == NULL)
+		return 0xffff - handle + 1 >= nitems ? handle : 0;
+
+	a = dl->next->data;
+	if (is_service(a) && a->handle - handle >= nitems)
+		return handle;
+
+	return 0;
+}
+
 static uint16_t find_uuid16_avail(struct btd_adapter *adapter, uint16_t nitems)
 {
 	struct gatt_server *server;
@@ -1398,6 +1832,14 @@ static uint16_t find_uuid16_avail(struct btd_adapter *adapter, uint16_t nitems)
 	if (server->database == NULL)
 		return 0x0001;
 
+	/* Services are usually registered back to back, so try the gap
+	 * after the last 16 bit block before scanning the database */
+	if (server->uuid16_last) {
+		handle = find_uuid16_after(server->uuid16_last, nitems);
+		if (handle)
+			return handle;
+	}
+
 	for (dl = server->database, handle = 0x0001; dl; dl = dl->next) {
 		struct attribute *a = dl->data;
 
@@ -1505,6 +1947,100 @@ struct attribute *attrib_db_add(struct btd_adapter *adapter, uint16_t handle,
 								value, len);
 }
 
+struct attribute *attrib_db_add_block(struct btd_adapter *adapter,
+				const struct attribute *attrs, uint16_t count,
+				const char *name, uint32_t *sdp_handle)
+{
+	struct gatt_server *server;
+	struct attrib_block *block;
+	GList *dl, *prev = NULL, *chain = NULL, *last;
+	uint16_t start, end, i;
+	uint8_t *data;
+	size_t size;
+	GSList *l;
+
+	if (count == 0)
+		return NULL;
+
+	l = g_slist_find_custom(servers, adapter, adapter_cmp);
+	if (l == NULL)
+		return NULL;
+
+	server = l->data;
+
+	start = attrs[0].handle;
+	end = attrs[count - 1].handle;
+
+	DBG("handles 0x%04x-0x%04x", start, end);
+
+	size = sizeof(*block) + count * sizeof(struct attribute);
+
+	for (i = 0; i < count; i++) {
+		if (i > 0 && attrs[i].handle <= attrs[i - 1].handle)
+			return NULL;
+
+		size += attrs[i].len;
+	}
+
+	/* Find the insertion point and check the range is free in one pass */
+	for (dl = server->database; dl; prev = dl, dl = dl->next) {
+		struct attribute *a = dl->data;
+
+		if (a->handle < start)
+			continue;
+
+		if (a->handle <= end)
+			return NULL;
+
+		break;
+	}
+
+	block = g_malloc0(size);
+	block->size = size;
+	block->refs = count;
+
+	data = (uint8_t *) &block->attrs[count];
+
+	for (i = 0; i < count; i++) {
+		struct attribute *a = &block->attrs[i];
+
+		*a = attrs[i];
+		a->block = block;
+
+		if (a->len == 0) {
+			a->data = NULL;
+			continue;
+		}
+
+		memcpy(data, attrs[i].data, a->len);
+		a->data = data;
+		data += a->len;
+	}
+
+	for (i = count; i > 0; i--)
+		chain = g_list_prepend(chain, &block->attrs[i - 1]);
+
+	last = g_list_last(chain);
+
+	chain->prev = prev;
+	if (prev)
+		prev->next = chain;
+	else
+		server->database = chain;
+
+	last->next = dl;
+	if (dl)
+		dl->prev = last;
+
+	if (is_service(block->attrs) && block->attrs->len == 2)
+		server->uuid16_last = last;
+
+	if (sdp_handle)
+		*sdp_handle = attrib_create_sdp_new(server, start, name);
+
+	return block->attrs;
+}
+
 int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 					bt_uuid_t *uuid, const uint8_t *value,
 					size_t len, struct attribute **attr)
@@ -1530,13 +2066,9 @@ int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 
 	a = dl->data;
 
-	a->data = g_try_realloc(a->data, len);
-	if (len && a->data == NULL)
+	if (attrib_set_value(a, value, len) < 0)
 		return -ENOMEM;
 
-	a->len = len;
-	memcpy(a->data, value, len);
-
 	if (uuid != NULL)
 		a->uuid = *uuid;
 
@@ -1568,9 +2100,12 @@ int attrib_db_del(struct btd_adapter *adapter, uint16_t handle)
 		return -ENOENT;
 
 	a = dl->data;
-	server->database = g_list_remove(server->database, a);
-	g_free(a->data);
-	g_free(a);
+
+	if (server->uuid16_last == dl)
+		server->uuid16_last = NULL;
+
+	server->database = g_list_delete_link(server->database, dl);
+	attrib_free(a);
 
 	return 0;
 }
@@ -1603,3 +2138,155 @@ int attrib_gap_set(struct btd_adapter *adapter, uint16_t uuid,
 
 	return attrib_db_update(adapter, handle, NULL, value, len, NULL);
 }
+
+int attrib_ccc_get(struct btd_device *device, uint16_t handle,
+							uint16_t *value)
+{
+	struct gatt_server *server;
+
+	server = find_device_server(device);
+	if (server == NULL)
+		return -ENODEV;
+
+	return read_device_ccc(server, device, handle, value);
+}
+
+void attrib_ccc_remove_device(struct btd_device *device,
+						gboolean remove_stored)
+{
+	struct gatt_server *server;
+
+	server = find_device_server(device);
+	if (server == NULL)
+		return;
+
+	/* Pending values of an unpaired device must not recreate its
+	 * storage after it has been removed */
+	remove_device_ccc(server, device, !remove_stored);
+}
+
+static int pending_notify_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct pending_notify *pn = a;
+	uint16_t handle = GPOINTER_TO_UINT(b);
+
+	return pn->handle - handle;
+}
+
+static int channel_device_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct gatt_channel *channel = a;
+
+	return channel->device == b ? 0 : -1;
+}
+
+static void queue_device_notify(struct device_ccc *dccc, uint16_t handle,
+					const uint8_t *value, size_t len)
+{
+	struct pending_notify *pn;
+	GSList *l;
+
+	l = g_slist_find_custom(dccc->pending, GUINT_TO_POINTER(handle),
+							pending_notify_cmp);
+	if (l) {
+		pn = l->data;
+		g_free(pn->value);
+	} else {
+		pn = g_new0(struct pending_notify, 1);
+		pn->handle = handle;
+		dccc->pending = g_slist_append(dccc->pending, pn);
+	}
+
+	pn->value = g_memdup(value, len);
+	pn->len = len;
+}
+
+int attrib_db_notify(struct btd_adapter *adapter, uint16_t handle,
+					const uint8_t *value, size_t len)
+{
+	struct gatt_server *server;
+	uint8_t pdu[ATT_MAX_VALUE_LEN + 3];
+	uint16_t ccc, plen;
+	GSList *l;
+	int count = 0;
+
+	l = g_slist_find_custom(servers, adapter, adapter_cmp);
+	if (l == NULL)
+		return -ENOENT;
+
+	server = l->data;
+
+	ccc = find_ccc_handle(server, handle);
+	if (ccc == 0)
+		return -EINVAL;
+
+	len = MIN(len, ATT_MAX_VALUE_LEN);
+	plen = enc_notification(handle, (uint8_t *) value, len, pdu,
+								sizeof(pdu));
+
+	for (l = server->clients; l; l = l->next) {
+		struct gatt_channel *channel = l->data;
+
+		if (!channel_notify_enabled(channel, ccc))
+			continue;
+
+		g_attrib_send(channel->attrib, 0, pdu,
+					MIN(plen, channel->mtu), NULL, NULL,
+					NULL);
+		count++;
+	}
+
+	if (!g_slist_find(server->queued_handles, GUINT_TO_POINTER(handle)))
+		return count;
+
+	l = g_hash_table_lookup(server->subscribers, GUINT_TO_POINTER(ccc));
+	for (; l; l = l->next) {
+		struct device_ccc *dccc = l->data;
+
+		if (!device_is_bonded(dccc->device))
+			continue;
+
+		if (g_slist_find_custom(server->clients, dccc->device,
+							channel_device_cmp))
+			continue;
+
+		queue_device_notify(dccc, handle, value, len);
+	}
+
+	return count;
+}
+
+static void load_bonded_ccc(struct btd_device *device, void *user_data)
+{
+	struct gatt_server *server = user_data;
+
+	if (device_is_bonded(device))
+		get_device_ccc(server, device);
+}
+
+int attrib_db_set_notify_queue(struct btd_adapter *adapter, uint16_t handle,
+							gboolean enable)
+{
+	struct gatt_server *server;
+	gpointer h = GUINT_TO_POINTER(handle);
+	GSList *l;
+
+	l = g_slist_find_custom(servers, adapter, adapter_cmp);
+	if (l == NULL)
+		return -ENOENT;
+
+	server = l->data;
+
+	server->queued_handles = g_slist_remove(server->queued_handles, h);
+
+	if (!enable)
+		return 0;
+
+	/* Index the bonded devices that have not connected since startup */
+	if (server->queued_handles == NULL)
+		btd_adapter_for_each_device(adapter, load_bonded_ccc, server);
+
+	server->queued_handles = g_slist_prepend(server->queued_handles, h);
+
+	return 0;
+}
@@ -28,10 +28,17 @@ struct attribute *attrib_db_add(struct btd_adapter *adapter, uint16_t handle,
 				bt_uuid_t *uuid, int read_req,
 				int write_req, const uint8_t *value,
 				size_t len);
+struct attribute *attrib_db_add_block(struct btd_adapter *adapter,
+				const struct attribute *attrs, uint16_t count,
+				const char *name, uint32_t *sdp_handle);
 int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 					bt_uuid_t *uuid, const uint8_t *value,
 					size_t len, struct attribute **attr);
 int attrib_db_del(struct btd_adapter *adapter, uint16_t handle);
+int attrib_db_notify(struct btd_adapter *adapter, uint16_t handle,
+					const uint8_t *value, size_t len);
+int attrib_db_set_notify_queue(struct btd_adapter *adapter, uint16_t handle,
+							gboolean enable);
 int attrib_gap_set(struct btd_adapter *adapter, uint16_t uuid,
 					const uint8_t *value, size_t len);
 uint32_t attrib_create_sdp(struct btd_adapter *adapter, uint16_t handle,
@@ -39,3 +46,7 @@ uint32_t attrib_create_sdp(struct btd_adapter *adapter, uint16_t handle,
 void attrib_free_sdp(struct btd_adapter *adapter, uint32_t sdp_handle);
 guint attrib_channel_attach(GAttrib *attrib);
 gboolean attrib_channel_detach(GAttrib *attrib, guint id);
+int attrib_ccc_get(struct btd_device *device, uint16_t handle,
+							uint16_t *value);
+void attrib_ccc_remove_device(struct btd_device *device,
+						gboolean remove_stored);
@@ -36,6 +36,7 @@
 #include <time.h>
 
 #include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
 #include <bluetooth/sdp.h>
 #include <bluetooth/sdp_lib.h>
 
@@ -53,6 +54,7 @@
 #include "adapter.h"
 #include "attrib/gattrib.h"
 #include "attio.h"
+#include "attrib-proxy.h"
 #include "device.h"
 #include "profile.h"
 #include "service.h"
@@ -64,12 +66,20 @@
 #include "agent.h"
 #include "storage.h"
 #include "attrib-server.h"
+#include "src/shared/trace.h"
 
 #define IO_CAPABILITY_NOINPUTNOOUTPUT	0x03
 
 #define DISCONNECT_TIMER	2
 #define DISCOVERY_TIMER		1
 
+/* LE connection parameter limits from the Core specification */
+#define CONN_INTERVAL_MIN	0x0006
+#define CONN_INTERVAL_MAX	0x0c80
+#define CONN_LATENCY_MAX	0x01f3
+#define CONN_TIMEOUT_MIN	0x000a
+#define CONN_TIMEOUT_MAX	0x0c80
+
 static DBusConnection *dbus_conn = NULL;
 unsigned service_state_cb_id;
 
@@ -118,6 +128,7 @@ struct browse_req {
 	int search_uuid;
 	int reconnect_attempt;
 	guint listener_id;
+	bool fast_conn;
 };
 
 struct included_search {
@@ -133,6 +144,30 @@ struct attio_data {
 	gpointer user_data;
 };
 
+enum conn_param_state {
+	CONN_PARAM_DEFAULT,
+	CONN_PARAM_FAST,
+	CONN_PARAM_SLOW,
+};
+
+struct conn_params {
+	bool		policy;
+	uint16_t	fast_min_interval;
+	uint16_t	fast_max_interval;
+	uint16_t	slow_min_interval;
+	uint16_t	slow_max_interval;
+	uint16_t	slow_latency;
+	uint16_t	timeout;
+	uint16_t	idle_timeout;
+	enum conn_param_state state;		/* Confirmed by the controller */
+	enum conn_param_state target;
+	enum conn_param_state pending;		/* Update in flight */
+	uint16_t	handle;
+	bool		rejected;		/* Refused for this link */
+	unsigned int	busy;			/* Pending fast requests */
+	guint		idle_id;
+};
+
 struct svc_callback {
 	unsigned int id;
 	guint idle_id;
@@ -208,6 +243,8 @@ struct btd_device {
 	GIOChannel	*att_io;
 	guint		cleanup_id;
 	guint		store_id;
+
+	struct conn_params conn_params;
 };
 
 static const uint16_t uuid_list[] = {
@@ -436,11 +473,30 @@ static void browse_request_free(struct browse_req *req)
 	if (req->records)
 		sdp_list_free(req->records, (sdp_free_func_t) sdp_record_free);
 
+	if (req->fast_conn)
+		btd_device_release_fast_conn(req->device);
+
 	g_free(req);
 }
 
 static void attio_cleanup(struct btd_device *device)
 {
+	struct conn_params *params = &device->conn_params;
+
+	if (params->idle_id) {
+		g_source_remove(params->idle_id);
+		params->idle_id = 0;
+	}
+
+	if (params->pending != CONN_PARAM_DEFAULT)
+		btd_adapter_le_conn_update_cancel(device->adapter,
+							params->handle);
+
+	params->state = CONN_PARAM_DEFAULT;
+	params->target = CONN_PARAM_DEFAULT;
+	params->pending = CONN_PARAM_DEFAULT;
+	params->rejected = false;
+
 	if (device->attachid) {
 		attrib_channel_detach(device->attrib, device->attachid);
 		device->attachid = 0;
@@ -1762,6 +1818,17 @@ static DBusMessage *cancel_pairing(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *acquire_attrib_channel(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct btd_device *device = data;
+
+	if (device->bdaddr_type == BDADDR_BREDR)
+		return btd_error_not_supported(msg);
+
+	return attrib_proxy_acquire(conn, msg, device);
+}
+
 static const GDBusMethodTable device_methods[] = {
 	{ GDBUS_ASYNC_METHOD("Disconnect", NULL, NULL, dev_disconnect) },
 	{ GDBUS_ASYNC_METHOD("Connect", NULL, NULL, dev_connect) },
@@ -1771,6 +1838,9 @@ static const GDBusMethodTable device_methods[] = {
 						NULL, disconnect_profile) },
 	{ GDBUS_ASYNC_METHOD("Pair", NULL, NULL, pair_device) },
 	{ GDBUS_METHOD("CancelPairing", NULL, NULL, cancel_pairing) },
+	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("AcquireAttributeChannel", NULL,
+				GDBUS_ARGS({ "fd", "h" }),
+				acquire_attrib_channel) },
 	{ }
 };
 
@@ -1802,6 +1872,15 @@ gboolean btd_device_is_connected(struct btd_device *device)
 	return device->connected;
 }
 
+static void trace_device(uint32_t id, struct btd_device *device,
+								uint32_t arg)
+{
+	const uint8_t *b = device->bdaddr.b;
+
+	trace_event(id, b[5] << 24 | b[4] << 16 | b[3] << 8 | b[2],
+				b[1] << 8 | b[0], arg);
+}
+
 void device_add_connection(struct btd_device *device)
 {
 	if (device->connected) {
@@ -1813,6 +1892,8 @@ void device_add_connection(struct btd_device *device)
 
 	device->connected = TRUE;
 
+	trace_device(TRACE_DEVICE_CONNECT, device, device->bdaddr_type);
+
 	g_dbus_emit_property_changed(dbus_conn, device->path,
 						DEVICE_INTERFACE, "Connected");
 }
@@ -1830,6 +1911,8 @@ void device_remove_connection(struct btd_device *device)
 	device->general_connect = FALSE;
 	device->svc_refreshed = false;
 
+	trace_device(TRACE_DEVICE_DISCONNECT, device, device->bdaddr_type);
+
 	if (device->disconn_timer > 0) {
 		g_source_remove(device->disconn_timer);
 		device->disconn_timer = 0;
@@ -1915,6 +1998,55 @@ failed:
 	return str;
 }
 
+static void load_conn_param(GKeyFile *key_file, const char *key,
+							uint16_t *value)
+{
+	unsigned long val;
+	char *str, *end;
+
+	str = g_key_file_get_string(key_file, "ConnectionParameters", key,
+									NULL);
+	if (str == NULL)
+		return;
+
+	val = strtoul(str, &end, 0);
+	if (*end != '\0' || val > UINT16_MAX)
+		error("Invalid connection parameter %s=%s", key, str);
+	else
+		*value = val;
+
+	g_free(str);
+}
+
+static void load_conn_params(struct btd_device *device, GKeyFile *key_file)
+{
+	struct conn_params *params = &device->conn_params;
+	GError *gerr = NULL;
+	gboolean policy;
+
+	if (!g_key_file_has_group(key_file, "ConnectionParameters"))
+		return;
+
+	policy = g_key_file_get_boolean(key_file, "ConnectionParameters",
+							"Policy", &gerr);
+	if (gerr)
+		g_error_free(gerr);
+	else
+		params->policy = policy;
+
+	load_conn_param(key_file, "FastMinInterval",
+						&params->fast_min_interval);
+	load_conn_param(key_file, "FastMaxInterval",
+						&params->fast_max_interval);
+	load_conn_param(key_file, "SlowMinInterval",
+						&params->slow_min_interval);
+	load_conn_param(key_file, "SlowMaxInterval",
+						&params->slow_max_interval);
+	load_conn_param(key_file, "SlowLatency", &params->slow_latency);
+	load_conn_param(key_file, "SupervisionTimeout", &params->timeout);
+	load_conn_param(key_file, "IdleTimeout", &params->idle_timeout);
+}
+
 static void load_info(struct btd_device *device, const char *local,
 			const char *peer, GKeyFile *key_file)
 {
@@ -2047,6 +2179,8 @@ next:
 		btd_device_set_pnpid(device, source, vendor, product, version);
 	}
 
+	load_conn_params(device, key_file);
+
 	if (store_needed)
 		store_device_info(device);
 }
@@ -2140,6 +2274,19 @@ static void load_att_info(struct btd_device *device, const char *local,
 	g_free(prim_uuid);
 }
 
+static void conn_params_init(struct conn_params *params)
+{
+	params->policy = main_opts.le_conn_policy;
+	params->fast_min_interval = main_opts.le_fast_min_interval;
+	params->fast_max_interval = main_opts.le_fast_max_interval;
+	params->slow_min_interval = main_opts.le_slow_min_interval;
+	params->slow_max_interval = main_opts.le_slow_max_interval;
+	params->slow_latency = main_opts.le_slow_latency;
+	params->timeout = main_opts.le_supervision_timeout;
+	params->idle_timeout = main_opts.le_idle_timeout;
+	params->state = CONN_PARAM_DEFAULT;
+}
+
 static struct btd_device *device_new(struct btd_adapter *adapter,
 				const char *address)
 {
@@ -2173,6 +2320,8 @@ static struct btd_device *device_new(struct btd_adapter *adapter,
 	str2ba(address, &device->bdaddr);
 	device->adapter = adapter;
 
+	conn_params_init(&device->conn_params);
+
 	return btd_device_ref(device);
 }
 
@@ -2413,6 +2562,9 @@ void device_remove(struct btd_device *device, gboolean remove_stored)
 	if (device->browse)
 		browse_request_cancel(device->browse);
 
+	attrib_proxy_remove_device(device);
+	attrib_ccc_remove_device(device, remove_stored);
+
 	while (device->services != NULL) {
 		struct btd_service *service = device->services->data;
 
@@ -3095,6 +3247,8 @@ static gboolean attrib_disconnected_cb(GIOChannel *io, GIOCondition cond,
 
 	DBG("%s (%d)", strerror(err), err);
 
+	trace_device(TRACE_DEVICE_ATT_DISCONNECT, device, err);
+
 	g_slist_foreach(device->attios, attio_disconnected, NULL);
 
 	if (!device_get_auto_connect(device)) {
@@ -3244,6 +3398,199 @@ static void primary_cb(GSList *services, guint8 status, gpointer user_data)
 	find_included_services(req, services);
 }
 
+static bool conn_params_valid(uint16_t min, uint16_t max, uint16_t latency,
+							uint16_t timeout)
+{
+	if (min < CONN_INTERVAL_MIN || max > CONN_INTERVAL_MAX || min > max)
+		return false;
+
+	if (latency > CONN_LATENCY_MAX)
+		return false;
+
+	if (timeout < CONN_TIMEOUT_MIN || timeout > CONN_TIMEOUT_MAX)
+		return false;
+
+	/*
+	 * The supervision timeout (10 ms units) must be larger than
+	 * (1 + latency) * max_interval (1.25 ms units) * 2.
+	 */
+	if (timeout * 4 <= (1 + latency) * max)
+		return false;
+
+	return true;
+}
+
+static void conn_params_updated(uint8_t status, uint16_t interval,
+				uint16_t latency, uint16_t timeout,
+				void *user_data);
+
+static void conn_params_set(struct btd_device *device,
+						enum conn_param_state state)
+{
+	struct conn_params *params = &device->conn_params;
+	uint16_t min, max, latency, handle;
+	GError *gerr = NULL;
+	GIOChannel *io;
+	int err;
+
+	params->target = state;
+
+	if (!params->policy || params->rejected || device->attrib == NULL)
+		return;
+
+	/* Picked up again once the update in flight completes */
+	if (params->pending != CONN_PARAM_DEFAULT)
+		return;
+
+	if (params->state == state)
+		return;
+
+	if (state == CONN_PARAM_FAST) {
+		min = params->fast_min_interval;
+		max = params->fast_max_interval;
+		latency = 0;
+	} else {
+		min = params->slow_min_interval;
+		max = params->slow_max_interval;
+		latency = params->slow_latency;
+	}
+
+	if (!conn_params_valid(min, max, latency, params->timeout)) {
+		error("Invalid %s connection parameters for %s",
+				state == CONN_PARAM_FAST ? "fast" : "slow",
+				device->path);
+		return;
+	}
+
+	io = g_attrib_get_channel(device->attrib);
+	if (!bt_io_get(io, &gerr, BT_IO_OPT_HANDLE, &handle,
+							BT_IO_OPT_INVALID)) {
+		error("Unable to get connection handle: %s", gerr->message);
+		g_error_free(gerr);
+		return;
+	}
+
+	err = btd_adapter_le_conn_update(device->adapter, handle, min, max,
+						latency, params->timeout,
+						conn_params_updated, device);
+	if (err < 0) {
+		error("Connection parameter update failed: %s (%d)",
+							strerror(-err), -err);
+		return;
+	}
+
+	params->pending = state;
+	params->handle = handle;
+}
+
+static void conn_params_schedule_idle(struct btd_device *device);
+
+static void conn_params_updated(uint8_t status, uint16_t interval,
+				uint16_t latency, uint16_t timeout,
+				void *user_data)
+{
+	struct btd_device *device = user_data;
+	struct conn_params *params = &device->conn_params;
+	enum conn_param_state state = params->pending;
+
+	params->pending = CONN_PARAM_DEFAULT;
+
+	if (status == 0) {
+		DBG("%s interval 0x%4.4x latency %u timeout 0x%4.4x",
+				device->path, interval, latency, timeout);
+		params->state = state;
+		conn_params_set(device, params->target);
+		return;
+	}
+
+	error("%s connection parameter update rejected (0x%02x)",
+				state == CONN_PARAM_FAST ? "Fast" : "Slow",
+				status);
+
+	switch (status) {
+	case HCI_COMMAND_DISALLOWED:
+	case HCI_UNSUPPORTED_FEATURE:
+	case HCI_UNSUPPORTED_REMOTE_FEATURE:
+		/*
+		 * Typically the local side is slave; keep whatever the
+		 * master picked for the rest of this connection.
+		 */
+		params->rejected = true;
+		return;
+	}
+
+	/* Try again later unless a fast request is still outstanding */
+	if (params->busy == 0)
+		conn_params_schedule_idle(device);
+}
+
+static gboolean conn_params_idle(gpointer user_data)
+{
+	struct btd_device *device = user_data;
+
+	device->conn_params.idle_id = 0;
+
+	DBG("%s idle, requesting slow connection parameters", device->path);
+
+	conn_params_set(device, CONN_PARAM_SLOW);
+
+	return FALSE;
+}
+
+static void conn_params_schedule_idle(struct btd_device *device)
+{
+	struct conn_params *params = &device->conn_params;
+
+	if (!params->policy || device->attrib == NULL)
+		return;
+
+	if (params->idle_id)
+		g_source_remove(params->idle_id);
+
+	params->idle_id = g_timeout_add_seconds(params->idle_timeout,
+						conn_params_idle, device);
+}
+
+static void conn_params_connected(struct btd_device *device)
+{
+	/*
+	 * Profiles usually read and configure characteristics right after
+	 * the link comes up, so start fast and let the idle timer relax the
+	 * parameters afterwards.
+	 */
+	conn_params_set(device, CONN_PARAM_FAST);
+
+	if (device->conn_params.busy == 0)
+		conn_params_schedule_idle(device);
+}
+
+void btd_device_request_fast_conn(struct btd_device *device)
+{
+	struct conn_params *params = &device->conn_params;
+
+	params->busy++;
+
+	if (params->idle_id) {
+		g_source_remove(params->idle_id);
+		params->idle_id = 0;
+	}
+
+	conn_params_set(device, CONN_PARAM_FAST);
+}
+
+void btd_device_release_fast_conn(struct btd_device *device)
+{
+	struct conn_params *params = &device->conn_params;
+
+	if (params->busy == 0)
+		return;
+
+	if (--params->busy > 0)
+		return;
+
+	conn_params_schedule_idle(device);
+}
+
 static void att_connect_cb(GIOChannel *io, GError *gerr, gpointer user_data)
 {
 	struct att_callbacks *attcb = user_data;
@@ -3275,6 +3622,11 @@ static void att_connect_cb(GIOChannel *io, GError *gerr, gpointer user_data)
 	device->cleanup_id = g_io_add_watch(io, G_IO_HUP,
 					attrib_disconnected_cb, device);
 
+	trace_device(TRACE_DEVICE_ATT_CONNECT, device,
+					g_io_channel_unix_get_fd(io));
+
+	conn_params_connected(device);
+
 	if (attcb->success)
 		attcb->success(user_data);
 
@@ -3449,6 +3801,10 @@ static int device_browse_primary(struct btd_device *device, DBusMessage *msg)
 
 	device->browse = req;
 
+	/* Discovery is a burst of requests, keep the interval short */
+	req->fast_conn = true;
+	btd_device_request_fast_conn(device);
+
 	if (device->attrib) {
 		gatt_discover_primary(device->attrib, NULL, primary_cb, req);
 		goto done;
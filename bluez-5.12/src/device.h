@@ -119,6 +119,9 @@ void btd_device_set_pnpid(struct btd_device *device, uint16_t source,
 
 int device_connect_le(struct btd_device *dev);
 
+void btd_device_request_fast_conn(struct btd_device *device);
+void btd_device_release_fast_conn(struct btd_device *device);
+
 typedef void (*device_svc_cb_t) (struct btd_device *dev, int err,
 							void *user_data);
 
@@ -129,103 +129,234 @@ static char *name2utf8(const uint8_t *name, uint8_t len)
 	return g_strdup(utf8_name);
 }
 
-void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+static void eir_parse_field(struct eir_data *eir,
+					const struct eir_field *field)
+{
+	const uint8_t *data = field->data;
+	uint8_t data_len = field->len;
+
+	switch (field->type) {
+	case EIR_UUID16_SOME:
+	case EIR_UUID16_ALL:
+		eir_parse_uuid16(eir, data, data_len);
+		break;
+
+	case EIR_UUID32_SOME:
+	case EIR_UUID32_ALL:
+		eir_parse_uuid32(eir, data, data_len);
+		break;
+
+	case EIR_UUID128_SOME:
+	case EIR_UUID128_ALL:
+		eir_parse_uuid128(eir, data, data_len);
+		break;
+
+	case EIR_FLAGS:
+		if (data_len > 0)
+			eir->flags = *data;
+		break;
+
+	case EIR_NAME_SHORT:
+	case EIR_NAME_COMPLETE:
+		/* Some vendors put a NUL byte terminator into
+		 * the name */
+		while (data_len > 0 && data[data_len - 1] == '\0')
+			data_len--;
+
+		g_free(eir->name);
+
+		eir->name = name2utf8(data, data_len);
+		eir->name_complete = field->type == EIR_NAME_COMPLETE;
+		break;
+
+	case EIR_TX_POWER:
+		if (data_len < 1)
+			break;
+		eir->tx_power = (int8_t) data[0];
+		break;
+
+	case EIR_CLASS_OF_DEV:
+		if (data_len < 3)
+			break;
+		eir->class = data[0] | (data[1] << 8) | (data[2] << 16);
+		break;
+
+	case EIR_GAP_APPEARANCE:
+		if (data_len < 2)
+			break;
+		eir->appearance = bt_get_le16(data);
+		break;
+
+	case EIR_SSP_HASH:
+		if (data_len < 16)
+			break;
+		g_free(eir->hash);
+		eir->hash = g_memdup(data, 16);
+		break;
+
+	case EIR_SSP_RANDOMIZER:
+		if (data_len < 16)
+			break;
+		g_free(eir->randomizer);
+		eir->randomizer = g_memdup(data, 16);
+		break;
+	}
+}
+
+/*
+ * Validate the TLV structure once and remember how much of the buffer is
+ * well formed, so that iterating over the view later needs no further
+ * checks and never copies anything. Parsing stops at the first empty or
+ * truncated field, same as it always did.
+ */
+unsigned int eir_view_init(struct eir_view *view, const uint8_t *eir_data,
+							uint8_t eir_len)
 {
+	unsigned int count = 0;
 	uint16_t len = 0;
 
-	eir->flags = -1;
-	eir->tx_power = 127;
+	view->data = eir_data;
+	view->len = 0;
 
 	/* No EIR data to parse */
 	if (eir_data == NULL)
-		return;
+		return 0;
 
-	while (len < eir_len - 1) {
-		uint8_t field_len = eir_data[0];
-		const uint8_t *data;
-		uint8_t data_len;
+	while (len + 1 < eir_len) {
+		uint8_t field_len = eir_data[len];
 
 		/* Check for the end of EIR */
 		if (field_len == 0)
 			break;
 
-		len += field_len + 1;
-
 		/* Do not continue EIR Data parsing if got incorrect length */
-		if (len > eir_len)
+		if (len + field_len + 1 > eir_len)
 			break;
 
-		data = &eir_data[2];
-		data_len = field_len - 1;
+		len += field_len + 1;
+		count++;
+	}
+
+	view->len = len;
+
+	return count;
+}
+
+gboolean eir_view_next(const struct eir_view *view, uint8_t *offset,
+						struct eir_field *field)
+{
+	const uint8_t *ptr;
+
+	if (*offset >= view->len)
+		return FALSE;
+
+	ptr = view->data + *offset;
+
+	field->type = ptr[1];
+	field->data = &ptr[2];
+	field->len = ptr[0] - 1;
+
+	*offset += ptr[0] + 1;
+
+	return TRUE;
+}
+
+gboolean eir_view_find(const struct eir_view *view, uint8_t type,
+						struct eir_field *field)
+{
+	struct eir_field tmp;
+	gboolean found = FALSE;
+	uint8_t offset = 0;
+
+	/* Later fields override earlier ones, as in eir_parse() */
+	while (eir_view_next(view, &offset, &tmp)) {
+		if (tmp.type != type)
+			continue;
+
+		*field = tmp;
+		found = TRUE;
+	}
+
+	return found;
+}
+
+int eir_view_get_flags(const struct eir_view *view)
+{
+	struct eir_field field;
+	uint8_t offset = 0;
+	int flags = -1;
+
+	while (eir_view_next(view, &offset, &field)) {
+		if (field.type == EIR_FLAGS && field.len > 0)
+			flags = field.data[0];
+	}
+
+	return flags;
+}
 
-		switch (eir_data[1]) {
+unsigned int eir_view_foreach_uuid(const struct eir_view *view,
+				eir_uuid_func_t func, void *user_data)
+{
+	struct eir_field field;
+	unsigned int count = 0;
+	uint8_t offset = 0;
+	uuid_t uuid;
+	int i, k;
+
+	while (eir_view_next(view, &offset, &field)) {
+		switch (field.type) {
 		case EIR_UUID16_SOME:
 		case EIR_UUID16_ALL:
-			eir_parse_uuid16(eir, data, data_len);
+			uuid.type = SDP_UUID16;
+			for (i = 0; i + 2 <= field.len; i += 2, count++) {
+				uuid.value.uuid16 = bt_get_le16(&field.data[i]);
+				func(&uuid, user_data);
+			}
 			break;
 
 		case EIR_UUID32_SOME:
 		case EIR_UUID32_ALL:
-			eir_parse_uuid32(eir, data, data_len);
+			uuid.type = SDP_UUID32;
+			for (i = 0; i + 4 <= field.len; i += 4, count++) {
+				uuid.value.uuid32 = bt_get_le32(&field.data[i]);
+				func(&uuid, user_data);
+			}
 			break;
 
 		case EIR_UUID128_SOME:
 		case EIR_UUID128_ALL:
-			eir_parse_uuid128(eir, data, data_len);
-			break;
-
-		case EIR_FLAGS:
-			if (data_len > 0)
-				eir->flags = *data;
-			break;
-
-		case EIR_NAME_SHORT:
-		case EIR_NAME_COMPLETE:
-			/* Some vendors put a NUL byte terminator into
-			 * the name */
-			while (data_len > 0 && data[data_len - 1] == '\0')
-				data_len--;
-
-			g_free(eir->name);
-
-			eir->name = name2utf8(data, data_len);
-			eir->name_complete = eir_data[1] == EIR_NAME_COMPLETE;
+			uuid.type = SDP_UUID128;
+			for (i = 0; i + 16 <= field.len; i += 16, count++) {
+				for (k = 0; k < 16; k++)
+					uuid.value.uuid128.data[k] =
+						field.data[i + 16 - k - 1];
+				func(&uuid, user_data);
+			}
 			break;
+		}
+	}
 
-		case EIR_TX_POWER:
-			if (data_len < 1)
-				break;
-			eir->tx_power = (int8_t) data[0];
-			break;
+	return count;
+}
 
-		case EIR_CLASS_OF_DEV:
-			if (data_len < 3)
-				break;
-			eir->class = data[0] | (data[1] << 8) |
-							(data[2] << 16);
-			break;
+void eir_view_parse(const struct eir_view *view, struct eir_data *eir)
+{
+	struct eir_field field;
+	uint8_t offset = 0;
 
-		case EIR_GAP_APPEARANCE:
-			if (data_len < 2)
-				break;
-			eir->appearance = bt_get_le16(data);
-			break;
+	eir->flags = -1;
+	eir->tx_power = 127;
 
-		case EIR_SSP_HASH:
-			if (data_len < 16)
-				break;
-			eir->hash = g_memdup(data, 16);
-			break;
+	while (eir_view_next(view, &offset, &field))
+		eir_parse_field(eir, &field);
+}
 
-		case EIR_SSP_RANDOMIZER:
-			if (data_len < 16)
-				break;
-			eir->randomizer = g_memdup(data, 16);
-			break;
-		}
+void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+{
+	struct eir_view view;
 
-		eir_data += field_len + 1;
-	}
+	eir_view_init(&view, eir_data, eir_len);
+	eir_view_parse(&view, eir);
 }
 
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len)
@@ -51,8 +51,31 @@ struct eir_data {
 	bdaddr_t addr;
 };
 
+struct eir_view {
+	const uint8_t *data;
+	uint8_t len;
+};
+
+struct eir_field {
+	uint8_t type;
+	const uint8_t *data;
+	uint8_t len;
+};
+
+typedef void (*eir_uuid_func_t) (const uuid_t *uuid, void *user_data);
+
 void eir_data_free(struct eir_data *eir);
 void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len);
+unsigned int eir_view_init(struct eir_view *view, const uint8_t *eir_data,
+							uint8_t eir_len);
+gboolean eir_view_next(const struct eir_view *view, uint8_t *offset,
+						struct eir_field *field);
+gboolean eir_view_find(const struct eir_view *view, uint8_t type,
+						struct eir_field *field);
+int eir_view_get_flags(const struct eir_view *view);
+unsigned int eir_view_foreach_uuid(const struct eir_view *view,
+				eir_uuid_func_t func, void *user_data);
+void eir_view_parse(const struct eir_view *view, struct eir_data *eir);
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len);
 int eir_create_oob(const bdaddr_t *addr, const char *name, uint32_t cod,
 			const uint8_t *hash, const uint8_t *randomizer,
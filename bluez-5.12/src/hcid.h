@@ -32,11 +32,21 @@ struct main_opts {
 	gboolean	reverse_sdp;
 	gboolean	name_resolv;
 	gboolean	debug_keys;
+	uint32_t	prop_interval;
 
 	uint16_t	did_source;
 	uint16_t	did_vendor;
 	uint16_t	did_product;
 	uint16_t	did_version;
+
+	gboolean	le_conn_policy;
+	uint16_t	le_fast_min_interval;
+	uint16_t	le_fast_max_interval;
+	uint16_t	le_slow_min_interval;
+	uint16_t	le_slow_max_interval;
+	uint16_t	le_slow_latency;
+	uint16_t	le_supervision_timeout;
+	uint16_t	le_idle_timeout;
 };
 
 extern struct main_opts main_opts;
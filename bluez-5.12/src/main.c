@@ -56,6 +56,7 @@
 #include "agent.h"
 #include "profile.h"
 #include "systemd.h"
+#include "src/shared/trace.h"
 
 #define BLUEZ_NAME "org.bluez"
 
@@ -64,6 +65,15 @@
 
 #define SHUTDOWN_GRACE_SECONDS 10
 
+/* LE connection parameters, in controller units (1.25 ms and 10 ms) */
+#define DEFAULT_LE_FAST_MIN_INTERVAL	0x0018	/* 30 ms */
+#define DEFAULT_LE_FAST_MAX_INTERVAL	0x0028	/* 50 ms */
+#define DEFAULT_LE_SLOW_MIN_INTERVAL	0x0140	/* 400 ms */
+#define DEFAULT_LE_SLOW_MAX_INTERVAL	0x0190	/* 500 ms */
+#define DEFAULT_LE_SLOW_LATENCY		0x0004
+#define DEFAULT_LE_SUPERVISION_TIMEOUT	0x0258	/* 6 seconds */
+#define DEFAULT_LE_IDLE_TIMEOUT		5	/* seconds */
+
 struct main_opts main_opts;
 
 static const char * const supported_options[] = {
@@ -76,6 +86,18 @@ static const char * const supported_options[] = {
 	"ReverseServiceDiscovery",
 	"NameResolving",
 	"DebugKeys",
+	"PropertiesChangedInterval",
+};
+
+static const char * const supported_le_options[] = {
+	"ConnectionPolicy",
+	"FastMinInterval",
+	"FastMaxInterval",
+	"SlowMinInterval",
+	"SlowMaxInterval",
+	"SlowLatency",
+	"SupervisionTimeout",
+	"IdleTimeout",
 };
 
 static GKeyFile *load_config(const char *file)
@@ -130,6 +152,34 @@ done:
 	main_opts.did_version = version;
 }
 
+static void check_group(GKeyFile *config, const char *group,
+				const char * const *options, unsigned int n_opts)
+{
+	char **keys;
+	int i;
+
+	keys = g_key_file_get_keys(config, group, NULL, NULL);
+
+	for (i = 0; keys != NULL && keys[i] != NULL; i++) {
+		bool found;
+		unsigned int j;
+
+		found = false;
+		for (j = 0; j < n_opts; j++) {
+			if (g_str_equal(keys[i], options[j])) {
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+			warn("Unknown key %s for group %s in main.conf",
+							keys[i], group);
+	}
+
+	g_strfreev(keys);
+}
+
 static void check_config(GKeyFile *config)
 {
 	char **keys;
@@ -141,31 +191,69 @@ static void check_config(GKeyFile *config)
 	keys = g_key_file_get_groups(config, NULL);
 
 	for (i = 0; keys != NULL && keys[i] != NULL; i++) {
-		if (!g_str_equal(keys[i], "General"))
+		if (!g_str_equal(keys[i], "General") &&
+						!g_str_equal(keys[i], "LE"))
 			warn("Unknown group %s in main.conf", keys[i]);
 	}
 
 	g_strfreev(keys);
 
-	keys = g_key_file_get_keys(config, "General", NULL, NULL);
+	check_group(config, "General", supported_options,
+					G_N_ELEMENTS(supported_options));
+	check_group(config, "LE", supported_le_options,
+					G_N_ELEMENTS(supported_le_options));
+}
 
-	for (i = 0; keys != NULL && keys[i] != NULL; i++) {
-		bool found;
-		unsigned int j;
+static void parse_le_value(GKeyFile *config, const char *key,
+							uint16_t *value)
+{
+	GError *err = NULL;
+	char *str;
+	unsigned long val;
+	char *end;
 
-		found = false;
-		for (j = 0; j < G_N_ELEMENTS(supported_options); j++) {
-			if (g_str_equal(keys[i], supported_options[j])) {
-				found = true;
-				break;
-			}
-		}
+	str = g_key_file_get_string(config, "LE", key, &err);
+	if (err) {
+		DBG("%s", err->message);
+		g_clear_error(&err);
+		return;
+	}
 
-		if (!found)
-			warn("Unknown key %s in main.conf", keys[i]);
+	val = strtoul(str, &end, 0);
+	if (*end != '\0' || val > UINT16_MAX)
+		warn("Invalid value %s for LE %s in main.conf", str, key);
+	else {
+		DBG("%s=0x%4.4lx", key, val);
+		*value = val;
 	}
 
-	g_strfreev(keys);
+	g_free(str);
+}
+
+static void parse_le_config(GKeyFile *config)
+{
+	GError *err = NULL;
+	gboolean boolean;
+
+	boolean = g_key_file_get_boolean(config, "LE", "ConnectionPolicy",
+									&err);
+	if (err)
+		g_clear_error(&err);
+	else
+		main_opts.le_conn_policy = boolean;
+
+	parse_le_value(config, "FastMinInterval",
+					&main_opts.le_fast_min_interval);
+	parse_le_value(config, "FastMaxInterval",
+					&main_opts.le_fast_max_interval);
+	parse_le_value(config, "SlowMinInterval",
+					&main_opts.le_slow_min_interval);
+	parse_le_value(config, "SlowMaxInterval",
+					&main_opts.le_slow_max_interval);
+	parse_le_value(config, "SlowLatency", &main_opts.le_slow_latency);
+	parse_le_value(config, "SupervisionTimeout",
+					&main_opts.le_supervision_timeout);
+	parse_le_value(config, "IdleTimeout", &main_opts.le_idle_timeout);
 }
 
 static void parse_config(GKeyFile *config)
@@ -263,6 +351,20 @@ static void parse_config(GKeyFile *config)
 		g_clear_error(&err);
 	else
 		main_opts.debug_keys = boolean;
+
+	val = g_key_file_get_integer(config, "General",
+					"PropertiesChangedInterval", &err);
+	if (err) {
+		DBG("%s", err->message);
+		g_clear_error(&err);
+	} else if (val < 0) {
+		error("Invalid PropertiesChangedInterval %d", val);
+	} else {
+		DBG("prop_interval=%d", val);
+		main_opts.prop_interval = val;
+	}
+
+	parse_le_config(config);
 }
 
 static void init_defaults(void)
@@ -279,6 +381,15 @@ static void init_defaults(void)
 	main_opts.name_resolv = TRUE;
 	main_opts.debug_keys = FALSE;
 
+	main_opts.le_conn_policy = FALSE;
+	main_opts.le_fast_min_interval = DEFAULT_LE_FAST_MIN_INTERVAL;
+	main_opts.le_fast_max_interval = DEFAULT_LE_FAST_MAX_INTERVAL;
+	main_opts.le_slow_min_interval = DEFAULT_LE_SLOW_MIN_INTERVAL;
+	main_opts.le_slow_max_interval = DEFAULT_LE_SLOW_MAX_INTERVAL;
+	main_opts.le_slow_latency = DEFAULT_LE_SLOW_LATENCY;
+	main_opts.le_supervision_timeout = DEFAULT_LE_SUPERVISION_TIMEOUT;
+	main_opts.le_idle_timeout = DEFAULT_LE_IDLE_TIMEOUT;
+
 	if (sscanf(VERSION, "%hhu.%hhu", &major, &minor) != 2)
 		return;
 
@@ -301,6 +412,32 @@ static gboolean quit_eventloop(gpointer user_data)
 	return FALSE;
 }
 
+static void print_trace_entry(const struct trace_entry *entry,
+							void *user_data)
+{
+	info("trace %llu.%06llu %s 0x%8.8x 0x%8.8x 0x%8.8x",
+			(unsigned long long) entry->time / 1000000,
+			(unsigned long long) entry->time % 1000000,
+			trace_event_str(entry->id), entry->arg[0],
+			entry->arg[1], entry->arg[2]);
+}
+
+static void dump_trace(void)
+{
+	unsigned int count;
+
+	if (!trace_is_enabled()) {
+		info("Tracing is not enabled");
+		return;
+	}
+
+	info("Trace dump start");
+
+	count = trace_foreach(print_trace_entry, NULL);
+
+	info("Trace dump end, %u entries", count);
+}
+
 static gboolean signal_handler(GIOChannel *channel, GIOCondition cond,
 							gpointer user_data)
 {
@@ -332,6 +469,9 @@ static gboolean signal_handler(GIOChannel *channel, GIOCondition cond,
 
 		__terminated = 1;
 		break;
+	case SIGUSR1:
+		dump_trace();
+		break;
 	case SIGUSR2:
 		__btd_toggle_debug();
 		break;
@@ -350,6 +490,7 @@ static guint setup_signalfd(void)
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGINT);
 	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGUSR1);
 	sigaddset(&mask, SIGUSR2);
 
 	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
@@ -385,6 +526,7 @@ static gboolean option_compat = FALSE;
 static gboolean option_detach = TRUE;
 static gboolean option_version = FALSE;
 static gboolean option_experimental = FALSE;
+static gint option_trace = 0;
 
 static void free_options(void)
 {
@@ -438,6 +580,7 @@ static int connect_dbus(void)
 
 	g_dbus_set_disconnect_function(conn, disconnected_dbus, NULL, NULL);
 	g_dbus_attach_object_manager(conn);
+	g_dbus_set_property_changed_interval(main_opts.prop_interval);
 
 	return 0;
 }
@@ -472,6 +615,9 @@ static GOptionEntry options[] = {
 				"Provide deprecated command line interfaces" },
 	{ "experimental", 'E', 0, G_OPTION_ARG_NONE, &option_experimental,
 				"Enable experimental interfaces" },
+	{ "trace", 'T', 0, G_OPTION_ARG_INT, &option_trace,
+				"Keep the last N events in a trace ring, "
+				"dumped to the log on SIGUSR1", "N" },
 	{ "nodetach", 'n', G_OPTION_FLAG_REVERSE,
 				G_OPTION_ARG_NONE, &option_detach,
 				"Run with logging in foreground" },
@@ -520,6 +666,9 @@ int main(int argc, char *argv[])
 
 	__btd_log_init(option_debug, option_detach);
 
+	if (option_trace > 0 && !trace_enable(option_trace))
+		error("Unable to enable tracing of %d events", option_trace);
+
 	sd_notify(0, "STATUS=Starting up");
 
 	config = load_config(CONFIGDIR "/main.conf");
@@ -614,6 +763,8 @@ int main(int argc, char *argv[])
 	if (watchdog > 0)
 		g_source_remove(watchdog);
 
+	trace_disable();
+
 	__btd_log_cleanup();
 
 	return 0;
@@ -37,6 +37,7 @@
 #include "lib/hci.h"
 
 #include "src/shared/util.h"
+#include "src/shared/trace.h"
 #include "src/shared/mgmt.h"
 
 struct mgmt {
@@ -159,6 +160,9 @@ static gboolean can_write_data(GIOChannel *channel, GIOCondition cond,
 		return TRUE;
 	}
 
+	trace_event(TRACE_MGMT_COMMAND, request->index, request->opcode,
+								request->len);
+
 	util_debug(mgmt->debug_callback, mgmt->debug_data,
 				"[0x%04x] command 0x%04x",
 				request->index, request->opcode);
@@ -312,6 +316,8 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 		cc = mgmt->buf + MGMT_HDR_SIZE;
 		opcode = btohs(cc->opcode);
 
+		trace_event(TRACE_MGMT_COMPLETE, index, opcode, cc->status);
+
 		util_debug(mgmt->debug_callback, mgmt->debug_data,
 				"[0x%04x] command 0x%04x complete: 0x%02x",
 						index, opcode, cc->status);
@@ -323,6 +329,8 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 		cs = mgmt->buf + MGMT_HDR_SIZE;
 		opcode = btohs(cs->opcode);
 
+		trace_event(TRACE_MGMT_STATUS, index, opcode, cs->status);
+
 		util_debug(mgmt->debug_callback, mgmt->debug_data,
 				"[0x%04x] command 0x%02x status: 0x%02x",
 						index, opcode, cs->status);
@@ -330,6 +338,8 @@ static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 		request_complete(mgmt, cs->status, opcode, index, 0, NULL);
 		break;
 	default:
+		trace_event(TRACE_MGMT_EVENT, index, event, length);
+
 		util_debug(mgmt->debug_callback, mgmt->debug_data,
 				"[0x%04x] event 0x%04x", index, event);
 
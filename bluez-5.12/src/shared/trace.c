@@ -0,0 +1,160 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/shared/trace.h"
+
+/*
+ * Fixed size ring of binary records. Writers claim a slot with a single
+ * atomic increment and never take a lock or allocate, so recording costs
+ * the same regardless of load. Formatting only happens when the ring is
+ * read back.
+ */
+static struct trace_entry *ring = NULL;
+static unsigned int ring_mask;
+static unsigned int ring_head;
+static bool ring_full;
+
+bool trace_enable(unsigned int entries)
+{
+	unsigned int size;
+
+	if (ring)
+		return true;
+
+	if (entries == 0)
+		return false;
+
+	/* Round up to a power of two so the index is a simple mask */
+	for (size = 1; size < entries; size <<= 1) {
+		if (size & (1u << 31))
+			return false;
+	}
+
+	ring = calloc(size, sizeof(struct trace_entry));
+	if (!ring)
+		return false;
+
+	ring_mask = size - 1;
+	ring_head = 0;
+	ring_full = false;
+
+	return true;
+}
+
+void trace_disable(void)
+{
+	struct trace_entry *old = ring;
+
+	ring = NULL;
+	free(old);
+}
+
+bool trace_is_enabled(void)
+{
+	return ring != NULL;
+}
+
+void trace_event(uint32_t id, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+	struct trace_entry *entry;
+	struct timespec ts;
+	unsigned int pos;
+
+	if (!ring)
+		return;
+
+	pos = __sync_fetch_and_add(&ring_head, 1);
+	if (pos == ring_mask)
+		ring_full = true;
+
+	entry = &ring[pos & ring_mask];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	entry->time = (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	entry->id = id;
+	entry->arg[0] = arg1;
+	entry->arg[1] = arg2;
+	entry->arg[2] = arg3;
+}
+
+unsigned int trace_foreach(trace_func_t function, void *user_data)
+{
+	unsigned int head, start, count, i;
+
+	if (!ring || !function)
+		return 0;
+
+	head = ring_head;
+
+	if (ring_full) {
+		count = ring_mask + 1;
+		start = head - count;
+	} else {
+		count = head;
+		start = 0;
+	}
+
+	for (i = 0; i < count; i++)
+		function(&ring[(start + i) & ring_mask], user_data);
+
+	return count;
+}
+
+const char *trace_event_str(uint32_t id)
+{
+	switch (id) {
+	case TRACE_ATT_SEND:
+		return "att-send";
+	case TRACE_ATT_RECV:
+		return "att-recv";
+	case TRACE_MGMT_COMMAND:
+		return "mgmt-command";
+	case TRACE_MGMT_COMPLETE:
+		return "mgmt-complete";
+	case TRACE_MGMT_STATUS:
+		return "mgmt-status";
+	case TRACE_MGMT_EVENT:
+		return "mgmt-event";
+	case TRACE_DEVICE_CONNECT:
+		return "device-connect";
+	case TRACE_DEVICE_DISCONNECT:
+		return "device-disconnect";
+	case TRACE_DEVICE_ATT_CONNECT:
+		return "device-att-connect";
+	case TRACE_DEVICE_ATT_DISCONNECT:
+		return "device-att-disconnect";
+	case TRACE_HOG_INPUT:
+		return "hog-input";
+	}
+
+	return "unknown";
+}
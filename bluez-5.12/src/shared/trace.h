@@ -0,0 +1,56 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACE_ATT_SEND			0x0001
+#define TRACE_ATT_RECV			0x0002
+#define TRACE_MGMT_COMMAND		0x0010
+#define TRACE_MGMT_COMPLETE		0x0011
+#define TRACE_MGMT_STATUS		0x0012
+#define TRACE_MGMT_EVENT		0x0013
+#define TRACE_DEVICE_CONNECT		0x0020
+#define TRACE_DEVICE_DISCONNECT		0x0021
+#define TRACE_DEVICE_ATT_CONNECT	0x0022
+#define TRACE_DEVICE_ATT_DISCONNECT	0x0023
+#define TRACE_HOG_INPUT			0x0030
+
+struct trace_entry {
+	uint64_t time;		/* CLOCK_MONOTONIC in usec */
+	uint32_t id;
+	uint32_t arg[3];
+};
+
+typedef void (*trace_func_t)(const struct trace_entry *entry,
+							void *user_data);
+
+bool trace_enable(unsigned int entries);
+void trace_disable(void);
+bool trace_is_enabled(void);
+
+void trace_event(uint32_t id, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+unsigned int trace_foreach(trace_func_t function, void *user_data);
+const char *trace_event_str(uint32_t id);
@@ -0,0 +1,262 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+#include <gdbus/gdbus.h>
+
+#include "log.h"
+#include "dbus-common.h"
+#include "watcher-batch.h"
+
+#define DEFAULT_MAX_COUNT	32
+#define DEFAULT_MAX_DELAY	1000
+#define MAX_COUNT_LIMIT		256
+
+/*
+ * Measurements for a watcher are appended to a single pending
+ * MeasurementsReceived(a(oa{sv})) call, which is sent once it holds
+ * MaxCount entries or MaxDelay milliseconds after the first one.
+ */
+struct btd_watcher_batch {
+	char *owner;
+	char *path;
+	char *interface;
+	unsigned int max_count;
+	unsigned int max_delay;
+	unsigned int count;
+	guint timeout;
+	DBusMessage *msg;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	DBusMessageIter entry;
+	DBusMessageIter dict;
+};
+
+static void batch_flush(struct btd_watcher_batch *batch)
+{
+	if (batch->timeout > 0) {
+		g_source_remove(batch->timeout);
+		batch->timeout = 0;
+	}
+
+	if (batch->msg == NULL)
+		return;
+
+	dbus_message_iter_close_container(&batch->iter, &batch->array);
+
+	dbus_message_set_no_reply(batch->msg, TRUE);
+	g_dbus_send_message(btd_get_dbus_connection(), batch->msg);
+
+	batch->msg = NULL;
+	batch->count = 0;
+}
+
+static gboolean batch_timeout(gpointer user_data)
+{
+	struct btd_watcher_batch *batch = user_data;
+
+	batch->timeout = 0;
+	batch_flush(batch);
+
+	return FALSE;
+}
+
+static gboolean parse_options(struct btd_watcher_batch *batch,
+						DBusMessageIter *iter)
+{
+	DBusMessageIter dict;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+		return FALSE;
+
+	dbus_message_iter_recurse(iter, &dict);
+
+	while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+		DBusMessageIter entry, value;
+		const char *key;
+		uint16_t val;
+
+		dbus_message_iter_recurse(&dict, &entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING)
+			return FALSE;
+
+		dbus_message_iter_get_basic(&entry, &key);
+		dbus_message_iter_next(&entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_VARIANT)
+			return FALSE;
+
+		dbus_message_iter_recurse(&entry, &value);
+
+		if (dbus_message_iter_get_arg_type(&value) != DBUS_TYPE_UINT16)
+			return FALSE;
+
+		dbus_message_iter_get_basic(&value, &val);
+
+		if (strcasecmp(key, "MaxCount") == 0) {
+			if (val == 0 || val > MAX_COUNT_LIMIT)
+				return FALSE;
+			batch->max_count = val;
+		} else if (strcasecmp(key, "MaxDelay") == 0) {
+			if (val == 0)
+				return FALSE;
+			batch->max_delay = val;
+		} else
+			return FALSE;
+
+		dbus_message_iter_next(&dict);
+	}
+
+	return TRUE;
+}
+
+struct btd_watcher_batch *btd_watcher_batch_new(DBusMessage *msg,
+						const char *interface)
+{
+	struct btd_watcher_batch *batch;
+	DBusMessageIter iter;
+	const char *path;
+
+	if (!dbus_message_iter_init(msg, &iter))
+		return NULL;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH)
+		return NULL;
+
+	dbus_message_iter_get_basic(&iter, &path);
+	dbus_message_iter_next(&iter);
+
+	batch = g_new0(struct btd_watcher_batch, 1);
+	batch->max_count = DEFAULT_MAX_COUNT;
+	batch->max_delay = DEFAULT_MAX_DELAY;
+
+	if (!parse_options(batch, &iter)) {
+		g_free(batch);
+		return NULL;
+	}
+
+	batch->owner = g_strdup(dbus_message_get_sender(msg));
+	batch->path = g_strdup(path);
+	batch->interface = g_strdup(interface);
+
+	DBG("%s %s: up to %u measurements every %u ms", batch->owner,
+				batch->path, batch->max_count,
+				batch->max_delay);
+
+	return batch;
+}
+
+void btd_watcher_batch_free(struct btd_watcher_batch *batch)
+{
+	if (batch == NULL)
+		return;
+
+	batch_flush(batch);
+
+	g_free(batch->owner);
+	g_free(batch->path);
+	g_free(batch->interface);
+	g_free(batch);
+}
+
+/* The owner has left the bus, so nothing pending can be delivered */
+void btd_watcher_batch_discard(struct btd_watcher_batch *batch)
+{
+	if (batch == NULL)
+		return;
+
+	if (batch->timeout > 0) {
+		g_source_remove(batch->timeout);
+		batch->timeout = 0;
+	}
+
+	if (batch->msg == NULL)
+		return;
+
+	dbus_message_unref(batch->msg);
+	batch->msg = NULL;
+	batch->count = 0;
+}
+
+DBusMessageIter *btd_watcher_batch_append(struct btd_watcher_batch *batch,
+						const char *device_path)
+{
+	if (batch->msg == NULL) {
+		batch->msg = dbus_message_new_method_call(batch->owner,
+						batch->path, batch->interface,
+						"MeasurementsReceived");
+		if (batch->msg == NULL)
+			return NULL;
+
+		dbus_message_iter_init_append(batch->msg, &batch->iter);
+
+		dbus_message_iter_open_container(&batch->iter,
+				DBUS_TYPE_ARRAY,
+				DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+				DBUS_TYPE_OBJECT_PATH_AS_STRING
+				DBUS_TYPE_ARRAY_AS_STRING
+				DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+				DBUS_TYPE_STRING_AS_STRING
+				DBUS_TYPE_VARIANT_AS_STRING
+				DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+				DBUS_STRUCT_END_CHAR_AS_STRING,
+				&batch->array);
+	}
+
+	dbus_message_iter_open_container(&batch->array, DBUS_TYPE_STRUCT,
+							NULL, &batch->entry);
+
+	dbus_message_iter_append_basic(&batch->entry, DBUS_TYPE_OBJECT_PATH,
+								&device_path);
+
+	dbus_message_iter_open_container(&batch->entry, DBUS_TYPE_ARRAY,
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &batch->dict);
+
+	return &batch->dict;
+}
+
+void btd_watcher_batch_commit(struct btd_watcher_batch *batch)
+{
+	dbus_message_iter_close_container(&batch->entry, &batch->dict);
+	dbus_message_iter_close_container(&batch->array, &batch->entry);
+
+	if (++batch->count >= batch->max_count) {
+		batch_flush(batch);
+		return;
+	}
+
+	if (batch->timeout == 0)
+		batch->timeout = g_timeout_add(batch->max_delay,
+						batch_timeout, batch);
+}
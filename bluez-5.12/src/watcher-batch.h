@@ -0,0 +1,33 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct btd_watcher_batch;
+
+struct btd_watcher_batch *btd_watcher_batch_new(DBusMessage *msg,
+						const char *interface);
+void btd_watcher_batch_free(struct btd_watcher_batch *batch);
+void btd_watcher_batch_discard(struct btd_watcher_batch *batch);
+
+DBusMessageIter *btd_watcher_batch_append(struct btd_watcher_batch *batch,
+						const char *device_path);
+void btd_watcher_batch_commit(struct btd_watcher_batch *batch);
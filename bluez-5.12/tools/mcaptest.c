@@ -0,0 +1,750 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+#include <bluetooth/l2cap.h>
+
+#include <btio/btio.h>
+
+#include "profiles/health/mcap.h"
+#include "profiles/health/mcap_lib.h"
+
+#define DEFAULT_CCPSM	0x1001
+#define DEFAULT_DCPSM	0x1003
+#define BENCH_MDEP	0x01
+#define RX_BUF_SIZE	65535
+
+#define CONF_RELIABLE	0x01
+#define CONF_STREAMING	0x02
+
+struct record_hdr {
+	uint32_t seq;
+	uint64_t usec;
+} __attribute__ ((packed));
+
+static GMainLoop *main_loop;
+
+static struct mcap_instance *mi = NULL;
+static struct mcap_mcl *bench_mcl = NULL;
+static struct mcap_mdl *bench_mdl = NULL;
+static bdaddr_t bench_src;
+static bdaddr_t bench_dst;
+
+static char *opt_dev = NULL;
+static int opt_ccpsm = DEFAULT_CCPSM;
+static int opt_dcpsm = DEFAULT_DCPSM;
+static gboolean opt_streaming = FALSE;
+static int opt_size = 64;
+static int opt_count = 10000;
+static int opt_batch = -1;
+static int opt_csp = 0;
+
+/* Receiver state */
+static GIOChannel *rx_io = NULL;
+static guint rx_watch = 0;
+static uint8_t *rx_buf = NULL;
+static size_t rx_buflen = 0;
+static GArray *rx_latency = NULL;
+static uint64_t rx_bytes = 0;
+static uint64_t rx_sdus = 0;
+static uint64_t rx_first = 0;
+static uint64_t rx_last = 0;
+static uint32_t rx_lost = 0;
+static uint32_t rx_next_seq = 0;
+
+/* CSP state */
+static int csp_round = 0;
+static uint64_t csp_sent = 0;
+static int64_t csp_min = INT64_MAX;
+static int64_t csp_max = INT64_MIN;
+static int64_t csp_sum = 0;
+static uint64_t csp_rtt_max = 0;
+
+static uint64_t now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Reads the clock straight from the controller, there is no daemon here */
+static int read_clock(const bdaddr_t *src, const bdaddr_t *dst, int which,
+			int timeout, uint32_t *clock, uint16_t *accuracy)
+{
+	struct hci_conn_info_req *cr;
+	uint16_t handle = 0;
+	int dev_id, dd, err;
+
+	dev_id = hci_get_route((bdaddr_t *) src);
+	if (dev_id < 0)
+		return -ENODEV;
+
+	dd = hci_open_dev(dev_id);
+	if (dd < 0)
+		return -errno;
+
+	if (which) {
+		cr = g_malloc0(sizeof(*cr) + sizeof(struct hci_conn_info));
+		bacpy(&cr->bdaddr, dst);
+		cr->type = ACL_LINK;
+
+		if (ioctl(dd, HCIGETCONNINFO, cr) < 0) {
+			err = -errno;
+			g_free(cr);
+			hci_close_dev(dd);
+			return err;
+		}
+
+		/* hci_read_clock() does the byte order conversion */
+		handle = cr->conn_info->handle;
+		g_free(cr);
+	}
+
+	if (hci_read_clock(dd, handle, which, clock, accuracy, timeout) < 0)
+		err = -errno;
+	else
+		err = 0;
+
+	hci_close_dev(dd);
+
+	return err;
+}
+
+static int cmp_latency(const void *a, const void *b)
+{
+	uint32_t la = *(const uint32_t *) a;
+	uint32_t lb = *(const uint32_t *) b;
+
+	return (la > lb) - (la < lb);
+}
+
+static uint32_t percentile(GArray *array, unsigned int pct)
+{
+	unsigned int idx;
+
+	if (array->len == 0)
+		return 0;
+
+	idx = (array->len * pct) / 100;
+	if (idx >= array->len)
+		idx = array->len - 1;
+
+	return g_array_index(array, uint32_t, idx);
+}
+
+static void rx_report(void)
+{
+	uint64_t elapsed;
+	uint32_t received;
+
+	received = rx_latency->len;
+	if (received == 0) {
+		printf("No records received\n");
+		return;
+	}
+
+	elapsed = rx_last - rx_first;
+	if (elapsed == 0)
+		elapsed = 1;
+
+	g_array_sort(rx_latency, cmp_latency);
+
+	printf("Received %u records (%u lost) in %" PRIu64 " SDUs, "
+					"%" PRIu64 " bytes in %" PRIu64 " us\n",
+					received, rx_lost, rx_sdus, rx_bytes,
+					elapsed);
+	printf("Throughput %" PRIu64 " kbit/s, %" PRIu64 " records/s\n",
+					rx_bytes * 8 * 1000 / elapsed,
+				(uint64_t) received * 1000000 / elapsed);
+	printf("Latency us p50 %u p90 %u p99 %u max %u\n",
+					percentile(rx_latency, 50),
+					percentile(rx_latency, 90),
+					percentile(rx_latency, 99),
+					percentile(rx_latency, 100));
+}
+
+static void rx_record(const uint8_t *rec, uint64_t now)
+{
+	const struct record_hdr *hdr = (const struct record_hdr *) rec;
+	uint32_t lat;
+
+	if (hdr->seq > rx_next_seq)
+		rx_lost += hdr->seq - rx_next_seq;
+
+	rx_next_seq = hdr->seq + 1;
+
+	lat = now > hdr->usec ? now - hdr->usec : 0;
+	g_array_append_val(rx_latency, lat);
+}
+
+static gboolean rx_data(GIOChannel *io, GIOCondition cond, gpointer user_data)
+{
+	uint64_t now;
+	ssize_t len;
+	size_t off;
+	int fd;
+
+	if (cond & (G_IO_NVAL | G_IO_ERR | G_IO_HUP))
+		goto done;
+
+	fd = g_io_channel_unix_get_fd(io);
+
+	len = read(fd, rx_buf, rx_buflen);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+		goto done;
+	}
+
+	if (len == 0)
+		goto done;
+
+	now = now_usec();
+	if (rx_sdus == 0)
+		rx_first = now;
+	rx_last = now;
+
+	rx_sdus++;
+	rx_bytes += len;
+
+	/* Batched SDUs carry several whole records back to back */
+	for (off = 0; off + opt_size <= (size_t) len; off += opt_size)
+		rx_record(rx_buf + off, now);
+
+	if (rx_next_seq < (uint32_t) opt_count)
+		return TRUE;
+
+done:
+	rx_watch = 0;
+	rx_report();
+	g_main_loop_quit(main_loop);
+
+	return FALSE;
+}
+
+static void mdl_connected_cb(struct mcap_mdl *mdl, gpointer data)
+{
+	int fd;
+
+	fd = mcap_mdl_get_fd(mdl);
+	if (fd < 0) {
+		printf("MDL connected without data channel\n");
+		g_main_loop_quit(main_loop);
+		return;
+	}
+
+	printf("MDL 0x%04x connected\n", mcap_mdl_get_mdlid(mdl));
+
+	bench_mdl = mcap_mdl_ref(mdl);
+
+	rx_buflen = RX_BUF_SIZE;
+	rx_buf = g_malloc(rx_buflen);
+	rx_latency = g_array_sized_new(FALSE, FALSE, sizeof(uint32_t),
+								opt_count);
+
+	rx_io = g_io_channel_unix_new(fd);
+	rx_watch = g_io_add_watch(rx_io, G_IO_IN | G_IO_ERR | G_IO_HUP |
+						G_IO_NVAL, rx_data, NULL);
+}
+
+static void mdl_closed_cb(struct mcap_mdl *mdl, gpointer data)
+{
+	printf("MDL 0x%04x closed\n", mcap_mdl_get_mdlid(mdl));
+}
+
+static uint8_t mdl_conn_req_cb(struct mcap_mcl *mcl, uint8_t mdepid,
+				uint16_t mdlid, uint8_t *conf, gpointer data)
+{
+	uint8_t mode;
+	GError *gerr = NULL;
+
+	if (mdepid != BENCH_MDEP)
+		return MCAP_INVALID_MDEP;
+
+	if (*conf == CONF_STREAMING)
+		mode = L2CAP_MODE_STREAMING;
+	else
+		mode = L2CAP_MODE_ERTM;
+
+	if (!mcap_set_data_chan_mode(mi, mode, &gerr)) {
+		printf("%s\n", gerr->message);
+		g_error_free(gerr);
+		return MCAP_MDL_BUSY;
+	}
+
+	printf("MDL 0x%04x requested, %s mode\n", mdlid,
+			mode == L2CAP_MODE_STREAMING ? "streaming" : "ertm");
+
+	return MCAP_SUCCESS;
+}
+
+static gboolean set_mcl_cb(struct mcap_mcl *mcl)
+{
+	GError *gerr = NULL;
+
+	if (mcap_mcl_set_cb(mcl, NULL, &gerr,
+			MCAP_MDL_CB_CONNECTED, mdl_connected_cb,
+			MCAP_MDL_CB_CLOSED, mdl_closed_cb,
+			MCAP_MDL_CB_REMOTE_CONN_REQ, mdl_conn_req_cb,
+			MCAP_MDL_CB_INVALID))
+		return TRUE;
+
+	printf("Can't set MCL callbacks: %s\n", gerr->message);
+	g_error_free(gerr);
+
+	return FALSE;
+}
+
+static void mcl_connected(struct mcap_mcl *mcl, gpointer data)
+{
+	char addr[18];
+	bdaddr_t dst;
+
+	mcap_mcl_get_addr(mcl, &dst);
+	ba2str(&dst, addr);
+
+	printf("MCL connected from %s\n", addr);
+
+	if (!set_mcl_cb(mcl))
+		return;
+
+	bench_mcl = mcap_mcl_ref(mcl);
+}
+
+static void mcl_reconnected(struct mcap_mcl *mcl, gpointer data)
+{
+	mcl_connected(mcl, data);
+}
+
+static void mcl_disconnected(struct mcap_mcl *mcl, gpointer data)
+{
+	printf("MCL disconnected\n");
+
+	if (rx_latency && rx_watch) {
+		g_source_remove(rx_watch);
+		rx_watch = 0;
+		rx_report();
+		g_main_loop_quit(main_loop);
+	}
+}
+
+static void mcl_uncached(struct mcap_mcl *mcl, gpointer data)
+{
+}
+
+static void send_records(struct mcap_mdl *mdl)
+{
+	struct mcap_stream *stream = NULL;
+	struct record_hdr *hdr;
+	GError *gerr = NULL;
+	uint64_t start, elapsed, writes = 0;
+	uint8_t *rec;
+	int fd, i;
+
+	fd = mcap_mdl_get_fd(mdl);
+	if (fd < 0) {
+		printf("MDL not connected\n");
+		return;
+	}
+
+	if (opt_batch >= 0) {
+		stream = mcap_stream_new(mdl, opt_batch, &gerr);
+		if (!stream) {
+			printf("Can't create stream: %s\n", gerr->message);
+			g_error_free(gerr);
+			return;
+		}
+
+		printf("Batching records into %zu byte SDUs\n",
+						mcap_stream_get_mtu(stream));
+	}
+
+	rec = g_malloc0(opt_size);
+	hdr = (struct record_hdr *) rec;
+
+	start = now_usec();
+
+	for (i = 0; i < opt_count; i++) {
+		hdr->seq = i;
+		hdr->usec = now_usec();
+
+		if (stream) {
+			if (!mcap_stream_write(stream, rec, opt_size, &gerr)) {
+				printf("Write failed: %s\n", gerr->message);
+				g_error_free(gerr);
+				break;
+			}
+			continue;
+		}
+
+		if (write(fd, rec, opt_size) < 0) {
+			printf("Write failed: %s (%d)\n", strerror(errno),
+									errno);
+			break;
+		}
+
+		writes++;
+	}
+
+	if (stream)
+		mcap_stream_free(stream);
+
+	elapsed = now_usec() - start;
+	if (elapsed == 0)
+		elapsed = 1;
+
+	printf("Sent %d records of %d bytes in %" PRIu64 " us "
+					"(%" PRIu64 " kbit/s)\n", i, opt_size,
+					elapsed, (uint64_t) i * opt_size * 8 *
+					1000 / elapsed);
+	if (!stream)
+		printf("%" PRIu64 " write calls\n", writes);
+
+	g_free(rec);
+}
+
+static gboolean quit_timeout(gpointer user_data)
+{
+	g_main_loop_quit(main_loop);
+
+	return FALSE;
+}
+
+static void mdl_data_connected(struct mcap_mdl *mdl, GError *err,
+								gpointer data)
+{
+	if (err) {
+		printf("Data channel connect failed: %s\n", err->message);
+		g_main_loop_quit(main_loop);
+		return;
+	}
+
+	send_records(mdl);
+
+	/* Give the peer a moment to drain before tearing down the MCL */
+	g_timeout_add_seconds(1, quit_timeout, NULL);
+}
+
+static void mdl_created(struct mcap_mdl *mdl, uint8_t conf, GError *err,
+								gpointer data)
+{
+	GError *gerr = NULL;
+	uint8_t mode;
+
+	if (err) {
+		printf("MDL creation failed: %s\n", err->message);
+		g_main_loop_quit(main_loop);
+		return;
+	}
+
+	bench_mdl = mcap_mdl_ref(mdl);
+
+	mode = conf == CONF_STREAMING ? L2CAP_MODE_STREAMING :
+							L2CAP_MODE_ERTM;
+
+	if (!mcap_connect_mdl(mdl, mode, opt_dcpsm, mdl_data_connected,
+						NULL, NULL, &gerr)) {
+		printf("Can't connect data channel: %s\n", gerr->message);
+		g_error_free(gerr);
+		g_main_loop_quit(main_loop);
+	}
+}
+
+static void start_stream(struct mcap_mcl *mcl)
+{
+	GError *gerr = NULL;
+	uint8_t conf;
+
+	conf = opt_streaming ? CONF_STREAMING : CONF_RELIABLE;
+
+	if (!mcap_create_mdl(mcl, BENCH_MDEP, conf, mdl_created, NULL, NULL,
+								&gerr)) {
+		printf("Can't create MDL: %s\n", gerr->message);
+		g_error_free(gerr);
+		g_main_loop_quit(main_loop);
+	}
+}
+
+static void csp_report(void)
+{
+	int samples = csp_round - 1;
+
+	if (samples <= 0)
+		return;
+
+	printf("CSP skew us min %" PRId64 " avg %" PRId64 " max %" PRId64
+				" (max rtt %" PRIu64 " us, %d samples)\n",
+				csp_min, csp_sum / samples, csp_max,
+				csp_rtt_max, samples);
+}
+
+static void csp_next(struct mcap_mcl *mcl);
+
+static void csp_set_cb(struct mcap_mcl *mcl, uint8_t mcap_err,
+				uint32_t btclock, uint64_t timestamp,
+				uint16_t accuracy, GError *err, gpointer data)
+{
+	uint64_t now, rtt, mid;
+	int64_t skew;
+
+	if (err || mcap_err != MCAP_SUCCESS) {
+		printf("CSP set failed: %s\n", err ? err->message :
+							"remote error");
+		start_stream(mcl);
+		return;
+	}
+
+	now = mcap_get_timestamp(mcl, NULL);
+
+	/* The first round aligns the remote timestamp clock with ours */
+	if (csp_round++ > 0) {
+		rtt = now - csp_sent;
+		mid = csp_sent + rtt / 2;
+		skew = (int64_t) (timestamp - mid);
+
+		csp_sum += skew;
+		if (skew < csp_min)
+			csp_min = skew;
+		if (skew > csp_max)
+			csp_max = skew;
+		if (rtt > csp_rtt_max)
+			csp_rtt_max = rtt;
+	}
+
+	if (csp_round <= opt_csp) {
+		csp_next(mcl);
+		return;
+	}
+
+	csp_report();
+	start_stream(mcl);
+}
+
+static void csp_next(struct mcap_mcl *mcl)
+{
+	GError *gerr = NULL;
+	uint64_t timestamp;
+
+	csp_sent = mcap_get_timestamp(mcl, NULL);
+	timestamp = csp_round == 0 ? csp_sent : MCAP_TMSTAMP_DONTSET;
+
+	mcap_sync_set_req(mcl, 0, MCAP_BTCLOCK_IMMEDIATE, timestamp,
+						csp_set_cb, NULL, &gerr);
+	if (gerr) {
+		printf("CSP set request failed: %s\n", gerr->message);
+		g_error_free(gerr);
+		start_stream(mcl);
+	}
+}
+
+static void csp_cap_cb(struct mcap_mcl *mcl, uint8_t mcap_err,
+				uint8_t btclockres, uint16_t synclead,
+				uint16_t tmstampres, uint16_t tmstampacc,
+				GError *err, gpointer data)
+{
+	if (err || mcap_err != MCAP_SUCCESS) {
+		printf("CSP capabilities failed: %s\n", err ? err->message :
+							"remote error");
+		start_stream(mcl);
+		return;
+	}
+
+	printf("CSP btclockres %u synclead %u tmstampres %u tmstampacc %u\n",
+				btclockres, synclead, tmstampres, tmstampacc);
+
+	csp_next(mcl);
+}
+
+static void mcl_connect_cb(struct mcap_mcl *mcl, GError *err, gpointer data)
+{
+	GError *gerr = NULL;
+
+	if (err) {
+		printf("MCL connect failed: %s\n", err->message);
+		g_main_loop_quit(main_loop);
+		return;
+	}
+
+	printf("MCL connected\n");
+
+	bench_mcl = mcap_mcl_ref(mcl);
+
+	if (!set_mcl_cb(mcl)) {
+		g_main_loop_quit(main_loop);
+		return;
+	}
+
+	if (opt_csp <= 0) {
+		start_stream(mcl);
+		return;
+	}
+
+	mcap_sync_cap_req(mcl, 0xffff, csp_cap_cb, NULL, &gerr);
+	if (gerr) {
+		printf("CSP capabilities request failed: %s\n", gerr->message);
+		g_error_free(gerr);
+		start_stream(mcl);
+	}
+}
+
+static GOptionEntry options[] = {
+	{ "dev", 'i', 0, G_OPTION_ARG_STRING, &opt_dev,
+				"Which HCI device to use" },
+	{ "control-psm", 'c', 0, G_OPTION_ARG_INT, &opt_ccpsm,
+				"MCAP control channel PSM" },
+	{ "data-psm", 'd', 0, G_OPTION_ARG_INT, &opt_dcpsm,
+				"MCAP data channel PSM" },
+	{ "streaming", 'S', 0, G_OPTION_ARG_NONE, &opt_streaming,
+				"Use streaming mode for the data channel" },
+	{ "size", 's', 0, G_OPTION_ARG_INT, &opt_size,
+				"Record size in bytes" },
+	{ "count", 'n', 0, G_OPTION_ARG_INT, &opt_count,
+				"Number of records to send" },
+	{ "batch", 'b', 0, G_OPTION_ARG_INT, &opt_batch,
+				"Batch records into MTU sized writes, "
+				"flushing after N ms" },
+	{ "csp", 'C', 0, G_OPTION_ARG_INT, &opt_csp,
+				"Measure clock skew with N CSP rounds" },
+	{ NULL },
+};
+
+static void sig_term(int sig)
+{
+	g_main_loop_quit(main_loop);
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *gerr = NULL;
+	int dev_id;
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, options, NULL);
+
+	if (!g_option_context_parse(context, &argc, &argv, NULL))
+		exit(EXIT_FAILURE);
+
+	g_option_context_free(context);
+
+	if (opt_size < (int) sizeof(struct record_hdr)) {
+		printf("Record size must be at least %zu bytes\n",
+						sizeof(struct record_hdr));
+		exit(EXIT_FAILURE);
+	}
+
+	if (opt_count <= 0) {
+		printf("Invalid record count\n");
+		exit(EXIT_FAILURE);
+	}
+
+	dev_id = opt_dev ? hci_devid(opt_dev) : hci_get_route(NULL);
+	if (dev_id < 0 || hci_devba(dev_id, &bench_src) < 0) {
+		printf("Can't find HCI device\n");
+		exit(EXIT_FAILURE);
+	}
+
+	mi = mcap_create_instance(&bench_src, BT_IO_SEC_LOW, opt_ccpsm,
+					opt_dcpsm, mcl_connected,
+					mcl_reconnected, mcl_disconnected,
+					mcl_uncached, NULL, NULL, &gerr);
+	if (!mi) {
+		printf("Can't create MCAP instance: %s\n", gerr->message);
+		g_error_free(gerr);
+		exit(EXIT_FAILURE);
+	}
+
+	mcap_set_read_clock(mi, read_clock);
+	mcap_enable_csp(mi);
+
+	if (argc > 1) {
+		str2ba(argv[1], &bench_dst);
+
+		if (!mcap_create_mcl(mi, &bench_dst, opt_ccpsm, mcl_connect_cb,
+							NULL, NULL, &gerr)) {
+			printf("Can't connect MCL: %s\n", gerr->message);
+			g_error_free(gerr);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		printf("Listening on control PSM 0x%04x data PSM 0x%04x\n",
+							opt_ccpsm, opt_dcpsm);
+	}
+
+	signal(SIGTERM, sig_term);
+	signal(SIGINT, sig_term);
+
+	main_loop = g_main_loop_new(NULL, FALSE);
+
+	g_main_loop_run(main_loop);
+
+	g_main_loop_unref(main_loop);
+
+	if (rx_watch)
+		g_source_remove(rx_watch);
+
+	if (rx_io)
+		g_io_channel_unref(rx_io);
+
+	if (bench_mdl)
+		mcap_mdl_unref(bench_mdl);
+
+	if (bench_mcl) {
+		mcap_close_mcl(bench_mcl, FALSE);
+		mcap_mcl_unref(bench_mcl);
+	}
+
+	mcap_release_instance(mi);
+	mcap_instance_unref(mi);
+
+	if (rx_latency)
+		g_array_free(rx_latency, TRUE);
+
+	g_free(rx_buf);
+
+	printf("Exiting\n");
+
+	exit(EXIT_SUCCESS);
+}
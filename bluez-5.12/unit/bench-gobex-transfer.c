@@ -0,0 +1,428 @@
+/*
+ *
+ *  OBEX library with GLib integration
+ *
+ *  Copyright (C) 2014  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <gobex/gobex.h>
+
+#define DEFAULT_SIZE	(10 * 1024)	/* KB */
+#define DEFAULT_MTU	32767
+#define PATTERN_SIZE	65536
+#define WATCHDOG	60		/* seconds */
+
+enum {
+	BENCH_PUT,
+	BENCH_GET,
+};
+
+struct bench {
+	int op;
+	int sock_type;
+	gboolean srm;
+	GObex *client;
+	GObex *server;
+	guint64 size;
+	guint64 sent;
+	guint64 received;
+	guint64 packets;
+	unsigned int remaining;
+	GMainLoop *mainloop;
+};
+
+static int option_size = DEFAULT_SIZE;
+static int option_mtu = DEFAULT_MTU;
+static int option_count = 1;
+static gboolean option_stream = FALSE;
+static gboolean option_packet = FALSE;
+static gboolean option_put = FALSE;
+static gboolean option_get = FALSE;
+static gboolean option_no_srm = FALSE;
+
+static guint8 pattern[PATTERN_SIZE];
+static guint64 alloc_count = 0;
+
+/*
+ * Count allocations through the glib allocator vtable. GSlice is put
+ * in always-malloc mode so that its allocations are seen too.
+ */
+static gpointer count_malloc(gsize size)
+{
+	alloc_count++;
+	return malloc(size);
+}
+
+static gpointer count_realloc(gpointer mem, gsize size)
+{
+	alloc_count++;
+	return realloc(mem, size);
+}
+
+static gpointer count_calloc(gsize n_blocks, gsize n_block_bytes)
+{
+	alloc_count++;
+	return calloc(n_blocks, n_block_bytes);
+}
+
+static GMemVTable count_vtable = {
+	.malloc = count_malloc,
+	.realloc = count_realloc,
+	.free = free,
+	.calloc = count_calloc,
+	.try_malloc = count_malloc,
+	.try_realloc = count_realloc,
+};
+
+static void alloc_count_init(void)
+{
+	g_slice_set_config(G_SLICE_CONFIG_ALWAYS_MALLOC, TRUE);
+	g_mem_set_vtable(&count_vtable);
+
+	/* Newer glib ignores the vtable */
+	g_free(g_malloc(1));
+	if (alloc_count == 0)
+		fprintf(stderr, "Allocation counting not supported by glib\n");
+}
+
+static void bench_fail(struct bench *b, const char *what, GError *err)
+{
+	fprintf(stderr, "%s failed: %s\n", what, err ? err->message : "");
+	exit(EXIT_FAILURE);
+}
+
+static gssize produce_data(void *buf, gsize len, gpointer user_data)
+{
+	struct bench *b = user_data;
+	guint64 left = b->size - b->sent;
+
+	if (left == 0)
+		return 0;
+
+	len = MIN(len, MIN(left, PATTERN_SIZE));
+	memcpy(buf, pattern, len);
+	b->sent += len;
+
+	return len;
+}
+
+static gboolean consume_data(const void *buf, gsize len, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	b->received += len;
+	b->packets++;
+
+	return TRUE;
+}
+
+static void start_transfer(struct bench *b);
+
+static void transfer_complete(GObex *obex, GError *err, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	if (err != NULL)
+		bench_fail(b, "Transfer", err);
+
+	/* Only the client side completion drives the next transfer */
+	if (obex != b->client)
+		return;
+
+	if (b->received != b->size) {
+		fprintf(stderr, "Received %" G_GUINT64_FORMAT " of %"
+				G_GUINT64_FORMAT " bytes\n", b->received,
+				b->size);
+		exit(EXIT_FAILURE);
+	}
+
+	if (--b->remaining == 0) {
+		g_main_loop_quit(b->mainloop);
+		return;
+	}
+
+	start_transfer(b);
+}
+
+static void handle_put(GObex *obex, GObexPacket *req, gpointer user_data)
+{
+	struct bench *b = user_data;
+	GError *err = NULL;
+
+	g_obex_put_rsp(obex, req, consume_data, transfer_complete, b, &err,
+							G_OBEX_HDR_INVALID);
+	if (err != NULL)
+		bench_fail(b, "PUT response", err);
+}
+
+static void handle_get(GObex *obex, GObexPacket *req, gpointer user_data)
+{
+	struct bench *b = user_data;
+	GError *err = NULL;
+
+	g_obex_get_rsp(obex, produce_data, transfer_complete, b, &err,
+							G_OBEX_HDR_INVALID);
+	if (err != NULL)
+		bench_fail(b, "GET response", err);
+}
+
+static void handle_connect(GObex *obex, GObexPacket *req,
+							gpointer user_data)
+{
+	GObexPacket *rsp;
+
+	rsp = g_obex_packet_new(G_OBEX_RSP_SUCCESS, TRUE, G_OBEX_HDR_INVALID);
+	g_obex_send(obex, rsp, NULL);
+}
+
+static void start_transfer(struct bench *b)
+{
+	guint8 srm = b->srm ? G_OBEX_SRM_ENABLE : G_OBEX_SRM_DISABLE;
+	guint8 srm_hdr = G_OBEX_HDR_SRM;
+	GError *err = NULL;
+
+	b->sent = 0;
+	b->received = 0;
+
+	/*
+	 * An explicit SRM header overrides the automatic one, streams have
+	 * no SRM so the header list just ends there.
+	 */
+	if (b->sock_type == SOCK_STREAM)
+		srm_hdr = G_OBEX_HDR_INVALID;
+
+	if (b->op == BENCH_PUT)
+		g_obex_put_req(b->client, produce_data, transfer_complete, b,
+					&err, G_OBEX_HDR_NAME, "bench.bin",
+					srm_hdr, srm, G_OBEX_HDR_INVALID);
+	else
+		g_obex_get_req(b->client, consume_data, transfer_complete, b,
+					&err, G_OBEX_HDR_NAME, "bench.bin",
+					srm_hdr, srm, G_OBEX_HDR_INVALID);
+
+	if (err != NULL)
+		bench_fail(b, "Request", err);
+}
+
+static void connect_complete(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	if (err != NULL)
+		bench_fail(b, "Connect", err);
+
+	g_main_loop_quit(b->mainloop);
+}
+
+static GObex *create_obex(int fd, int sock_type)
+{
+	GObexTransportType transport;
+	GIOChannel *io;
+	GObex *obex;
+
+	if (sock_type == SOCK_STREAM)
+		transport = G_OBEX_TRANSPORT_STREAM;
+	else
+		transport = G_OBEX_TRANSPORT_PACKET;
+
+	io = g_io_channel_unix_new(fd);
+	g_io_channel_set_close_on_unref(io, TRUE);
+
+	obex = g_obex_new(io, transport, option_mtu, option_mtu);
+	g_io_channel_unref(io);
+
+	if (obex == NULL) {
+		fprintf(stderr, "Unable to create OBEX session\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return obex;
+}
+
+static gboolean watchdog(gpointer user_data)
+{
+	fprintf(stderr, "Timed out\n");
+	exit(EXIT_FAILURE);
+
+	return FALSE;
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+			(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void run_bench(int op, int sock_type, gboolean srm)
+{
+	struct bench b;
+	int sv[2];
+	gint64 start, elapsed;
+	double cpu, mb;
+	guint64 allocs;
+	GObexStats stats;
+	guint timer;
+
+	if (socketpair(AF_UNIX, sock_type | SOCK_NONBLOCK, 0, sv) < 0) {
+		perror("socketpair");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&b, 0, sizeof(b));
+	b.op = op;
+	b.sock_type = sock_type;
+	b.srm = srm;
+	b.size = (guint64) option_size * 1024;
+	b.remaining = option_count;
+	b.mainloop = g_main_loop_new(NULL, FALSE);
+	b.client = create_obex(sv[0], sock_type);
+	b.server = create_obex(sv[1], sock_type);
+
+	g_obex_add_request_function(b.server, G_OBEX_OP_CONNECT,
+							handle_connect, &b);
+	g_obex_add_request_function(b.server, G_OBEX_OP_PUT, handle_put, &b);
+	g_obex_add_request_function(b.server, G_OBEX_OP_GET, handle_get, &b);
+
+	timer = g_timeout_add_seconds(WATCHDOG, watchdog, NULL);
+
+	/* Negotiate the MTU before measuring */
+	g_obex_connect(b.client, connect_complete, &b, NULL,
+							G_OBEX_HDR_INVALID);
+	g_main_loop_run(b.mainloop);
+
+	start = g_get_monotonic_time();
+	cpu = cpu_time();
+	allocs = alloc_count;
+
+	start_transfer(&b);
+	g_main_loop_run(b.mainloop);
+
+	elapsed = g_get_monotonic_time() - start;
+	cpu = cpu_time() - cpu;
+	allocs = alloc_count - allocs;
+	mb = (double) b.size * option_count / (1024 * 1024);
+
+	g_obex_get_stats(b.client, &stats);
+
+	printf("%-3s  %-6s  %-3s  %8.2f MB/s  %9.0f pkt/s  %7.3f s  "
+			"%9.1f allocs/MB  %" G_GUINT64_FORMAT " stalls\n",
+			op == BENCH_PUT ? "PUT" : "GET",
+			sock_type == SOCK_STREAM ? "stream" : "packet",
+			sock_type == SOCK_STREAM ? "-" : (srm ? "on" : "off"),
+			mb / (elapsed / 1e6),
+			b.packets / (elapsed / 1e6), cpu, allocs / mb,
+			stats.srm_stalls);
+
+	g_source_remove(timer);
+
+	g_obex_unref(b.client);
+	g_obex_unref(b.server);
+	g_main_loop_unref(b.mainloop);
+}
+
+static GOptionEntry options[] = {
+	{ "size", 's', 0, G_OPTION_ARG_INT, &option_size,
+				"Object size", "KB" },
+	{ "mtu", 'm', 0, G_OPTION_ARG_INT, &option_mtu,
+				"OBEX MTU of both sides", "BYTES" },
+	{ "count", 'c', 0, G_OPTION_ARG_INT, &option_count,
+				"Number of transfers per run", "N" },
+	{ "stream", 0, 0, G_OPTION_ARG_NONE, &option_stream,
+				"Only run over SOCK_STREAM" },
+	{ "packet", 0, 0, G_OPTION_ARG_NONE, &option_packet,
+				"Only run over SOCK_SEQPACKET" },
+	{ "put", 0, 0, G_OPTION_ARG_NONE, &option_put,
+				"Only benchmark PUT" },
+	{ "get", 0, 0, G_OPTION_ARG_NONE, &option_get,
+				"Only benchmark GET" },
+	{ "no-srm", 0, 0, G_OPTION_ARG_NONE, &option_no_srm,
+				"Disable SRM over SOCK_SEQPACKET" },
+	{ NULL },
+};
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *err = NULL;
+	gboolean ops[2], types[2];
+	int i, j;
+
+	alloc_count_init();
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, options, NULL);
+
+	if (!g_option_context_parse(context, &argc, &argv, &err)) {
+		fprintf(stderr, "%s\n", err->message);
+		g_error_free(err);
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+
+	if (option_size <= 0 || option_count <= 0 || option_mtu < 255 ||
+							option_mtu > 65535) {
+		fprintf(stderr, "Invalid size, count or MTU\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < PATTERN_SIZE; i++)
+		pattern[i] = i;
+
+	ops[BENCH_PUT] = option_put || !option_get;
+	ops[BENCH_GET] = option_get || !option_put;
+	types[0] = option_stream || !option_packet;
+	types[1] = option_packet || !option_stream;
+
+	printf("%d KB x %d, MTU %d, CPU time covers both sides\n",
+					option_size, option_count, option_mtu);
+
+	for (i = 0; i < 2; i++) {
+		if (!ops[i])
+			continue;
+
+		for (j = 0; j < 2; j++) {
+			if (!types[j])
+				continue;
+
+			run_bench(i, j ? SOCK_SEQPACKET : SOCK_STREAM,
+								!option_no_srm);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
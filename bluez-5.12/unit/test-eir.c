@@ -31,6 +31,7 @@
 #include <bluetooth/hci.h>
 #include <bluetooth/sdp.h>
 
+#include "src/glib-helper.h"
 #include "src/eir.h"
 
 struct test_data {
@@ -597,6 +598,125 @@ static void test_parsing(gconstpointer data)
 	eir_data_free(&eir);
 }
 
+struct uuid_match {
+	const char **uuid;
+	int n;
+};
+
+static void check_uuid(const uuid_t *uuid, void *user_data)
+{
+	struct uuid_match *match = user_data;
+	char *uuid_str;
+
+	uuid_str = bt_uuid2string((uuid_t *) uuid);
+
+	g_assert(match->uuid);
+	g_assert(match->uuid[match->n]);
+	g_assert_cmpstr(match->uuid[match->n], ==, uuid_str);
+
+	g_free(uuid_str);
+
+	match->n++;
+}
+
+static void test_view(gconstpointer data)
+{
+	const struct test_data *test = data;
+	struct uuid_match match;
+	struct eir_view view;
+	struct eir_field field;
+	unsigned int count = 0;
+	uint8_t offset = 0;
+
+	eir_view_init(&view, test->eir_data, test->eir_size);
+
+	g_assert(eir_view_get_flags(&view) == test->flags);
+
+	while (eir_view_next(&view, &offset, &field)) {
+		g_assert(field.data > (const uint8_t *) test->eir_data);
+		g_assert(field.data + field.len <=
+			(const uint8_t *) test->eir_data + test->eir_size);
+		count++;
+	}
+
+	g_assert(count == eir_view_init(&view, test->eir_data,
+							test->eir_size));
+
+	if (test->name) {
+		uint8_t type = test->name_complete ? EIR_NAME_COMPLETE :
+							EIR_NAME_SHORT;
+
+		g_assert(eir_view_find(&view, type, &field));
+	}
+
+	match.uuid = test->uuid;
+	match.n = 0;
+
+	eir_view_foreach_uuid(&view, check_uuid, &match);
+
+	if (test->uuid)
+		g_assert(test->uuid[match.n] == NULL);
+	else
+		g_assert(match.n == 0);
+}
+
+#define PERF_ITERATIONS 100000
+
+static void count_uuid(const uuid_t *uuid, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	(*count)++;
+}
+
+static void test_perf_parse(gconstpointer data)
+{
+	const struct test_data *test = data;
+	struct eir_data eir;
+	unsigned int i;
+	double elapsed;
+
+	g_test_timer_start();
+
+	for (i = 0; i < PERF_ITERATIONS; i++) {
+		memset(&eir, 0, sizeof(eir));
+		eir_parse(&eir, test->eir_data, test->eir_size);
+		eir_data_free(&eir);
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed * 1e9 / PERF_ITERATIONS,
+					"eir_parse: %.0f ns per report",
+					elapsed * 1e9 / PERF_ITERATIONS);
+}
+
+static void test_perf_view(gconstpointer data)
+{
+	const struct test_data *test = data;
+	struct eir_view view;
+	unsigned int i, count = 0;
+	double elapsed;
+	int flags = 0;
+
+	g_test_timer_start();
+
+	for (i = 0; i < PERF_ITERATIONS; i++) {
+		eir_view_init(&view, test->eir_data, test->eir_size);
+		flags |= eir_view_get_flags(&view);
+		eir_view_foreach_uuid(&view, count_uuid, &count);
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_assert(flags == test->flags);
+	g_assert(count > 0);
+
+	g_test_minimized_result(elapsed * 1e9 / PERF_ITERATIONS,
+					"eir_view: %.0f ns per report",
+					elapsed * 1e9 / PERF_ITERATIONS);
+}
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -617,5 +737,23 @@ int main(int argc, char *argv[])
 	g_test_add_data_func("/ad/citizen1", &citizen_adv_test, test_parsing);
 	g_test_add_data_func("/ad/citizen2", &citizen_scan_test, test_parsing);
 
+	g_test_add_data_func("/eir/view/macbookair", &macbookair_test,
+								test_view);
+	g_test_add_data_func("/eir/view/iphone5", &iphone5_test, test_view);
+	g_test_add_data_func("/eir/view/sl910", &gigaset_sl910_test,
+								test_view);
+	g_test_add_data_func("/ad/view/bluesc", &bluesc_test, test_view);
+	g_test_add_data_func("/ad/view/wahooscale", &wahoo_scale_test,
+								test_view);
+	g_test_add_data_func("/ad/view/citizen2", &citizen_scan_test,
+								test_view);
+
+	if (g_test_perf()) {
+		g_test_add_data_func("/eir/perf/parse", &macbookair_test,
+							test_perf_parse);
+		g_test_add_data_func("/eir/perf/view", &macbookair_test,
+							test_perf_view);
+	}
+
 	return g_test_run();
 }
@@ -781,6 +781,120 @@ static void client_string_changed(void)
 	destroy_context(context);
 }
 
+struct coalesce_data {
+	char *value;
+	unsigned int emitted;
+	unsigned int received;
+};
+
+static gboolean get_coalesced_string(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct context *context = data;
+	struct coalesce_data *cdata = context->data;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &cdata->value);
+
+	return TRUE;
+}
+
+static gboolean emit_coalesced_change(void *user_data)
+{
+	struct context *context = user_data;
+	struct coalesce_data *cdata = context->data;
+
+	g_free(cdata->value);
+	cdata->value = g_strdup_printf("value%u", ++cdata->emitted);
+
+	g_dbus_emit_property_changed(context->dbus_conn, SERVICE_PATH,
+						SERVICE_NAME, "String");
+
+	return cdata->emitted < 5;
+}
+
+static void proxy_coalesce_changes(GDBusProxy *proxy, void *user_data)
+{
+	struct context *context = user_data;
+
+	if (g_test_verbose())
+		g_print("proxy %s found\n",
+					g_dbus_proxy_get_interface(proxy));
+
+	g_dbus_set_object_property_changed_interval(context->dbus_conn,
+							SERVICE_PATH, 200);
+
+	g_timeout_add(10, emit_coalesced_change, context);
+}
+
+static void property_coalesced_changed(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+	struct coalesce_data *cdata = context->data;
+	const char *string;
+
+	if (g_test_verbose())
+		g_print("property %s changed\n", name);
+
+	g_assert(g_strcmp0(name, "String") == 0);
+	g_assert(dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_STRING);
+
+	dbus_message_iter_get_basic(iter, &string);
+
+	cdata->received++;
+
+	/* First change goes out right away, the rest within one window */
+	if (cdata->received == 1) {
+		g_assert(g_strcmp0(string, "value1") == 0);
+		return;
+	}
+
+	g_assert(cdata->received == 2);
+	g_assert(g_strcmp0(string, "value5") == 0);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_coalesce_changes(void)
+{
+	struct context *context = create_context();
+	struct coalesce_data *cdata;
+	static const GDBusPropertyTable string_properties[] = {
+		{ "String", "s", get_coalesced_string },
+		{ },
+	};
+
+	if (context == NULL)
+		return;
+
+	cdata = g_new0(struct coalesce_data, 1);
+	cdata->value = g_strdup("value");
+	context->data = cdata;
+
+	g_dbus_register_interface(context->dbus_conn,
+				SERVICE_PATH, SERVICE_NAME,
+				methods, signals, string_properties,
+				context, NULL);
+
+	context->dbus_client = g_dbus_client_new(context->dbus_conn,
+						SERVICE_NAME, SERVICE_PATH);
+
+	g_dbus_client_set_disconnect_watch(context->dbus_client,
+						disconnect_handler, context);
+	g_dbus_client_set_proxy_handlers(context->dbus_client,
+						proxy_coalesce_changes, NULL,
+						property_coalesced_changed,
+						context);
+
+	g_main_loop_run(context->main_loop);
+
+	g_dbus_unregister_interface(context->dbus_conn,
+					SERVICE_PATH, SERVICE_NAME);
+
+	g_free(cdata->value);
+	destroy_context(context);
+}
+
 static void property_check_order(const DBusError *err, void *user_data)
 {
 	struct context *context = user_data;
@@ -989,6 +1103,9 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gdbus/client_string_changed",
 						client_string_changed);
 
+	g_test_add_func("/gdbus/client_coalesce_changes",
+						client_coalesce_changes);
+
 	g_test_add_func("/gdbus/client_check_order", client_check_order);
 
 	g_test_add_func("/gdbus/client_proxy_removed", client_proxy_removed);
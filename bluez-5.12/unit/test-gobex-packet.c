@@ -138,6 +138,56 @@ static void test_decode_nval(void)
 	g_error_free(err);
 }
 
+static void test_decode_arena(void)
+{
+	GObexPacketArena *arena;
+	GObexPacket *pkt, *pkt2;
+	GObexHeader *header;
+	GError *err = NULL;
+	const guint8 *buf;
+	gsize len;
+
+	arena = g_obex_packet_arena_new();
+
+	pkt = g_obex_packet_decode_arena(arena, pkt_put_long,
+					sizeof(pkt_put_long), 0, &err);
+	g_assert_no_error(err);
+	g_assert(pkt != NULL);
+
+	header = g_obex_packet_get_header(pkt, G_OBEX_HDR_BODY);
+	g_assert(header != NULL);
+
+	g_assert(g_obex_header_get_bytes(header, &buf, &len) == TRUE);
+	g_assert(buf == &pkt_put_long[sizeof(pkt_put_long) - 5]);
+	g_assert_cmpuint(len, ==, 5);
+
+	/* Busy arena falls back to an allocated packet */
+	pkt2 = g_obex_packet_decode_arena(arena, pkt_put_body,
+					sizeof(pkt_put_body), 0, &err);
+	g_assert_no_error(err);
+	g_assert(pkt2 != NULL && pkt2 != pkt);
+
+	g_obex_packet_free(pkt2);
+	g_obex_packet_free(pkt);
+
+	pkt = g_obex_packet_decode_arena(arena, pkt_put_action,
+					sizeof(pkt_put_action), 0, &err);
+	g_assert_no_error(err);
+
+	header = g_obex_packet_get_header(pkt, G_OBEX_HDR_ACTION);
+	g_assert(header != NULL);
+
+	g_obex_packet_free(pkt);
+
+	pkt = g_obex_packet_decode_arena(arena, pkt_nval_len,
+					sizeof(pkt_nval_len), 0, &err);
+	g_assert_error(err, G_OBEX_ERROR, G_OBEX_ERROR_PARSE_ERROR);
+	g_assert(pkt == NULL);
+	g_error_free(err);
+
+	g_obex_packet_arena_free(arena);
+}
+
 static void test_decode_encode(void)
 {
 	GObexPacket *pkt;
@@ -210,6 +260,147 @@ static void test_encode_on_demand_fail(void)
 	g_obex_packet_free(pkt);
 }
 
+static gssize get_body_data_ref(const void **buf, gsize len,
+							gpointer user_data)
+{
+	static const uint8_t data[] = { 1, 2, 3, 4 };
+
+	*buf = data;
+
+	return sizeof(data);
+}
+
+static gssize get_body_data_end(void *buf, gsize len, gpointer user_data)
+{
+	return 0;
+}
+
+static gssize get_body_data_ref_end(const void **buf, gsize len,
+							gpointer user_data)
+{
+	*buf = NULL;
+
+	return 0;
+}
+
+static gssize get_body_data_ref_fail(const void **buf, gsize len,
+							gpointer user_data)
+{
+	return -EIO;
+}
+
+static void test_encode_on_demand_ref(void)
+{
+	GObexPacket *pkt;
+	uint8_t copy[255], buf[255];
+	const void *body;
+	gssize copy_len, len;
+	gsize body_len;
+
+	pkt = g_obex_packet_new(G_OBEX_OP_PUT, FALSE, G_OBEX_HDR_INVALID);
+	g_obex_packet_add_body(pkt, get_body_data, NULL);
+	copy_len = g_obex_packet_encode(pkt, copy, sizeof(copy));
+	g_assert_cmpint(copy_len, >, 0);
+	g_obex_packet_free(pkt);
+
+	pkt = g_obex_packet_new(G_OBEX_OP_PUT, FALSE, G_OBEX_HDR_INVALID);
+	g_obex_packet_add_body_ref(pkt, get_body_data_ref, NULL);
+
+	len = g_obex_packet_encode(pkt, buf, sizeof(buf));
+	if (len < 0) {
+		g_printerr("Encoding failed: %s\n", g_strerror(-len));
+		g_assert_not_reached();
+	}
+
+	/* Only the headers are encoded, the length covers the body too */
+	body = g_obex_packet_get_body_ref(pkt, &body_len);
+	g_assert(body != NULL);
+	g_assert_cmpuint(body_len, ==, 4);
+	g_assert_cmpint(len + body_len, ==, copy_len);
+
+	memcpy(buf + len, body, body_len);
+
+	assert_memequal(copy, copy_len, buf, len + body_len);
+	assert_memequal(pkt_put_body, sizeof(pkt_put_body), buf,
+							len + body_len);
+
+	g_obex_packet_free(pkt);
+}
+
+static void test_encode_on_demand_ref_end(void)
+{
+	GObexPacket *pkt;
+	uint8_t copy[255], buf[255];
+	gssize copy_len, len;
+	gsize body_len;
+
+	pkt = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE, G_OBEX_HDR_INVALID);
+	g_obex_packet_add_body(pkt, get_body_data_end, NULL);
+	copy_len = g_obex_packet_encode(pkt, copy, sizeof(copy));
+	g_assert_cmpint(copy_len, >, 0);
+	g_obex_packet_free(pkt);
+
+	pkt = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE, G_OBEX_HDR_INVALID);
+	g_obex_packet_add_body_ref(pkt, get_body_data_ref_end, NULL);
+
+	len = g_obex_packet_encode(pkt, buf, sizeof(buf));
+	g_assert_cmpint(len, >, 0);
+
+	g_obex_packet_get_body_ref(pkt, &body_len);
+	g_assert_cmpuint(body_len, ==, 0);
+
+	assert_memequal(copy, copy_len, buf, len);
+
+	g_obex_packet_free(pkt);
+}
+
+static void test_encode_on_demand_ref_fail(void)
+{
+	GObexPacket *pkt;
+	uint8_t buf[255];
+	gssize len;
+
+	pkt = g_obex_packet_new(G_OBEX_OP_PUT, FALSE, G_OBEX_HDR_INVALID);
+	g_obex_packet_add_body_ref(pkt, get_body_data_ref_fail, NULL);
+
+	len = g_obex_packet_encode(pkt, buf, sizeof(buf));
+
+	g_assert_cmpint(len, ==, -EIO);
+
+	g_obex_packet_free(pkt);
+}
+
+static void test_encode_on_demand_ref_nobufs(void)
+{
+	GObexPacket *pkt;
+	uint8_t buf[8];
+	gssize len;
+
+	pkt = g_obex_packet_new(G_OBEX_OP_PUT, FALSE, G_OBEX_HDR_INVALID);
+	g_obex_packet_add_body_ref(pkt, get_body_data_ref, NULL);
+
+	len = g_obex_packet_encode(pkt, buf, sizeof(buf));
+
+	g_assert_cmpint(len, ==, -ENOBUFS);
+
+	g_obex_packet_free(pkt);
+}
+
+static void test_add_body_twice(void)
+{
+	GObexPacket *pkt;
+
+	pkt = g_obex_packet_new(G_OBEX_OP_PUT, FALSE, G_OBEX_HDR_INVALID);
+	g_assert(g_obex_packet_add_body(pkt, get_body_data, NULL));
+	g_assert(!g_obex_packet_add_body_ref(pkt, get_body_data_ref, NULL));
+	g_obex_packet_free(pkt);
+
+	pkt = g_obex_packet_new(G_OBEX_OP_PUT, FALSE, G_OBEX_HDR_INVALID);
+	g_assert(g_obex_packet_add_body_ref(pkt, get_body_data_ref, NULL));
+	g_assert(!g_obex_packet_add_body(pkt, get_body_data, NULL));
+	g_obex_packet_free(pkt);
+}
+
 static void test_create_args(void)
 {
 	GObexPacket *pkt;
@@ -246,6 +437,7 @@ int main(int argc, char *argv[])
 						test_decode_connect);
 
 	g_test_add_func("/gobex/test_decode_nval", test_decode_nval);
+	g_test_add_func("/gobex/test_decode_arena", test_decode_arena);
 
 	g_test_add_func("/gobex/test_encode_pkt", test_decode_encode);
 
@@ -253,6 +445,16 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gobex/test_encode_on_demand_fail",
 						test_encode_on_demand_fail);
 
+	g_test_add_func("/gobex/test_encode_on_demand_ref",
+						test_encode_on_demand_ref);
+	g_test_add_func("/gobex/test_encode_on_demand_ref_end",
+						test_encode_on_demand_ref_end);
+	g_test_add_func("/gobex/test_encode_on_demand_ref_fail",
+						test_encode_on_demand_ref_fail);
+	g_test_add_func("/gobex/test_encode_on_demand_ref_nobufs",
+					test_encode_on_demand_ref_nobufs);
+	g_test_add_func("/gobex/test_add_body_twice", test_add_body_twice);
+
 	g_test_add_func("/gobex/test_create_args", test_create_args);
 
 	return g_test_run();
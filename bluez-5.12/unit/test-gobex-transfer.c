@@ -309,6 +309,148 @@ static void test_put_req(void)
 	g_assert_no_error(d.err);
 }
 
+static void test_put_req_stats(void)
+{
+	GIOChannel *io;
+	GIOCondition cond;
+	guint io_id, timer_id;
+	GObex *obex;
+	GObexStats stats;
+	struct test_data d = { 0, NULL, {
+				{ put_req_first, sizeof(put_req_first) },
+				{ put_req_last, sizeof(put_req_last) } }, {
+				{ put_rsp_first, sizeof(put_rsp_first) },
+				{ put_rsp_last, sizeof(put_rsp_last) } } };
+
+	create_endpoints(&obex, &io, SOCK_STREAM);
+
+	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
+	io_id = g_io_add_watch(io, cond, test_io_cb, &d);
+
+	d.mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(1, test_timeout, &d);
+
+	g_obex_get_stats(obex, &stats);
+	g_assert_cmpuint(stats.tx_packets, ==, 0);
+	g_assert_cmpuint(stats.rx_packets, ==, 0);
+
+	g_obex_put_req(obex, provide_data, transfer_complete, &d, &d.err,
+				G_OBEX_HDR_TYPE, hdr_type, sizeof(hdr_type),
+				G_OBEX_HDR_NAME, "file.txt",
+				G_OBEX_HDR_INVALID);
+	g_assert_no_error(d.err);
+
+	g_main_loop_run(d.mainloop);
+
+	g_assert_cmpuint(d.count, ==, 2);
+
+	g_obex_get_stats(obex, &stats);
+	g_assert_cmpuint(stats.tx_packets, ==, 2);
+	g_assert_cmpuint(stats.tx_bytes, ==,
+				sizeof(put_req_first) + sizeof(put_req_last));
+	g_assert_cmpuint(stats.rx_packets, ==, 2);
+	g_assert_cmpuint(stats.rx_bytes, ==,
+				sizeof(put_rsp_first) + sizeof(put_rsp_last));
+	g_assert_cmpuint(stats.srm_stalls, ==, 0);
+
+	g_main_loop_unref(d.mainloop);
+
+	g_source_remove(timer_id);
+	g_io_channel_unref(io);
+	g_source_remove(io_id);
+	g_obex_unref(obex);
+
+	g_assert_no_error(d.err);
+}
+
+static void test_packet_put_req_srm_disabled(void)
+{
+	GIOChannel *io;
+	GIOCondition cond;
+	guint io_id, timer_id;
+	GObex *obex;
+	struct test_data d = { 0, NULL, {
+				{ put_req_first, sizeof(put_req_first) },
+				{ put_req_last, sizeof(put_req_last) } }, {
+				{ put_rsp_first, sizeof(put_rsp_first) },
+				{ put_rsp_last, sizeof(put_rsp_last) } } };
+
+	create_endpoints(&obex, &io, SOCK_SEQPACKET);
+
+	g_obex_set_srm_policy(obex, G_OBEX_SRM_POLICY_DISABLED);
+
+	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
+	io_id = g_io_add_watch(io, cond, test_io_cb, &d);
+
+	d.mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(1, test_timeout, &d);
+
+	g_obex_put_req(obex, provide_data, transfer_complete, &d, &d.err,
+				G_OBEX_HDR_TYPE, hdr_type, sizeof(hdr_type),
+				G_OBEX_HDR_NAME, "file.txt",
+				G_OBEX_HDR_INVALID);
+	g_assert_no_error(d.err);
+
+	g_main_loop_run(d.mainloop);
+
+	g_assert_cmpuint(d.count, ==, 2);
+
+	g_main_loop_unref(d.mainloop);
+
+	g_source_remove(timer_id);
+	g_io_channel_unref(io);
+	g_source_remove(io_id);
+	g_obex_unref(obex);
+
+	g_assert_no_error(d.err);
+}
+
+static void test_packet_put_req_srm_enabled(void)
+{
+	GIOChannel *io;
+	GIOCondition cond;
+	guint io_id, timer_id;
+	GObex *obex;
+	struct test_data d = { 0, NULL, {
+			{ put_req_first_srm, sizeof(put_req_first_srm) },
+			{ put_req_last, sizeof(put_req_last) } }, {
+			{ put_rsp_first_srm, sizeof(put_rsp_first_srm) },
+			{ put_rsp_last, sizeof(put_rsp_last) } } };
+
+	create_endpoints(&obex, &io, SOCK_SEQPACKET);
+
+	g_obex_set_srm_policy(obex, G_OBEX_SRM_POLICY_DISABLED);
+	g_obex_set_srm_policy(obex, G_OBEX_SRM_POLICY_ENABLED);
+
+	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
+	io_id = g_io_add_watch(io, cond, test_io_cb, &d);
+
+	d.mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(1, test_timeout, &d);
+
+	g_obex_put_req(obex, provide_data, transfer_complete, &d, &d.err,
+				G_OBEX_HDR_TYPE, hdr_type, sizeof(hdr_type),
+				G_OBEX_HDR_NAME, "file.txt",
+				G_OBEX_HDR_INVALID);
+	g_assert_no_error(d.err);
+
+	g_main_loop_run(d.mainloop);
+
+	g_assert_cmpuint(d.count, ==, 2);
+
+	g_main_loop_unref(d.mainloop);
+
+	g_source_remove(timer_id);
+	g_io_channel_unref(io);
+	g_source_remove(io_id);
+	g_obex_unref(obex);
+
+	g_assert_no_error(d.err);
+}
+
 static gboolean rcv_data(const void *buf, gsize len, gpointer user_data)
 {
 	struct test_data *d = user_data;
@@ -1201,6 +1343,100 @@ static void test_get_rsp(void)
 	g_assert_no_error(d.err);
 }
 
+static gssize provide_data_ref(const void **buf, gsize len,
+							gpointer user_data)
+{
+	struct test_data *d = user_data;
+
+	if (d->total > 0)
+		return 0;
+
+	*buf = body_data;
+	d->total += sizeof(body_data);
+
+	return sizeof(body_data);
+}
+
+static void handle_get_ref(GObex *obex, GObexPacket *req, gpointer user_data)
+{
+	struct test_data *d = user_data;
+	guint8 op = g_obex_packet_get_operation(req, NULL);
+	GObexPacket *rsp;
+	guint id;
+
+	if (op != G_OBEX_OP_GET) {
+		d->err = g_error_new(TEST_ERROR, TEST_ERROR_UNEXPECTED,
+					"Unexpected opcode 0x%02x", op);
+		g_main_loop_quit(d->mainloop);
+		return;
+	}
+
+	rsp = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE, G_OBEX_HDR_INVALID);
+
+	id = g_obex_get_rsp_pkt_ref(obex, rsp, provide_data_ref,
+					transfer_complete, d, &d->err);
+	if (id == 0)
+		g_main_loop_quit(d->mainloop);
+}
+
+/* A referenced body must go out exactly as the copied one does */
+static void test_get_rsp_ref(int sock_type)
+{
+	GIOChannel *io;
+	GIOCondition cond;
+	guint io_id, timer_id;
+	GObex *obex;
+	GObexStats stats;
+	struct test_data d = { 0, NULL, {
+				{ get_rsp_first, sizeof(get_rsp_first) },
+				{ get_rsp_last, sizeof(get_rsp_last) } }, {
+				{ get_req_last, sizeof(get_req_last) },
+				{ NULL, 0 } } };
+
+	create_endpoints(&obex, &io, sock_type);
+
+	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
+	io_id = g_io_add_watch(io, cond, test_io_cb, &d);
+
+	d.mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(1, test_timeout, &d);
+
+	g_obex_add_request_function(obex, G_OBEX_OP_GET, handle_get_ref, &d);
+
+	g_io_channel_write_chars(io, (char *) get_req_first,
+					sizeof(get_req_first), NULL, &d.err);
+	g_assert_no_error(d.err);
+
+	g_main_loop_run(d.mainloop);
+
+	g_assert_cmpuint(d.count, ==, 1);
+
+	/* Byte counters include the referenced body */
+	g_obex_get_stats(obex, &stats);
+	g_assert_cmpuint(stats.tx_bytes, ==,
+				sizeof(get_rsp_first) + sizeof(get_rsp_last));
+
+	g_main_loop_unref(d.mainloop);
+
+	g_source_remove(timer_id);
+	g_io_channel_unref(io);
+	g_source_remove(io_id);
+	g_obex_unref(obex);
+
+	g_assert_no_error(d.err);
+}
+
+static void test_stream_get_rsp_ref(void)
+{
+	test_get_rsp_ref(SOCK_STREAM);
+}
+
+static void test_packet_get_rsp_ref(void)
+{
+	test_get_rsp_ref(SOCK_SEQPACKET);
+}
+
 static void handle_get_seq(GObex *obex, GObexPacket *req,
 							gpointer user_data)
 {
@@ -2195,10 +2431,19 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gobex/test_conn_rsp", test_conn_rsp);
 
 	g_test_add_func("/gobex/test_put_req", test_put_req);
+	g_test_add_func("/gobex/test_put_req_stats", test_put_req_stats);
+	g_test_add_func("/gobex/test_packet_put_req_srm_disabled",
+					test_packet_put_req_srm_disabled);
+	g_test_add_func("/gobex/test_packet_put_req_srm_enabled",
+					test_packet_put_req_srm_enabled);
 	g_test_add_func("/gobex/test_put_rsp", test_put_rsp);
 
 	g_test_add_func("/gobex/test_get_req", test_get_req);
 	g_test_add_func("/gobex/test_get_rsp", test_get_rsp);
+	g_test_add_func("/gobex/test_stream_get_rsp_ref",
+						test_stream_get_rsp_ref);
+	g_test_add_func("/gobex/test_packet_get_rsp_ref",
+						test_packet_get_rsp_ref);
 
 	g_test_add_func("/gobex/test_get_req_app", test_get_req_app);
 	g_test_add_func("/gobex/test_get_rsp_app", test_get_rsp_app);